@@ -0,0 +1,110 @@
+
+#ifndef LS_GAME_BOUNDS_COMPONENT_HPP
+#define LS_GAME_BOUNDS_COMPONENT_HPP
+
+#include "lightsky/math/vec3.h"
+
+#include "lightsky/game/ColumnComponent.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Bounds Component
+ *
+ * Stores an axis-aligned bounding box for each entity as six float columns.
+ * Read by the SweepAndPrune broadphase.
+-----------------------------------------------------------------------------*/
+class BoundsComponent final : public ColumnComponent<float, float, float, float, float, float>
+{
+  public:
+    enum : std::size_t
+    {
+        MIN_X = 0,
+        MIN_Y = 1,
+        MIN_Z = 2,
+        MAX_X = 3,
+        MAX_Y = 4,
+        MAX_Z = 5
+    };
+
+    virtual ~BoundsComponent() noexcept override = default;
+
+    BoundsComponent() noexcept = default;
+
+    BoundsComponent(const BoundsComponent&) noexcept = default;
+
+    BoundsComponent(BoundsComponent&&) noexcept = default;
+
+    BoundsComponent& operator=(const BoundsComponent&) noexcept = default;
+
+    BoundsComponent& operator=(BoundsComponent&&) noexcept = default;
+
+    // Retrieve the bounds of an entity. The entity must belong to *this.
+    math::vec3 min_bounds(const Entity& e) const noexcept;
+
+    math::vec3 max_bounds(const Entity& e) const noexcept;
+
+    // Returns false if the entity does not belong to *this or a shared chunk
+    // could not be duplicated.
+    bool bounds(const Entity& e, const math::vec3& minBounds, const math::vec3& maxBounds) noexcept;
+
+    // Bounds are passive data.
+    virtual void update_entity(const Entity&) noexcept override;
+
+    virtual void update() noexcept override;
+};
+
+
+
+template <>
+std::size_t Component::registration_id<BoundsComponent>() noexcept;
+
+
+
+/*-------------------------------------
+ * Get an entity's minimum bounds
+-------------------------------------*/
+inline math::vec3 BoundsComponent::min_bounds(const Entity& e) const noexcept
+{
+    return math::vec3{get<MIN_X>(e), get<MIN_Y>(e), get<MIN_Z>(e)};
+}
+
+
+
+/*-------------------------------------
+ * Get an entity's maximum bounds
+-------------------------------------*/
+inline math::vec3 BoundsComponent::max_bounds(const Entity& e) const noexcept
+{
+    return math::vec3{get<MAX_X>(e), get<MAX_Y>(e), get<MAX_Z>(e)};
+}
+
+
+
+/*-------------------------------------
+ * Per-entity update
+-------------------------------------*/
+inline void BoundsComponent::update_entity(const Entity&) noexcept
+{
+}
+
+
+
+/*-------------------------------------
+ * Update
+-------------------------------------*/
+inline void BoundsComponent::update() noexcept
+{
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_BOUNDS_COMPONENT_HPP */
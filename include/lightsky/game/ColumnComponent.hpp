@@ -0,0 +1,1009 @@
+
+#ifndef LS_GAME_COLUMN_COMPONENT_HPP
+#define LS_GAME_COLUMN_COMPONENT_HPP
+
+#include <algorithm> // std::min
+#include <cstdlib> // size_t
+#include <cstring> // std::memcpy
+#include <functional> // std::hash, std::equal_to, std::less
+#include <new> // std::nothrow
+#include <tuple>
+#include <type_traits> // std::enable_if, std::is_trivially_copyable
+#include <vector>
+
+#include "lightsky/utils/Assertions.h"
+
+#include "lightsky/game/ColumnIndex.hpp"
+#include "lightsky/game/Component.hpp"
+#include "lightsky/game/PagedArray.hpp"
+#include "lightsky/game/RollbackBuffer.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Column Component
+ *
+ * A component which stores its per-entity data as a structure of arrays. Each
+ * template parameter is one column, kept in the same packed order as the
+ * component's entities.
+ *
+ * Entities and columns are split into chunks of CHUNK_SIZE rows. Every column
+ * chunk begins on a CHUNK_ALIGNMENT boundary and holds CHUNK_SIZE elements,
+ * so an "update()" override can process whole chunks with SIMD loads and
+ * stores, ignoring rows past "chunk_size()". Awake entities fill the leading
+ * "num_active()" rows, so updates which skip dormant entities can stop at
+ * "num_active_chunks()" and "active_chunk_size()".
+ *
+ * Removing an entity moves the last row of every column into its place.
+ *
+ * Any column may be given a hash or sorted index, mapping its values back to
+ * entities. Indices are updated along with each row which gets inserted,
+ * removed, moved, or assigned through "set()". Chunks written through
+ * "writable_column()" are re-indexed on the next lookup, while a rollback
+ * rebuilds the whole index.
+-----------------------------------------------------------------------------*/
+template <typename... ColumnTypes>
+class ColumnComponent : public Component
+{
+    static_assert(sizeof...(ColumnTypes) > 0, "Column components require at least one column.");
+
+  public:
+    enum : std::size_t
+    {
+        CHUNK_SIZE = PagedArray<Entity>::PAGE_SIZE,
+        CHUNK_ALIGNMENT = PagedArray<Entity>::PAGE_ALIGNMENT,
+        NUM_COLUMNS = sizeof...(ColumnTypes)
+    };
+
+    template <std::size_t N>
+    using column_type = typename std::tuple_element<N, std::tuple<ColumnTypes...>>::type;
+
+  private:
+    std::tuple<PagedArray<ColumnTypes, CHUNK_SIZE>...> mColumns;
+
+    std::tuple<ColumnIndex<ColumnTypes>...> mIndices;
+
+    // Scratch storage for index lookups.
+    std::vector<std::size_t> mFoundRows;
+
+    // Functors applied to every column. Each returns false to stop
+    // iteration.
+    struct _PushRow;
+    struct _TrimRows;
+    struct _ReserveRows;
+    struct _MoveRow;
+    struct _ClearRows;
+    struct _SwapRows;
+    struct _ShrinkRows;
+    struct _WriteRow;
+    struct _ReadRow;
+    struct _TrackColumn;
+    struct _SumStats;
+    struct _IndexRow;
+    struct _UnindexRow;
+    struct _ClearIndex;
+    struct _InvalidateIndex;
+    struct _SumIndexStats;
+
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type _for_each_column(const Func& func) noexcept;
+
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type _for_each_column(const Func&) noexcept;
+
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type _for_each_column(const Func& func) const noexcept;
+
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type _for_each_column(const Func&) const noexcept;
+
+    // Functors for indices receive each column along with its index.
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type _for_each_index(const Func& func) noexcept;
+
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type _for_each_index(const Func&) noexcept;
+
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type _for_each_index(const Func& func) const noexcept;
+
+    template <typename Func, std::size_t N = 0>
+    typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type _for_each_index(const Func&) const noexcept;
+
+  protected:
+    virtual bool insert_data(std::size_t index) noexcept override;
+
+    virtual bool erase_data(std::size_t index) noexcept override;
+
+    virtual void clear_data() noexcept override;
+
+    virtual bool swap_data(std::size_t indexA, std::size_t indexB) noexcept override;
+
+    virtual void shrink_data() noexcept override;
+
+    virtual void restore_data() noexcept override;
+
+  public:
+    virtual ~ColumnComponent() noexcept override = default;
+
+    ColumnComponent() noexcept = default;
+
+    ColumnComponent(const ColumnComponent&) = default;
+
+    ColumnComponent(ColumnComponent&&) noexcept = default;
+
+    ColumnComponent& operator=(const ColumnComponent&) = default;
+
+    ColumnComponent& operator=(ColumnComponent&&) noexcept = default;
+
+    std::size_t num_chunks() const noexcept;
+
+    // Number of valid rows within a chunk.
+    std::size_t chunk_size(std::size_t chunkId) const noexcept;
+
+    // Number of chunks which contain awake entities.
+    std::size_t num_active_chunks() const noexcept;
+
+    // Number of leading rows within a chunk which hold awake entities.
+    std::size_t active_chunk_size(std::size_t chunkId) const noexcept;
+
+    // Entities of a chunk, in row order.
+    const Entity* chunk_entities(std::size_t chunkId) const noexcept;
+
+    // Retrieve the aligned data of a column within a chunk. Contains
+    // CHUNK_SIZE elements.
+    template <std::size_t N>
+    const column_type<N>* column(std::size_t chunkId) const noexcept;
+
+    // Retrieve writable data of a column within a chunk. Returns NULL if a
+    // shared chunk could not be duplicated. Rows of the chunk are re-indexed
+    // before the column's next lookup.
+    template <std::size_t N>
+    column_type<N>* writable_column(std::size_t chunkId) noexcept;
+
+    // Retrieve the value of an entity. The entity must belong to *this.
+    template <std::size_t N>
+    const column_type<N>& get(const Entity& e) const noexcept;
+
+    // Assign the value of an entity. Returns false if the entity does not
+    // belong to *this or a shared chunk could not be duplicated.
+    template <std::size_t N>
+    bool set(const Entity& e, const column_type<N>& value) noexcept;
+
+    // Index a column by hashing its values, replacing any existing index.
+    // The index is built during the next lookup. Returns false if memory ran
+    // out.
+    template <std::size_t N, typename Hash = std::hash<column_type<N>>, typename KeyEqual = std::equal_to<column_type<N>>>
+    bool add_hash_index() noexcept;
+
+    // Index a column by sorting its values, allowing range lookups.
+    template <std::size_t N, typename Compare = std::less<column_type<N>>>
+    bool add_sorted_index() noexcept;
+
+    template <std::size_t N>
+    void remove_index() noexcept;
+
+    template <std::size_t N>
+    ColumnIndexType index_type() const noexcept;
+
+    // Append every entity, awake or dormant, whose value equals "key".
+    // Columns without an index, or whose index could not be built, are
+    // scanned, comparing values with operator==. Returns the number of
+    // entities appended.
+    template <std::size_t N>
+    std::size_t find(const column_type<N>& key, std::vector<Entity>& outEntities) noexcept;
+
+    // Append every entity whose value lies within the inclusive range
+    // [lo, hi], in ascending order of value if the column has a sorted
+    // index. Other columns are scanned, comparing values with operator<.
+    template <std::size_t N>
+    std::size_t find_range(const column_type<N>& lo, const column_type<N>& hi, std::vector<Entity>& outEntities) noexcept;
+
+    virtual void track_history(RollbackBuffer& rb) noexcept override;
+
+    virtual MemoryStats memory_stats() const noexcept override;
+
+    // Rows are serialized by copying the bytes of each column. Fails if any
+    // column type is not trivially copyable.
+    virtual bool serialize_data(std::size_t index, std::vector<char>& outData) const noexcept override;
+
+    virtual bool deserialize_data(std::size_t index, const char* pData, std::size_t numBytes) noexcept override;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Column Functors
+-----------------------------------------------------------------------------*/
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_PushRow
+{
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        return a.push_back(typename ArrayType::value_type{});
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_TrimRows
+{
+    std::size_t numRows;
+
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        while (a.size() > numRows)
+        {
+            a.pop_back();
+        }
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_ReserveRows
+{
+    std::size_t index;
+    std::size_t last;
+
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        return a.writable(index) != nullptr && a.writable(last) != nullptr;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_MoveRow
+{
+    std::size_t index;
+    std::size_t last;
+
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        if (index != last)
+        {
+            *a.writable(index) = a[last];
+        }
+
+        a.pop_back();
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_ClearRows
+{
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        a.clear();
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_SwapRows
+{
+    std::size_t indexA;
+    std::size_t indexB;
+
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        const typename ArrayType::value_type temp = a[indexA];
+        *a.writable(indexA) = a[indexB];
+        *a.writable(indexB) = temp;
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_ShrinkRows
+{
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        a.shrink_to_fit();
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_WriteRow
+{
+    std::size_t index;
+    std::vector<char>* pData;
+
+    template <typename ArrayType>
+    typename std::enable_if<std::is_trivially_copyable<typename ArrayType::value_type>::value, bool>::type
+    operator()(const ArrayType& a) const noexcept
+    {
+        const char* pValue = reinterpret_cast<const char*>(&a[index]);
+        pData->insert(pData->end(), pValue, pValue + sizeof(typename ArrayType::value_type));
+        return true;
+    }
+
+    template <typename ArrayType>
+    typename std::enable_if<!std::is_trivially_copyable<typename ArrayType::value_type>::value, bool>::type
+    operator()(const ArrayType&) const noexcept
+    {
+        return false;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_ReadRow
+{
+    std::size_t index;
+    const char** ppData;
+    const char* pEnd;
+
+    template <typename ArrayType>
+    typename std::enable_if<std::is_trivially_copyable<typename ArrayType::value_type>::value, bool>::type
+    operator()(ArrayType& a) const noexcept
+    {
+        typedef typename ArrayType::value_type value_type;
+
+        if ((std::size_t)(pEnd - *ppData) < sizeof(value_type))
+        {
+            return false;
+        }
+
+        value_type* pValue = a.writable(index);
+        if (!pValue)
+        {
+            return false;
+        }
+
+        std::memcpy(pValue, *ppData, sizeof(value_type));
+        *ppData += sizeof(value_type);
+        return true;
+    }
+
+    template <typename ArrayType>
+    typename std::enable_if<!std::is_trivially_copyable<typename ArrayType::value_type>::value, bool>::type
+    operator()(ArrayType&) const noexcept
+    {
+        return false;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_TrackColumn
+{
+    RollbackBuffer* pBuffer;
+
+    template <typename ArrayType>
+    bool operator()(ArrayType& a) const noexcept
+    {
+        pBuffer->track(a);
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_SumStats
+{
+    MemoryStats* pStats;
+
+    template <typename ArrayType>
+    bool operator()(const ArrayType& a) const noexcept
+    {
+        *pStats += a.memory_stats();
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_IndexRow
+{
+    std::size_t index;
+
+    template <typename ArrayType, typename IndexType>
+    bool operator()(const ArrayType& a, IndexType& columnIndex) const noexcept
+    {
+        columnIndex.insert(a[index], index);
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_UnindexRow
+{
+    std::size_t index;
+
+    template <typename ArrayType, typename IndexType>
+    bool operator()(const ArrayType& a, IndexType& columnIndex) const noexcept
+    {
+        columnIndex.erase(a[index], index);
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_ClearIndex
+{
+    template <typename ArrayType, typename IndexType>
+    bool operator()(const ArrayType&, IndexType& columnIndex) const noexcept
+    {
+        columnIndex.clear();
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_InvalidateIndex
+{
+    template <typename ArrayType, typename IndexType>
+    bool operator()(const ArrayType&, IndexType& columnIndex) const noexcept
+    {
+        columnIndex.invalidate();
+        return true;
+    }
+};
+
+
+
+template <typename... ColumnTypes>
+struct ColumnComponent<ColumnTypes...>::_SumIndexStats
+{
+    MemoryStats* pStats;
+
+    template <typename ArrayType, typename IndexType>
+    bool operator()(const ArrayType&, const IndexType& columnIndex) const noexcept
+    {
+        *pStats += columnIndex.memory_stats();
+        return true;
+    }
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Column Component Member Functions
+-----------------------------------------------------------------------------*/
+/*-------------------------------------
+ * Apply a functor to every column
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_column(const Func& func) noexcept
+{
+    return func(std::get<N>(mColumns)) && _for_each_column<Func, N+1>(func);
+}
+
+
+
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_column(const Func&) noexcept
+{
+    return true;
+}
+
+
+
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_column(const Func& func) const noexcept
+{
+    return func(std::get<N>(mColumns)) && _for_each_column<Func, N+1>(func);
+}
+
+
+
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_column(const Func&) const noexcept
+{
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Apply a functor to every column index
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_index(const Func& func) noexcept
+{
+    return func(std::get<N>(mColumns), std::get<N>(mIndices)) && _for_each_index<Func, N+1>(func);
+}
+
+
+
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_index(const Func&) noexcept
+{
+    return true;
+}
+
+
+
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N < sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_index(const Func& func) const noexcept
+{
+    return func(std::get<N>(mColumns), std::get<N>(mIndices)) && _for_each_index<Func, N+1>(func);
+}
+
+
+
+template <typename... ColumnTypes>
+template <typename Func, std::size_t N>
+inline typename std::enable_if<(N == sizeof...(ColumnTypes)), bool>::type ColumnComponent<ColumnTypes...>::_for_each_index(const Func&) const noexcept
+{
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Append a row for a new entity
+-------------------------------------*/
+template <typename... ColumnTypes>
+bool ColumnComponent<ColumnTypes...>::insert_data(std::size_t index) noexcept
+{
+    if (_for_each_column(_PushRow{}))
+    {
+        _for_each_index(_IndexRow{index});
+        return true;
+    }
+
+    // Remove the rows appended to columns before the failure
+    _for_each_column(_TrimRows{index});
+    return false;
+}
+
+
+
+/*-------------------------------------
+ * Replace a row with the last row
+-------------------------------------*/
+template <typename... ColumnTypes>
+bool ColumnComponent<ColumnTypes...>::erase_data(std::size_t index) noexcept
+{
+    const std::size_t last = mEntities.size() - 1;
+
+    // Duplicate all shared chunks up-front so columns are never left
+    // partially modified.
+    if (!_for_each_column(_ReserveRows{index, last}))
+    {
+        return false;
+    }
+
+    _for_each_index(_UnindexRow{index});
+
+    if (index != last)
+    {
+        _for_each_index(_UnindexRow{last});
+    }
+
+    _for_each_column(_MoveRow{index, last});
+
+    if (index != last)
+    {
+        _for_each_index(_IndexRow{index});
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove all rows
+-------------------------------------*/
+template <typename... ColumnTypes>
+void ColumnComponent<ColumnTypes...>::clear_data() noexcept
+{
+    _for_each_column(_ClearRows{});
+    _for_each_index(_ClearIndex{});
+}
+
+
+
+/*-------------------------------------
+ * Exchange two rows
+-------------------------------------*/
+template <typename... ColumnTypes>
+bool ColumnComponent<ColumnTypes...>::swap_data(std::size_t indexA, std::size_t indexB) noexcept
+{
+    if (indexA == indexB)
+    {
+        return true;
+    }
+
+    if (!_for_each_column(_ReserveRows{indexA, indexB}))
+    {
+        return false;
+    }
+
+    _for_each_index(_UnindexRow{indexA});
+    _for_each_index(_UnindexRow{indexB});
+    _for_each_column(_SwapRows{indexA, indexB});
+    _for_each_index(_IndexRow{indexA});
+    _for_each_index(_IndexRow{indexB});
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Release unused rows
+-------------------------------------*/
+template <typename... ColumnTypes>
+void ColumnComponent<ColumnTypes...>::shrink_data() noexcept
+{
+    _for_each_column(_ShrinkRows{});
+}
+
+
+
+/*-------------------------------------
+ * Rebuild indices after a rollback
+-------------------------------------*/
+template <typename... ColumnTypes>
+void ColumnComponent<ColumnTypes...>::restore_data() noexcept
+{
+    _for_each_index(_InvalidateIndex{});
+}
+
+
+
+/*-------------------------------------
+ * Number of chunks
+-------------------------------------*/
+template <typename... ColumnTypes>
+inline std::size_t ColumnComponent<ColumnTypes...>::num_chunks() const noexcept
+{
+    return mEntities.dense().num_pages();
+}
+
+
+
+/*-------------------------------------
+ * Number of rows in a chunk
+-------------------------------------*/
+template <typename... ColumnTypes>
+inline std::size_t ColumnComponent<ColumnTypes...>::chunk_size(std::size_t chunkId) const noexcept
+{
+    return mEntities.dense().page_count(chunkId);
+}
+
+
+
+/*-------------------------------------
+ * Number of chunks with awake entities
+-------------------------------------*/
+template <typename... ColumnTypes>
+inline std::size_t ColumnComponent<ColumnTypes...>::num_active_chunks() const noexcept
+{
+    return (num_active() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+
+
+/*-------------------------------------
+ * Number of awake rows in a chunk
+-------------------------------------*/
+template <typename... ColumnTypes>
+inline std::size_t ColumnComponent<ColumnTypes...>::active_chunk_size(std::size_t chunkId) const noexcept
+{
+    const std::size_t firstRow = chunkId * CHUNK_SIZE;
+    const std::size_t numActive = num_active();
+
+    return (firstRow >= numActive) ? 0 : std::min<std::size_t>(numActive - firstRow, CHUNK_SIZE);
+}
+
+
+
+/*-------------------------------------
+ * Entities of a chunk
+-------------------------------------*/
+template <typename... ColumnTypes>
+inline const Entity* ColumnComponent<ColumnTypes...>::chunk_entities(std::size_t chunkId) const noexcept
+{
+    return mEntities.dense().page(chunkId);
+}
+
+
+
+/*-------------------------------------
+ * Column data (const)
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+inline const typename ColumnComponent<ColumnTypes...>::template column_type<N>* ColumnComponent<ColumnTypes...>::column(std::size_t chunkId) const noexcept
+{
+    return std::get<N>(mColumns).page(chunkId);
+}
+
+
+
+/*-------------------------------------
+ * Column data
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+inline typename ColumnComponent<ColumnTypes...>::template column_type<N>* ColumnComponent<ColumnTypes...>::writable_column(std::size_t chunkId) noexcept
+{
+    PagedArray<column_type<N>, CHUNK_SIZE>& column = std::get<N>(mColumns);
+    column_type<N>* const pChunk = column.writable_page(chunkId);
+
+    if (pChunk)
+    {
+        std::get<N>(mIndices).invalidate_page(column, chunkId);
+    }
+
+    return pChunk;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an entity's value
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+inline const typename ColumnComponent<ColumnTypes...>::template column_type<N>& ColumnComponent<ColumnTypes...>::get(const Entity& e) const noexcept
+{
+    LS_DEBUG_ASSERT(mEntities.contains(e));
+    return std::get<N>(mColumns)[mEntities.index_of(e)];
+}
+
+
+
+/*-------------------------------------
+ * Assign an entity's value
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+bool ColumnComponent<ColumnTypes...>::set(const Entity& e, const column_type<N>& value) noexcept
+{
+    if (!mEntities.contains(e))
+    {
+        return false;
+    }
+
+    const std::size_t index = mEntities.index_of(e);
+    column_type<N>* pValue = std::get<N>(mColumns).writable(index);
+    if (!pValue)
+    {
+        return false;
+    }
+
+    ColumnIndex<column_type<N>>& columnIndex = std::get<N>(mIndices);
+    columnIndex.erase(*pValue, index);
+    *pValue = value;
+    columnIndex.insert(value, index);
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Add a hash index
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N, typename Hash, typename KeyEqual>
+bool ColumnComponent<ColumnTypes...>::add_hash_index() noexcept
+{
+    return std::get<N>(mIndices).reset(&HashColumnIndex<column_type<N>, Hash, KeyEqual>::create);
+}
+
+
+
+/*-------------------------------------
+ * Add a sorted index
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N, typename Compare>
+bool ColumnComponent<ColumnTypes...>::add_sorted_index() noexcept
+{
+    return std::get<N>(mIndices).reset(&SortedColumnIndex<column_type<N>, Compare>::create);
+}
+
+
+
+/*-------------------------------------
+ * Remove an index
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+inline void ColumnComponent<ColumnTypes...>::remove_index() noexcept
+{
+    std::get<N>(mIndices).reset(nullptr);
+}
+
+
+
+/*-------------------------------------
+ * Kind of index
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+inline ColumnIndexType ColumnComponent<ColumnTypes...>::index_type() const noexcept
+{
+    return std::get<N>(mIndices).type();
+}
+
+
+
+/*-------------------------------------
+ * Find entities by value
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+std::size_t ColumnComponent<ColumnTypes...>::find(const column_type<N>& key, std::vector<Entity>& outEntities) noexcept
+{
+    const PagedArray<column_type<N>, CHUNK_SIZE>& column = std::get<N>(mColumns);
+    ColumnIndex<column_type<N>>& columnIndex = std::get<N>(mIndices);
+    const std::size_t numFound = outEntities.size();
+
+    if (columnIndex.type() == ColumnIndexType::INDEX_NONE || !columnIndex.sync(column, mEntities.size()))
+    {
+        const std::equal_to<column_type<N>> isEqual{};
+
+        for (std::size_t i = 0; i < mEntities.size(); ++i)
+        {
+            if (isEqual(column[i], key))
+            {
+                outEntities.push_back(mEntities[i]);
+            }
+        }
+
+        return outEntities.size() - numFound;
+    }
+
+    mFoundRows.clear();
+    columnIndex.get()->find(key, mFoundRows);
+
+    for (std::size_t row : mFoundRows)
+    {
+        outEntities.push_back(mEntities[row]);
+    }
+
+    return outEntities.size() - numFound;
+}
+
+
+
+/*-------------------------------------
+ * Find entities by value range
+-------------------------------------*/
+template <typename... ColumnTypes>
+template <std::size_t N>
+std::size_t ColumnComponent<ColumnTypes...>::find_range(const column_type<N>& lo, const column_type<N>& hi, std::vector<Entity>& outEntities) noexcept
+{
+    const PagedArray<column_type<N>, CHUNK_SIZE>& column = std::get<N>(mColumns);
+    ColumnIndex<column_type<N>>& columnIndex = std::get<N>(mIndices);
+    const std::size_t numFound = outEntities.size();
+
+    if (columnIndex.type() != ColumnIndexType::INDEX_SORTED || !columnIndex.sync(column, mEntities.size()))
+    {
+        const std::less<column_type<N>> isLess{};
+
+        for (std::size_t i = 0; i < mEntities.size(); ++i)
+        {
+            if (!isLess(column[i], lo) && !isLess(hi, column[i]))
+            {
+                outEntities.push_back(mEntities[i]);
+            }
+        }
+
+        return outEntities.size() - numFound;
+    }
+
+    mFoundRows.clear();
+    columnIndex.get()->find_range(lo, hi, mFoundRows);
+
+    for (std::size_t row : mFoundRows)
+    {
+        outEntities.push_back(mEntities[row]);
+    }
+
+    return outEntities.size() - numFound;
+}
+
+
+
+/*-------------------------------------
+ * Track all columns for rollback
+-------------------------------------*/
+template <typename... ColumnTypes>
+void ColumnComponent<ColumnTypes...>::track_history(RollbackBuffer& rb) noexcept
+{
+    Component::track_history(rb);
+    _for_each_column(_TrackColumn{&rb});
+}
+
+
+
+/*-------------------------------------
+ * Memory usage
+-------------------------------------*/
+template <typename... ColumnTypes>
+MemoryStats ColumnComponent<ColumnTypes...>::memory_stats() const noexcept
+{
+    MemoryStats stats = Component::memory_stats();
+    _for_each_column(_SumStats{&stats});
+    _for_each_index(_SumIndexStats{&stats});
+
+    stats.reservedBytes += mFoundRows.capacity() * sizeof(std::size_t);
+
+    return stats;
+}
+
+
+
+/*-------------------------------------
+ * Serialize a row
+-------------------------------------*/
+template <typename... ColumnTypes>
+bool ColumnComponent<ColumnTypes...>::serialize_data(std::size_t index, std::vector<char>& outData) const noexcept
+{
+    return _for_each_column(_WriteRow{index, &outData});
+}
+
+
+
+/*-------------------------------------
+ * Deserialize a row
+-------------------------------------*/
+template <typename... ColumnTypes>
+bool ColumnComponent<ColumnTypes...>::deserialize_data(std::size_t index, const char* pData, std::size_t numBytes) noexcept
+{
+    const char* const pEnd = pData + numBytes;
+
+    _for_each_index(_UnindexRow{index});
+    const bool ret = _for_each_column(_ReadRow{index, &pData, pEnd}) && pData == pEnd;
+    _for_each_index(_IndexRow{index});
+
+    return ret;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_COLUMN_COMPONENT_HPP */
@@ -0,0 +1,731 @@
+
+#ifndef LS_GAME_COLUMN_INDEX_HPP
+#define LS_GAME_COLUMN_INDEX_HPP
+
+#include <cstdlib> // size_t
+#include <functional> // std::hash, std::equal_to, std::less
+#include <map>
+#include <new> // std::nothrow, std::bad_alloc
+#include <unordered_map>
+#include <utility> // std::move
+#include <vector>
+
+#include "lightsky/utils/Pointer.h"
+
+#include "lightsky/game/MemoryStats.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+enum class ColumnIndexType : unsigned
+{
+    INDEX_NONE,
+
+    // Constant-time lookups of equal values.
+    INDEX_HASH,
+
+    // Logarithmic-time lookups of equal values and value ranges.
+    INDEX_SORTED
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Column Index Base
+ *
+ * Maps the values of a column to the rows which hold them.
+-----------------------------------------------------------------------------*/
+template <typename T>
+class ColumnIndexBase
+{
+  public:
+    virtual ~ColumnIndexBase() noexcept {}
+
+    virtual ColumnIndexType type() const noexcept = 0;
+
+    // Returns false if the index could not grow, leaving it incomplete.
+    virtual bool insert(const T& key, std::size_t row) noexcept = 0;
+
+    // The key must match the one which the row was inserted with.
+    virtual void erase(const T& key, std::size_t row) noexcept = 0;
+
+    virtual void clear() noexcept = 0;
+
+    // Append the row of every key equal to "key".
+    virtual void find(const T& key, std::vector<std::size_t>& outRows) const noexcept = 0;
+
+    // Append the rows of all keys within the inclusive range [lo, hi], in
+    // ascending key order. Returns false if keys are unordered.
+    virtual bool find_range(const T& lo, const T& hi, std::vector<std::size_t>& outRows) const noexcept = 0;
+
+    virtual MemoryStats memory_stats() const noexcept = 0;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Bucketed Column Index
+ *
+ * Groups rows into one bucket per distinct key. Each row remembers its
+ * position within its bucket so removal never searches the bucket, keeping
+ * updates cheap for low-cardinality columns such as teams or grid cells.
+-----------------------------------------------------------------------------*/
+template <typename T, typename MapType>
+class BucketColumnIndex : public ColumnIndexBase<T>
+{
+  protected:
+    MapType mBuckets;
+
+    // Position of each row within its bucket.
+    std::vector<std::size_t> mRowSlots;
+
+  public:
+    virtual ~BucketColumnIndex() noexcept override = default;
+
+    BucketColumnIndex() = default;
+
+    BucketColumnIndex(const BucketColumnIndex&) = default;
+
+    virtual bool insert(const T& key, std::size_t row) noexcept override;
+
+    virtual void erase(const T& key, std::size_t row) noexcept override;
+
+    virtual void clear() noexcept override;
+
+    virtual void find(const T& key, std::vector<std::size_t>& outRows) const noexcept override;
+
+    virtual MemoryStats memory_stats() const noexcept override;
+};
+
+
+
+/*-------------------------------------
+ * Add a row
+-------------------------------------*/
+template <typename T, typename MapType>
+bool BucketColumnIndex<T, MapType>::insert(const T& key, std::size_t row) noexcept
+{
+    try
+    {
+        if (row >= mRowSlots.size())
+        {
+            mRowSlots.resize(row + 1);
+        }
+
+        std::vector<std::size_t>& bucket = mBuckets[key];
+        mRowSlots[row] = bucket.size();
+        bucket.push_back(row);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove a row
+-------------------------------------*/
+template <typename T, typename MapType>
+void BucketColumnIndex<T, MapType>::erase(const T& key, std::size_t row) noexcept
+{
+    const typename MapType::iterator iter = mBuckets.find(key);
+    if (iter == mBuckets.end())
+    {
+        return;
+    }
+
+    std::vector<std::size_t>& bucket = iter->second;
+    const std::size_t slot = (row < mRowSlots.size()) ? mRowSlots[row] : bucket.size();
+
+    if (slot >= bucket.size() || bucket[slot] != row)
+    {
+        return;
+    }
+
+    // Move the bucket's last row into the vacated slot
+    bucket[slot] = bucket.back();
+    mRowSlots[bucket[slot]] = slot;
+    bucket.pop_back();
+
+    if (bucket.empty())
+    {
+        mBuckets.erase(iter);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove all rows
+-------------------------------------*/
+template <typename T, typename MapType>
+void BucketColumnIndex<T, MapType>::clear() noexcept
+{
+    mBuckets.clear();
+    mRowSlots.clear();
+}
+
+
+
+/*-------------------------------------
+ * Rows of a single key
+-------------------------------------*/
+template <typename T, typename MapType>
+void BucketColumnIndex<T, MapType>::find(const T& key, std::vector<std::size_t>& outRows) const noexcept
+{
+    const typename MapType::const_iterator iter = mBuckets.find(key);
+    if (iter != mBuckets.end())
+    {
+        outRows.insert(outRows.end(), iter->second.begin(), iter->second.end());
+    }
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+template <typename T, typename MapType>
+MemoryStats BucketColumnIndex<T, MapType>::memory_stats() const noexcept
+{
+    MemoryStats stats{0, 0, 0};
+
+    stats.usedBytes += mRowSlots.size() * sizeof(std::size_t);
+    stats.reservedBytes += mRowSlots.capacity() * sizeof(std::size_t);
+
+    // Approximates one heap node per bucket
+    for (const typename MapType::value_type& bucket : mBuckets)
+    {
+        stats.usedBytes += sizeof(T) + bucket.second.size() * sizeof(std::size_t);
+        stats.reservedBytes += sizeof(T) + sizeof(std::vector<std::size_t>) + sizeof(void*) + bucket.second.capacity() * sizeof(std::size_t);
+    }
+
+    return stats;
+}
+
+
+
+/*-----------------------------------------------------------------------------
+ * Hash Column Index
+-----------------------------------------------------------------------------*/
+template <typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>>
+class HashColumnIndex final : public BucketColumnIndex<T, std::unordered_map<T, std::vector<std::size_t>, Hash, KeyEqual>>
+{
+  public:
+    virtual ~HashColumnIndex() noexcept override = default;
+
+    // Allocate an empty index. Returns NULL on failure.
+    static ColumnIndexBase<T>* create() noexcept
+    {
+        return new(std::nothrow) HashColumnIndex{};
+    }
+
+    virtual ColumnIndexType type() const noexcept override
+    {
+        return ColumnIndexType::INDEX_HASH;
+    }
+
+    virtual bool find_range(const T&, const T&, std::vector<std::size_t>&) const noexcept override
+    {
+        return false;
+    }
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Sorted Column Index
+-----------------------------------------------------------------------------*/
+template <typename T, typename Compare = std::less<T>>
+class SortedColumnIndex final : public BucketColumnIndex<T, std::map<T, std::vector<std::size_t>, Compare>>
+{
+  private:
+    typedef std::map<T, std::vector<std::size_t>, Compare> MapType;
+
+  public:
+    virtual ~SortedColumnIndex() noexcept override = default;
+
+    // Allocate an empty index. Returns NULL on failure.
+    static ColumnIndexBase<T>* create() noexcept
+    {
+        return new(std::nothrow) SortedColumnIndex{};
+    }
+
+    virtual ColumnIndexType type() const noexcept override
+    {
+        return ColumnIndexType::INDEX_SORTED;
+    }
+
+    virtual bool find_range(const T& lo, const T& hi, std::vector<std::size_t>& outRows) const noexcept override
+    {
+        if (this->mBuckets.key_comp()(hi, lo))
+        {
+            return true;
+        }
+
+        const typename MapType::const_iterator last = this->mBuckets.upper_bound(hi);
+        for (typename MapType::const_iterator iter = this->mBuckets.lower_bound(lo); iter != last; ++iter)
+        {
+            outRows.insert(outRows.end(), iter->second.begin(), iter->second.end());
+        }
+
+        return true;
+    }
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Column Index
+ *
+ * Optional index of a single column.
+ *
+ * Writes which bypass per-row updates, such as a rollback, mark the index
+ * stale. A stale index ignores per-row updates and must be rebuilt from its
+ * column before the next lookup. Direct writes to a page of the column
+ * instead record the page's current keys, so the next sync only re-indexes
+ * those rows. Inserting or removing rows while pages are pending, or
+ * recording more than half of the column, falls back to a full rebuild.
+ *
+ * Copies only keep the kind of index. Their contents start out stale and
+ * are allocated on the first rebuild, keeping world clones and snapshots
+ * from copying every key.
+-----------------------------------------------------------------------------*/
+template <typename T>
+class ColumnIndex
+{
+  public:
+    typedef ColumnIndexBase<T>* (*factory_type)();
+
+  private:
+    factory_type mFactory;
+
+    ColumnIndexType mType;
+
+    utils::Pointer<ColumnIndexBase<T>> mIndex;
+
+    bool mStale;
+
+    // Pages written since the last sync, in the order they were recorded.
+    std::vector<std::size_t> mDirtyPages;
+
+    // One flag per page of the column, set while a page is pending.
+    std::vector<bool> mDirtyPageFlags;
+
+    // Keys which the rows of each pending page were indexed with.
+    std::vector<T> mDirtyKeys;
+
+    void _clear_dirty_pages() noexcept;
+
+  public:
+    ~ColumnIndex() noexcept = default;
+
+    ColumnIndex() noexcept;
+
+    ColumnIndex(const ColumnIndex& index) noexcept;
+
+    ColumnIndex(ColumnIndex&& index) noexcept;
+
+    ColumnIndex& operator=(const ColumnIndex& index) noexcept;
+
+    ColumnIndex& operator=(ColumnIndex&& index) noexcept;
+
+    ColumnIndexType type() const noexcept;
+
+    // Replace the current index with one allocated by "pFactory", or remove
+    // it by passing NULL. New indices start out stale. Returns false if the
+    // new index could not be allocated, leaving the current one in place.
+    bool reset(factory_type pFactory) noexcept;
+
+    bool is_stale() const noexcept;
+
+    void invalidate() noexcept;
+
+    // Record the keys of a page before it gets written to directly. Must be
+    // called before any row of the page changes.
+    template <typename ArrayType>
+    void invalidate_page(const ArrayType& column, std::size_t pageId) noexcept;
+
+    void insert(const T& key, std::size_t row) noexcept;
+
+    void erase(const T& key, std::size_t row) noexcept;
+
+    void clear() noexcept;
+
+    // Rebuild a stale index from the first "numRows" values of a column, or
+    // re-index the rows of pending pages. Returns false if the index could
+    // not be built, in which case it stays stale and lookups must scan the
+    // column instead.
+    template <typename ArrayType>
+    bool sync(const ArrayType& column, std::size_t numRows) noexcept;
+
+    // Returns NULL if the column is not indexed, or the index is stale or
+    // has pending pages.
+    const ColumnIndexBase<T>* get() const noexcept;
+
+    MemoryStats memory_stats() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+template <typename T>
+ColumnIndex<T>::ColumnIndex() noexcept :
+    mFactory{nullptr},
+    mType{ColumnIndexType::INDEX_NONE},
+    mIndex{nullptr},
+    mStale{false}
+{}
+
+
+
+/*-------------------------------------
+ * Copy Constructor
+-------------------------------------*/
+template <typename T>
+ColumnIndex<T>::ColumnIndex(const ColumnIndex& index) noexcept :
+    mFactory{index.mFactory},
+    mType{index.mType},
+    mIndex{nullptr},
+    mStale{index.mFactory != nullptr}
+{}
+
+
+
+/*-------------------------------------
+ * Move Constructor
+-------------------------------------*/
+template <typename T>
+ColumnIndex<T>::ColumnIndex(ColumnIndex&& index) noexcept :
+    mFactory{index.mFactory},
+    mType{index.mType},
+    mIndex{std::move(index.mIndex)},
+    mStale{index.mStale},
+    mDirtyPages{std::move(index.mDirtyPages)},
+    mDirtyPageFlags{std::move(index.mDirtyPageFlags)},
+    mDirtyKeys{std::move(index.mDirtyKeys)}
+{
+    index.mFactory = nullptr;
+    index.mType = ColumnIndexType::INDEX_NONE;
+    index.mStale = false;
+}
+
+
+
+/*-------------------------------------
+ * Copy Operator
+-------------------------------------*/
+template <typename T>
+ColumnIndex<T>& ColumnIndex<T>::operator=(const ColumnIndex& index) noexcept
+{
+    if (this != &index)
+    {
+        mFactory = index.mFactory;
+        mType = index.mType;
+        mIndex.reset(nullptr);
+        mStale = mFactory != nullptr;
+        _clear_dirty_pages();
+    }
+
+    return *this;
+}
+
+
+
+/*-------------------------------------
+ * Move Operator
+-------------------------------------*/
+template <typename T>
+ColumnIndex<T>& ColumnIndex<T>::operator=(ColumnIndex&& index) noexcept
+{
+    if (this != &index)
+    {
+        mFactory = index.mFactory;
+        mType = index.mType;
+        mIndex = std::move(index.mIndex);
+        mStale = index.mStale;
+        mDirtyPages = std::move(index.mDirtyPages);
+        mDirtyPageFlags = std::move(index.mDirtyPageFlags);
+        mDirtyKeys = std::move(index.mDirtyKeys);
+        index.mFactory = nullptr;
+        index.mType = ColumnIndexType::INDEX_NONE;
+        index.mStale = false;
+    }
+
+    return *this;
+}
+
+
+
+/*-------------------------------------
+ * Kind of index
+-------------------------------------*/
+template <typename T>
+inline ColumnIndexType ColumnIndex<T>::type() const noexcept
+{
+    return mType;
+}
+
+
+
+/*-------------------------------------
+ * Replace the index
+-------------------------------------*/
+template <typename T>
+bool ColumnIndex<T>::reset(factory_type pFactory) noexcept
+{
+    ColumnIndexBase<T>* const pIndex = pFactory ? pFactory() : nullptr;
+    if (pFactory && !pIndex)
+    {
+        return false;
+    }
+
+    mFactory = pFactory;
+    mType = pIndex ? pIndex->type() : ColumnIndexType::INDEX_NONE;
+    mIndex.reset(pIndex);
+    mStale = pIndex != nullptr;
+    _clear_dirty_pages();
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Check for a pending rebuild
+-------------------------------------*/
+template <typename T>
+inline bool ColumnIndex<T>::is_stale() const noexcept
+{
+    return mStale;
+}
+
+
+
+/*-------------------------------------
+ * Require a rebuild
+-------------------------------------*/
+template <typename T>
+inline void ColumnIndex<T>::invalidate() noexcept
+{
+    mStale = mFactory != nullptr;
+    _clear_dirty_pages();
+}
+
+
+
+/*-------------------------------------
+ * Forget pending pages
+-------------------------------------*/
+template <typename T>
+inline void ColumnIndex<T>::_clear_dirty_pages() noexcept
+{
+    for (std::size_t pageId : mDirtyPages)
+    {
+        mDirtyPageFlags[pageId] = false;
+    }
+
+    mDirtyPages.clear();
+    mDirtyKeys.clear();
+}
+
+
+
+/*-------------------------------------
+ * Require a page to be re-indexed
+-------------------------------------*/
+template <typename T>
+template <typename ArrayType>
+void ColumnIndex<T>::invalidate_page(const ArrayType& column, std::size_t pageId) noexcept
+{
+    // Unbuilt and stale indices are rebuilt in full anyway
+    if (!mIndex || mStale || (pageId < mDirtyPageFlags.size() && mDirtyPageFlags[pageId]))
+    {
+        return;
+    }
+
+    const std::size_t numRows = column.page_count(pageId);
+
+    // Patching costs more than a rebuild once most rows were written
+    if ((mDirtyKeys.size() + numRows) * 2 > column.size())
+    {
+        invalidate();
+        return;
+    }
+
+    try
+    {
+        if (pageId >= mDirtyPageFlags.size())
+        {
+            mDirtyPageFlags.resize(pageId + 1, false);
+        }
+
+        mDirtyPages.push_back(pageId);
+        mDirtyKeys.insert(mDirtyKeys.end(), column.page(pageId), column.page(pageId) + numRows);
+        mDirtyPageFlags[pageId] = true;
+    }
+    catch (const std::bad_alloc&)
+    {
+        invalidate();
+    }
+}
+
+
+
+/*-------------------------------------
+ * Add a row
+-------------------------------------*/
+template <typename T>
+inline void ColumnIndex<T>::insert(const T& key, std::size_t row) noexcept
+{
+    if (!mDirtyKeys.empty())
+    {
+        invalidate();
+    }
+    else if (mIndex && !mStale && !mIndex->insert(key, row))
+    {
+        mStale = true;
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove a row
+-------------------------------------*/
+template <typename T>
+inline void ColumnIndex<T>::erase(const T& key, std::size_t row) noexcept
+{
+    // Pending rows may still be indexed by their previous keys
+    if (!mDirtyKeys.empty())
+    {
+        invalidate();
+    }
+    else if (mIndex && !mStale)
+    {
+        mIndex->erase(key, row);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove all rows
+-------------------------------------*/
+template <typename T>
+inline void ColumnIndex<T>::clear() noexcept
+{
+    _clear_dirty_pages();
+
+    if (mIndex)
+    {
+        mIndex->clear();
+        mStale = false;
+    }
+    else
+    {
+        mStale = mFactory != nullptr;
+    }
+}
+
+
+
+/*-------------------------------------
+ * Rebuild a stale index
+-------------------------------------*/
+template <typename T>
+template <typename ArrayType>
+bool ColumnIndex<T>::sync(const ArrayType& column, std::size_t numRows) noexcept
+{
+    if (!mDirtyKeys.empty())
+    {
+        std::size_t keyId = 0;
+
+        for (std::size_t pageId : mDirtyPages)
+        {
+            const std::size_t firstRow = pageId * ArrayType::PAGE_SIZE;
+
+            for (std::size_t row = firstRow; row < firstRow + column.page_count(pageId); ++row)
+            {
+                mIndex->erase(mDirtyKeys[keyId++], row);
+                mStale = mStale || !mIndex->insert(column[row], row);
+            }
+        }
+
+        _clear_dirty_pages();
+    }
+
+    if (!mStale)
+    {
+        return mIndex != nullptr;
+    }
+
+    if (!mIndex)
+    {
+        mIndex.reset(mFactory());
+        if (!mIndex)
+        {
+            return false;
+        }
+    }
+
+    mIndex->clear();
+
+    for (std::size_t row = 0; row < numRows; ++row)
+    {
+        if (!mIndex->insert(column[row], row))
+        {
+            // Release the partial index rather than keep a stale copy
+            mIndex->clear();
+            return false;
+        }
+    }
+
+    mStale = false;
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Index implementation
+-------------------------------------*/
+template <typename T>
+inline const ColumnIndexBase<T>* ColumnIndex<T>::get() const noexcept
+{
+    return (mStale || !mDirtyKeys.empty()) ? nullptr : mIndex.get();
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+template <typename T>
+inline MemoryStats ColumnIndex<T>::memory_stats() const noexcept
+{
+    MemoryStats stats = mIndex ? mIndex->memory_stats() : MemoryStats{0, 0, 0};
+
+    stats.reservedBytes += mDirtyPages.capacity() * sizeof(std::size_t);
+    stats.reservedBytes += mDirtyPageFlags.capacity() / 8;
+    stats.reservedBytes += mDirtyKeys.capacity() * sizeof(T);
+
+    return stats;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_COLUMN_INDEX_HPP */
@@ -2,10 +2,14 @@
 #ifndef LS_GAME_COMPONENT_HPP
 #define LS_GAME_COMPONENT_HPP
 
+#include <algorithm> // std::stable_sort
+#include <cstdint> // uint64_t
 #include <cstdlib> // size_t
-#include <unordered_set>
+#include <vector>
 
+#include "lightsky/game/ComponentProfiler.hpp"
 #include "lightsky/game/Entity.hpp"
+#include "lightsky/game/EntitySet.hpp"
 
 
 
@@ -16,6 +20,10 @@ namespace game
 
 
 
+class RollbackBuffer;
+
+
+
 enum class ComponentAddStatus : unsigned
 {
     ADD_ERR_NO_MEMORY,
@@ -33,11 +41,49 @@ enum class ComponentRemoveStatus : unsigned
     REMOVE_OK
 };
 
+// Order in which "Component::update()" visits awake entities.
+enum class ComponentOrder : unsigned
+{
+    // Packed order, which depends on the history of insertions and removals.
+    ORDER_PACKED,
+
+    // Ascending entity index, identical for any two components holding the
+    // same entities.
+    ORDER_SORTED
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Listener
+ *
+ * Receives notifications whenever entities are added to or removed from a
+ * component. Each notification is sent after the modification took place.
+-----------------------------------------------------------------------------*/
+class ComponentListener
+{
+  public:
+    virtual ~ComponentListener() noexcept {}
+
+    virtual void on_insert(std::size_t componentId, const Entity& e) noexcept = 0;
+
+    virtual void on_erase(std::size_t componentId, const Entity& e) noexcept = 0;
+
+    // Sent once after a batch of entities was removed. Defaults to one call
+    // to "on_erase()" per entity.
+    virtual void on_erase_batch(std::size_t componentId, const std::vector<Entity>& entities) noexcept;
+
+    // Sent when all entities within a component were replaced at once.
+    virtual void on_reset(std::size_t componentId) noexcept = 0;
+};
+
 
 
 class Component
 {
     friend class ECSDatabase;
+    friend class ComponentUpdateTimer;
+    friend class RollbackBuffer;
 
   private:
     static std::size_t _increment_component_id() noexcept;
@@ -45,19 +91,105 @@ class Component
     template <typename T>
     static std::size_t registration_id() noexcept;
 
+    // Assigned by the ECSDatabase which owns *this. Copies of a component are
+    // not attached to any listener.
+    std::size_t mRegistrationId;
+
+    ComponentListener* mListener;
+
+    // Time-slicing of "update()". One slice with no budget updates every
+    // entity on each call.
+    std::size_t mUpdateSlices;
+
+    uint64_t mUpdateBudget;
+
+    // Packed index of the next entity visited by a time-sliced update.
+    std::size_t mUpdateCursor;
+
+    // Entities put to sleep by the owning ECSDatabase. Dormant entities
+    // which are inserted into *this skip the awake prefix.
+    const EntitySet* mDormantEntities;
+
+    // Entities before this packed index are awake. Dormant entities are
+    // kept after it.
+    std::size_t mNumActive;
+
+    ComponentOrder mOrder;
+
+    // Set whenever packed entities are added, removed, or moved.
+    bool mOrderDirty;
+
+  #ifdef LS_GAME_ENABLE_PROFILING
+    // Receives update timings. Copies of a component are not profiled.
+    ComponentProfiler* mProfiler = nullptr;
+
+    // Entities visited by the current update. Defaults to the awake prefix,
+    // updates which visit fewer entities overwrite it.
+    std::size_t mNumUpdated = 0;
+  #endif
+
+    // Remove the entity at a packed index without notifying the listener.
+    bool _erase_row(std::size_t index) noexcept;
+
+    // Used by "ECSDatabase::compact()". Neither notifies the listener.
+    bool _rename(const Entity& from, const Entity& to) noexcept;
+
+    bool _swap(std::size_t indexA, std::size_t indexB) noexcept;
+
+    // Move an entity across the boundary of the awake prefix. Used by
+    // "ECSDatabase::sleep_entity()" and "ECSDatabase::wake_entity()".
+    bool _sleep(const Entity& e) noexcept;
+
+    bool _wake(const Entity& e) noexcept;
+
   protected:
-    std::unordered_set<Entity> mEntities;
+    // Packed, copy-on-write entity storage. Copies of a component share
+    // pages until either copy modifies them.
+    EntitySet mEntities;
+
+    // Hooks for components which keep per-entity data in the same packed
+    // order as "mEntities".
+
+    // Called after an entity was appended to "mEntities" at "index". Return
+    // false if its data could not be allocated, reverting the insertion.
+    virtual bool insert_data(std::size_t index) noexcept;
+
+    // Called before the entity at "index" is replaced by the last entity
+    // within "mEntities", which is then removed. Return false if the data
+    // could not be moved, cancelling the removal.
+    virtual bool erase_data(std::size_t index) noexcept;
+
+    // Called after all entities were removed from "mEntities".
+    virtual void clear_data() noexcept;
+
+    // Called after the entities at two packed positions were exchanged.
+    // Return false, leaving the data untouched, if it could not be swapped.
+    // The entities are then swapped back.
+    virtual bool swap_data(std::size_t indexA, std::size_t indexB) noexcept;
+
+    // Called from "shrink_to_fit()" to release unused data capacity.
+    virtual void shrink_data() noexcept;
+
+    // Called after a rollback replaced all tracked data without any of the
+    // hooks above. State derived from that data must be rebuilt.
+    virtual void restore_data() noexcept;
 
   public:
+    enum : std::size_t
+    {
+        // Entities updated between checks of the update budget.
+        UPDATE_BUDGET_INTERVAL = 32
+    };
+
     virtual ~Component() noexcept = 0;
 
     Component() noexcept;
 
-    Component(const Component&) = delete;
+    Component(const Component&);
 
     Component(Component&&) noexcept;
 
-    Component& operator=(const Component&) = delete;
+    Component& operator=(const Component&);
 
     Component& operator=(Component&&) noexcept;
 
@@ -65,19 +197,121 @@ class Component
 
     ComponentRemoveStatus erase(const Entity& e) noexcept;
 
+    // Remove a batch of entities in a single pass, sending the listener one
+    // notification. Entities which are not within *this are skipped, and
+    // those which could not be removed are appended to "pFailed" if it's
+    // not NULL. Returns the number of entities removed.
+    std::size_t erase(const std::vector<Entity>& entities, std::vector<Entity>* pFailed = nullptr) noexcept;
+
     bool contains(const Entity& e) const noexcept;
 
     size_t size() const noexcept;
 
+    // Number of awake entities, which occupy the front of the packed array.
+    std::size_t num_active() const noexcept;
+
+    bool is_active(const Entity& e) const noexcept;
+
+    // Read-only access to all entities within *this.
+    const EntitySet& entities() const noexcept;
+
     void clear() noexcept;
 
+    // Release unused storage back to the allocator.
+    void shrink_to_fit() noexcept;
+
+    // Append the data of the entity at a packed index to "outData". Used to
+    // stream entities out of a database. Returns false if the data cannot be
+    // serialized, which is the default so that data is never silently lost.
+    // Components without per-entity data should override this to write
+    // nothing and return true.
+    virtual bool serialize_data(std::size_t index, std::vector<char>& outData) const noexcept;
+
+    // Restore data written by "serialize_data()" into the entity at a packed
+    // index. Returns false if the data is malformed.
+    virtual bool deserialize_data(std::size_t index, const char* pData, std::size_t numBytes) noexcept;
+
     virtual void update_entity(const Entity& e) noexcept = 0;
 
+    // Overrides which should be profiled can begin with
+    // LS_GAME_PROFILE_UPDATE(*this).
+
+    // Register all paged storage of *this with a rollback buffer. Components
+    // which keep their data within PagedArrays should override this and
+    // call both "rb.track()" and the base implementation.
+    virtual void track_history(RollbackBuffer& rb) noexcept;
+
+    // Report the memory held by *this. Components which store additional
+    // per-entity data should override this and add it to the result of the
+    // base implementation.
+    virtual MemoryStats memory_stats() const noexcept;
+
+    // Spread "update()" across "numSlices" calls, each visiting the next
+    // 1/numSlices of all awake entities in round-robin order. Zero is treated as
+    // one slice.
+    void update_slices(std::size_t numSlices) noexcept;
+
+    std::size_t update_slices() const noexcept;
+
+    // Stop each call to "update()" once "microseconds" have elapsed, resuming
+    // with the next entity on the following call. The clock is read every
+    // UPDATE_BUDGET_INTERVAL entities, so at least that many are updated
+    // unless a slice is smaller. Zero disables the budget.
+    void update_budget(uint64_t microseconds) noexcept;
+
+    uint64_t update_budget() const noexcept;
+
+    // Packed index of the entity which the next time-sliced update starts
+    // from.
+    std::size_t update_cursor() const noexcept;
+
+    // With ORDER_SORTED, awake entities are sorted by index before each
+    // update which follows a structural change. Sorted components also split
+    // into identical chunks on every peer, so chunks may be updated in
+    // parallel through "update_range()" as long as their results are merged
+    // with "merge_entity_results()".
+    void iteration_order(ComponentOrder order) noexcept;
+
+    ComponentOrder iteration_order() const noexcept;
+
+    // Sort the awake prefix by entity index, unless it's already sorted.
+    // Overrides of "update()" which depend on iteration order should call
+    // this first. Returns false if a shared page could not be duplicated.
+    bool sort_entities() noexcept;
+
+    // Calls "update_entity()" for every awake entity, or for the next slice
+    // of awake entities if time-slicing is enabled.
     virtual void update() noexcept;
+
+    // Calls "update_entity()" for the awake entities at packed positions
+    // [first, first+count), without sorting, slicing, or profiling. Disjoint
+    // ranges may be updated from separate threads, provided no entity is
+    // inserted, removed, or put to sleep until all of them finish. Call
+    // "sort_entities()" beforehand for a deterministic order.
+    void update_range(std::size_t first, std::size_t count) noexcept;
 };
 
 
 
+/*-------------------------------------
+ * Deterministic merge of parallel results
+ *
+ * Orders values produced by "update_range()" on separate threads by the index
+ * of the entity which produced them, using "entityOf(const T&)". Values of the
+ * same entity keep the order they were appended in, so the result does not
+ * depend on which thread updated which range.
+-------------------------------------*/
+template <typename T, typename EntityFunc>
+void merge_entity_results(std::vector<T>& results, EntityFunc entityOf) noexcept
+{
+    std::stable_sort(results.begin(), results.end(), [&](const T& a, const T& b) noexcept->bool
+    {
+        return entity_index(entityOf(a)) < entity_index(entityOf(b));
+    });
+}
+
+
+
 #ifndef LS_GAME_REGISTER_COMPONENT
     #define LS_GAME_REGISTER_COMPONENT( ComponentType ) \
         template <> std::size_t ls::game::Component::registration_id<ComponentType>() noexcept \
@@ -91,7 +325,7 @@ class Component
 
 inline bool Component::contains(const Entity& e) const noexcept
 {
-    return mEntities.count(e) > 0;
+    return mEntities.contains(e);
 }
 
 
@@ -103,9 +337,86 @@ inline size_t Component::size() const noexcept
 
 
 
+inline std::size_t Component::num_active() const noexcept
+{
+    return mNumActive;
+}
+
+
+
+inline bool Component::is_active(const Entity& e) const noexcept
+{
+    return mEntities.contains(e) && mEntities.index_of(e) < mNumActive;
+}
+
+
+
+inline const EntitySet& Component::entities() const noexcept
+{
+    return mEntities;
+}
+
+
+
+inline void Component::update_slices(std::size_t numSlices) noexcept
+{
+    mUpdateSlices = numSlices ? numSlices : 1;
+}
+
+
+
+inline std::size_t Component::update_slices() const noexcept
+{
+    return mUpdateSlices;
+}
+
+
+
+inline void Component::update_budget(uint64_t microseconds) noexcept
+{
+    mUpdateBudget = microseconds;
+}
+
+
+
+inline uint64_t Component::update_budget() const noexcept
+{
+    return mUpdateBudget;
+}
+
+
+
+inline std::size_t Component::update_cursor() const noexcept
+{
+    return mUpdateCursor;
+}
+
+
+
+inline void Component::iteration_order(ComponentOrder order) noexcept
+{
+    mOrder = order;
+}
+
+
+
+inline ComponentOrder Component::iteration_order() const noexcept
+{
+    return mOrder;
+}
+
+
+
 inline void Component::clear() noexcept
 {
     mEntities.clear();
+    mNumActive = 0;
+    clear_data();
+
+    if (mListener)
+    {
+        mListener->on_reset(mRegistrationId);
+    }
 }
 
 
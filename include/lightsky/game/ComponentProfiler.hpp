@@ -0,0 +1,178 @@
+
+#ifndef LS_GAME_COMPONENT_PROFILER_HPP
+#define LS_GAME_COMPONENT_PROFILER_HPP
+
+#include <cstdint> // uint64_t
+#include <cstdlib> // size_t
+#include <vector>
+
+#include "lightsky/game/ThreadBuffers.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+class Component;
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Update Timing
+ *
+ * Summary of the most recent "Component::update()" calls of a single
+ * component. Percentiles cover a rolling window of the latest
+ * ComponentProfiler::WINDOW_SIZE calls.
+-----------------------------------------------------------------------------*/
+struct ComponentTiming
+{
+    std::size_t componentId;
+
+    // Total number of recorded update calls.
+    uint64_t numUpdates;
+
+    // Most recent update.
+    uint64_t lastNanos;
+    std::size_t lastEntities;
+
+    // Wall time per update call, in nanoseconds.
+    uint64_t p50Nanos;
+    uint64_t p95Nanos;
+    uint64_t p99Nanos;
+
+    // Wall time per entity, in nanoseconds.
+    double p50NanosPerEntity;
+    double p95NanosPerEntity;
+    double p99NanosPerEntity;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Profiler
+ *
+ * Collects the wall time and entity count of component updates. Each thread
+ * writes samples into its own ring (see ThreadBuffers) so updates running on
+ * worker threads never contend with one another. Samples are gathered into
+ * per-component windows when timings are requested.
+ *
+ * Only used when the library is built with LS_GAME_ENABLE_PROFILING.
+-----------------------------------------------------------------------------*/
+class ComponentProfiler
+{
+  public:
+    enum : std::size_t
+    {
+        THREAD_BUFFER_SIZE = 4096,
+        WINDOW_SIZE = 1024
+    };
+
+    struct Sample
+    {
+        std::size_t componentId;
+        uint64_t nanos;
+        std::size_t numEntities;
+    };
+
+  private:
+    struct Window
+    {
+        uint64_t numUpdates;
+        Sample last;
+        std::size_t next;
+        std::vector<Sample> samples;
+    };
+
+    // Samples not yet gathered into a window.
+    ThreadBuffers<Sample, THREAD_BUFFER_SIZE> mBuffers;
+
+    // Collected samples, indexed by component registration ID.
+    std::vector<Window> mWindows;
+
+    void _collect() noexcept;
+
+  public:
+    ~ComponentProfiler() noexcept = default;
+
+    ComponentProfiler() noexcept = default;
+
+    ComponentProfiler(const ComponentProfiler&) = delete;
+
+    // Profilers must not be moved while any thread is recording samples.
+    ComponentProfiler(ComponentProfiler&&) noexcept = default;
+
+    ComponentProfiler& operator=(const ComponentProfiler&) = delete;
+
+    ComponentProfiler& operator=(ComponentProfiler&&) noexcept = default;
+
+    // Record an update from the calling thread. Lock-free and wait-free.
+    void record(std::size_t componentId, uint64_t nanos, std::size_t numEntities) noexcept;
+
+    // Retrieve the timings of a component. Must only be called from one
+    // thread at a time. Returns false if no updates were recorded.
+    bool timing(std::size_t componentId, ComponentTiming& outTiming) noexcept;
+
+    // Discard all samples of a component.
+    void reset(std::size_t componentId) noexcept;
+
+    // Discard all samples.
+    void clear() noexcept;
+
+    // Number of samples discarded because they were recorded faster than
+    // they were collected.
+    uint64_t num_dropped() const noexcept;
+
+    // Retrieve the current time, in nanoseconds.
+    static uint64_t now() noexcept;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Update Timer
+ *
+ * Records the lifetime of a scope as one update of a component, along with
+ * the number of entities it visited. Components which override
+ * "Component::update()" can use LS_GAME_PROFILE_UPDATE() to be included in
+ * profiling.
+-----------------------------------------------------------------------------*/
+class ComponentUpdateTimer
+{
+  private:
+    Component& mComponent;
+
+    uint64_t mStartTime;
+
+  public:
+    ~ComponentUpdateTimer() noexcept;
+
+    ComponentUpdateTimer(Component& c) noexcept;
+
+    ComponentUpdateTimer(const ComponentUpdateTimer&) = delete;
+
+    ComponentUpdateTimer(ComponentUpdateTimer&&) = delete;
+
+    ComponentUpdateTimer& operator=(const ComponentUpdateTimer&) = delete;
+
+    ComponentUpdateTimer& operator=(ComponentUpdateTimer&&) = delete;
+};
+
+
+
+#ifndef LS_GAME_PROFILE_UPDATE
+    #ifdef LS_GAME_ENABLE_PROFILING
+        #define LS_GAME_PROFILE_UPDATE( component ) \
+            const ls::game::ComponentUpdateTimer lsGameUpdateTimer{component}
+    #else
+        #define LS_GAME_PROFILE_UPDATE( component )
+    #endif
+#endif
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_COMPONENT_PROFILER_HPP */
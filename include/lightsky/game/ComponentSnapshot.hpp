@@ -0,0 +1,91 @@
+
+#ifndef LS_GAME_COMPONENT_SNAPSHOT_HPP
+#define LS_GAME_COMPONENT_SNAPSHOT_HPP
+
+#include "lightsky/game/Component.hpp"
+#include "lightsky/game/TripleBuffer.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Snapshot (type-erased interface)
+-----------------------------------------------------------------------------*/
+class ComponentSnapshotBase
+{
+  public:
+    virtual ~ComponentSnapshotBase() noexcept {}
+
+    // Copy a component into the back buffer and make it visible to readers.
+    virtual void publish(const Component& c) noexcept = 0;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Snapshot
+ *
+ * Read-only copies of a component for consumption on another thread.
+ * Component storage is copy-on-write, so publishing a snapshot only copies
+ * page pointers while the writer duplicates pages as it modifies them.
+-----------------------------------------------------------------------------*/
+template <typename ComponentType>
+class ComponentSnapshot final : public ComponentSnapshotBase
+{
+  private:
+    TripleBuffer<ComponentType> mBuffer;
+
+  public:
+    virtual ~ComponentSnapshot() noexcept override {}
+
+    ComponentSnapshot(const ComponentType& c);
+
+    virtual void publish(const Component& c) noexcept override;
+
+    // Reader thread only.
+    const ComponentType& acquire() noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+template <typename ComponentType>
+ComponentSnapshot<ComponentType>::ComponentSnapshot(const ComponentType& c) :
+    mBuffer{c}
+{}
+
+
+
+/*-------------------------------------
+ * Publish a component
+-------------------------------------*/
+template <typename ComponentType>
+void ComponentSnapshot<ComponentType>::publish(const Component& c) noexcept
+{
+    mBuffer.back() = static_cast<const ComponentType&>(c);
+    mBuffer.publish();
+}
+
+
+
+/*-------------------------------------
+ * Retrieve the latest published component
+-------------------------------------*/
+template <typename ComponentType>
+inline const ComponentType& ComponentSnapshot<ComponentType>::acquire() noexcept
+{
+    return mBuffer.acquire();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_COMPONENT_SNAPSHOT_HPP */
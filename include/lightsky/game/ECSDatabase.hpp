@@ -2,7 +2,10 @@
 #ifndef LS_GAME_DATABASE_HPP
 #define LS_GAME_DATABASE_HPP
 
-#include <unordered_set>
+#include <atomic>
+#include <cstdint> // uint8_t
+#include <new> // std::nothrow
+#include <type_traits> // std::is_copy_constructible
 #include <utility> // std::forward
 #include <vector>
 
@@ -10,7 +13,12 @@
 #include "lightsky/utils/Tuple.h"
 
 #include "lightsky/game/Entity.hpp"
+#include "lightsky/game/EntityBlock.hpp"
+#include "lightsky/game/EntitySet.hpp"
 #include "lightsky/game/Component.hpp"
+#include "lightsky/game/ComponentSnapshot.hpp"
+#include "lightsky/game/MemoryStats.hpp"
+#include "lightsky/game/QueryCache.hpp"
 
 namespace ls
 {
@@ -33,6 +41,56 @@ enum class ComponentCreateStatus
 
 
 
+enum class ECSCloneStatus
+{
+    CLONE_ERR_COMPONENT_NOT_COPYABLE,
+    CLONE_ERR_NO_MEMORY,
+    CLONE_OK
+};
+
+
+
+enum class ECSCompactStatus
+{
+    COMPACT_ERR_ENTITY_BLOCKS,
+    COMPACT_ERR_NO_MEMORY,
+    COMPACT_IN_PROGRESS,
+    COMPACT_DONE
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * An entity ID changed by "ECSDatabase::compact()".
+-----------------------------------------------------------------------------*/
+struct EntityRemap
+{
+    Entity from;
+    Entity to;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Entity Listener
+ *
+ * Receives notifications whenever an ECSDatabase destroys or renames an
+ * entity. Each notification is sent after the change took place, so the
+ * entity's ID may already be free for reuse.
+-----------------------------------------------------------------------------*/
+class EntityListener
+{
+  public:
+    virtual ~EntityListener() noexcept {}
+
+    virtual void on_destroy(const Entity& e) noexcept = 0;
+
+    // Sent for each ID changed by "ECSDatabase::compact()".
+    virtual void on_rename(const Entity& from, const Entity& to) noexcept = 0;
+};
+
+
+
 /*-----------------------------------------------------------------------------
  * ECS database.
  *
@@ -40,6 +98,10 @@ enum class ComponentCreateStatus
 -----------------------------------------------------------------------------*/
 class ECSDatabase
 {
+    friend class EntityBlock;
+    friend class RollbackBuffer;
+    friend class WorldPartition;
+
   public:
     enum : EntityIdType
     {
@@ -47,12 +109,115 @@ class ECSDatabase
     };
 
   private:
+    typedef Component* (*ComponentCloneFunc)(const Component&);
+
+    enum class CompactPhase
+    {
+        COMPACT_RENUMBER,
+        COMPACT_SORT,
+        COMPACT_SHRINK
+    };
+
+    // Progress of an incremental "compact()" pass.
+    struct CompactState
+    {
+        CompactPhase phase = CompactPhase::COMPACT_RENUMBER;
+
+        // Renumbering: one past the next ID to move, counting downwards.
+        // Sorting: the component being sorted.
+        std::size_t cursor = (std::size_t)INVALID_ENTITY;
+
+        // Sorting: the next entry of "order" and the number of entities
+        // already placed in order.
+        std::size_t row = 0;
+        std::size_t placed = 0;
+        std::vector<Entity> order;
+    };
+
     std::vector<utils::Pointer<Component>> mComponents;
 
-    std::unordered_set<Entity> mEntities;
+    // Copy-constructors for each component, indexed by registration ID.
+    // NULL if a component type is not copyable.
+    std::vector<ComponentCloneFunc> mCloneFuncs;
+
+    EntitySet mEntities;
+
+    // Entities awaiting removal through "destroy_deferred_entities()".
+    EntitySet mDeadEntities;
+
+    // Entities excluded from component updates by "sleep_entity()".
+    EntitySet mDormantEntities;
 
     std::size_t mMinEntityId;
 
+    // Generation to assign at each recycled entity index. Only used when
+    // entity IDs carry generation bits.
+    PagedArray<uint8_t> mGenerations;
+
+    std::vector<EntityBlock*> mEntityBlocks;
+
+    std::vector<EntityListener*> mEntityListeners;
+
+    // While EntityBlocks are registered, all IDs at or above this value are
+    // handed out through "mNextReservedId" rather than "mMinEntityId".
+    std::size_t mReservedIdBegin;
+
+    std::atomic_size_t mNextReservedId;
+
+    // Optional read-only copies of components, indexed by registration ID.
+    std::vector<utils::Pointer<ComponentSnapshotBase>> mSnapshots;
+
+    // Receives all entity insertions and removals from every component.
+    QueryCache mQueries;
+
+    CompactState mCompaction;
+
+    // IDs changed by "compact()" since "clear_compact_remap()".
+    std::vector<EntityRemap> mCompactRemap;
+
+  #ifdef LS_GAME_ENABLE_PROFILING
+    ComponentProfiler mProfiler;
+  #endif
+
+    void _attach_components() noexcept;
+
+    bool _prepare_query(std::vector<std::size_t>& required, std::vector<std::size_t>& excluded) const noexcept;
+
+    void _update_min_entity_id(std::size_t firstCandidate) noexcept;
+
+    Entity _make_entity(std::size_t index) const noexcept;
+
+    void _retire_entity_id(const Entity& e) noexcept;
+
+    void _notify_destroy(const Entity& e) const noexcept;
+
+    // Returns false, leaving every set untouched, if memory ran out.
+    bool _rename_entity(const Entity& from, const Entity& to) noexcept;
+
+    void _register_entity_block(EntityBlock& block) noexcept;
+
+    void _unregister_entity_block(EntityBlock& block) noexcept;
+
+    void _merge_entity_block(EntityBlock& block) noexcept;
+
+    bool _reserve_entity_ids(std::size_t count, EntityIdType& outFirstId) noexcept;
+
+    bool _compact_renumber(std::size_t& budget) noexcept;
+
+    bool _compact_sort(std::size_t& budget) noexcept;
+
+    template <typename ComponentType>
+    static Component* _clone_component(const Component& c) noexcept;
+
+    template <typename ComponentType>
+    static ComponentCloneFunc _clone_func(std::true_type) noexcept;
+
+    template <typename ComponentType>
+    static ComponentCloneFunc _clone_func(std::false_type) noexcept;
+
+    template <typename ComponentType>
+    void _register_component() noexcept;
+
   public:
     ~ECSDatabase() noexcept;
 
@@ -66,6 +231,11 @@ class ECSDatabase
 
     ECSDatabase& operator=(ECSDatabase&&) noexcept;
 
+    // Copy all entities and components into another database. Entity and
+    // component pages are shared copy-on-write between *this and the clone,
+    // so only pages which are later modified by either one get duplicated.
+    ECSCloneStatus clone(ECSDatabase& outDb) const noexcept;
+
     template <typename ComponentType>
     ComponentCreateStatus construct_component();
 
@@ -83,15 +253,228 @@ class ECSDatabase
     template <typename ComponentType>
     ComponentType* component() noexcept;
 
+    // Enable triple-buffered snapshots of a component so another thread can
+    // read it while *this is being updated. Must not be called while the
+    // reader thread is active.
+    template <typename ComponentType>
+    bool enable_snapshots() noexcept;
+
+    template <typename ComponentType>
+    void disable_snapshots() noexcept;
+
+    // Publish a copy of every snapshot-enabled component.
+    void publish_snapshots() noexcept;
+
+    // Retrieve the most recently published copy of a component. Only one
+    // thread may read snapshots at a time. Returns NULL if snapshots are not
+    // enabled for the requested component.
+    template <typename ComponentType>
+    const ComponentType* snapshot() noexcept;
+
+    // Retrieve the registration ID of a component type.
+    template <typename ComponentType>
+    static std::size_t component_id() noexcept;
+
+    // Retrieve all entities which exist in every listed component. Results
+    // are cached and patched as entities are inserted into or erased from
+    // components. The returned set remains valid until the next query.
+    // Returns NULL if any component has not been constructed.
+    template <typename... ComponentTypes>
+    const EntitySet* query() noexcept;
+
+    // Retrieve all entities which exist in each "required" component but
+    // none of the "excluded" components.
+    const EntitySet* query(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept;
+
+    // Record the entities which start or stop matching a query. Tracked
+    // queries remain cached until "untrack_query()" is called.
+    template <typename... ComponentTypes>
+    bool track_query() noexcept;
+
+    bool track_query(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept;
+
+    void untrack_query(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept;
+
+    // Retrieve the entities which started matching a tracked query since the
+    // last call to "clear_query_changes()". Returns NULL if the query is not
+    // tracked.
+    template <typename... ComponentTypes>
+    const EntitySet* query_entered() noexcept;
+
+    const EntitySet* query_entered(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept;
+
+    // Retrieve the entities which stopped matching a tracked query since the
+    // last call to "clear_query_changes()". Returns NULL if the query is not
+    // tracked.
+    template <typename... ComponentTypes>
+    const EntitySet* query_left() noexcept;
+
+    const EntitySet* query_left(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept;
+
+    // Start a new tick of query changes. Entities which entered and then left
+    // a query (or vice-versa) during a tick are not reported.
+    void clear_query_changes() noexcept;
+
+    // Set the memory budget of all cached queries, in bytes.
+    void query_cache_limit(std::size_t numBytes) noexcept;
+
+    std::size_t query_cache_limit() const noexcept;
+
+    // Bytes currently held by cached queries, as counted against the budget.
+    std::size_t query_cache_usage() const noexcept;
+
+    // Rebuild queries referencing at least "numComponents" required and
+    // excluded components by intersecting per-component membership bitmaps.
+    // Zero, the default, disables bitmaps. See QueryCache for when they pay
+    // off.
+    void query_bitmap_threshold(std::size_t numComponents) noexcept;
+
+    std::size_t query_bitmap_threshold() const noexcept;
+
+    // Send entity destructions and renames to a listener until it is
+    // removed. Listeners must outlive their registration and do not follow
+    // *this through a move.
+    void add_entity_listener(EntityListener& listener) noexcept;
+
+    void remove_entity_listener(EntityListener& listener) noexcept;
+
     Entity create_entity() noexcept;
 
-    void destroy_entity(Entity& e) noexcept;
+    // Merge all entities created through EntityBlocks into *this. Must not be
+    // called while any thread is creating entities.
+    void sync_entities() noexcept;
+
+    // Remove an entity from all components and release its ID. Returns
+    // false if a component ran out of memory while removing the entity, in
+    // which case the entity stays alive within the remaining components.
+    bool destroy_entity(Entity& e) noexcept;
+
+    // Mark an entity as destroyed and remove it from all query results. The
+    // entity remains within its components, and its ID remains in use, until
+    // "destroy_deferred_entities()" is called. Returns false if the entity
+    // does not exist, was already destroyed, or could not be destroyed.
+    bool destroy_deferred(Entity& e) noexcept;
+
+    // Remove all entities passed to "destroy_deferred()" from every
+    // component, visiting each component once. Entities which could not be
+    // removed from a component stay marked for the next call.
+    void destroy_deferred_entities() noexcept;
+
+    std::size_t num_deferred_entities() const noexcept;
+
+    // Exclude an entity from component updates without removing it from any
+    // component. Each component moves the entity behind its awake prefix, so
+    // "Component::update()" only walks awake entities. Components added to a
+    // dormant entity also keep it asleep. Returns false if the entity does
+    // not exist or memory ran out.
+    bool sleep_entity(const Entity& e) noexcept;
+
+    // Put a batch of entities to sleep. Returns the number of entities which
+    // were awake and are now dormant.
+    std::size_t sleep_entities(const std::vector<Entity>& entities) noexcept;
+
+    // Return a dormant entity to the awake prefix of each component. Returns
+    // false if the entity is not dormant or memory ran out.
+    bool wake_entity(const Entity& e) noexcept;
+
+    // Wake a batch of entities. Returns the number of entities woken.
+    std::size_t wake_entities(const std::vector<Entity>& entities) noexcept;
+
+    // Wake every dormant entity without moving any component data.
+    void wake_all_entities() noexcept;
+
+    bool is_dormant(const Entity& e) const noexcept;
+
+    std::size_t num_dormant_entities() const noexcept;
+
+    // Defragment entity IDs and component storage, spread across as many
+    // calls as needed. Each call processes at most "maxEntities" entities:
+    //
+    // 1. The highest live IDs are moved into the lowest free IDs. Each change
+    //    is appended to "compact_remap()" so external handles can be fixed.
+    // 2. Every component is re-ordered by entity ID.
+    // 3. Unused pages are released back to the allocator.
+    //
+    // Entities awaiting deferred destruction keep their IDs. Cached query
+    // results are rebuilt after IDs change, so tracked queries report renamed
+    // entities as having left and entered. Cannot run while EntityBlocks are
+    // registered.
+    ECSCompactStatus compact(std::size_t maxEntities = ~(std::size_t)0) noexcept;
+
+    const std::vector<EntityRemap>& compact_remap() const noexcept;
+
+    void clear_compact_remap() noexcept;
+
+    // Report the memory used and reserved by the entity table, each
+    // component, and the query cache. Memory held exclusively by component
+    // snapshots and rollback buffers is not included. Runs in time
+    // proportional to the number of allocated pages.
+    ECSMemoryStats memory_stats() const noexcept;
+
+    // Retrieve the timings of a component's "update()" calls. Always returns
+    // false unless the library was built with LS_GAME_ENABLE_PROFILING.
+    template <typename ComponentType>
+    bool update_timing(ComponentTiming& outTiming) noexcept;
+
+    bool update_timing(std::size_t componentId, ComponentTiming& outTiming) noexcept;
+
+    // Retrieve the timings of every component which has been updated.
+    std::vector<ComponentTiming> update_timings() noexcept;
 
     size_t num_components(Entity& e) const noexcept;
 };
 
 
 
+/*-------------------------------------
+ * Copy a component
+-------------------------------------*/
+template <typename ComponentType>
+Component* ECSDatabase::_clone_component(const Component& c) noexcept
+{
+    return new(std::nothrow) ComponentType(static_cast<const ComponentType&>(c));
+}
+
+
+
+/*-------------------------------------
+ * Copyable component types
+-------------------------------------*/
+template <typename ComponentType>
+inline ECSDatabase::ComponentCloneFunc ECSDatabase::_clone_func(std::true_type) noexcept
+{
+    return &ECSDatabase::_clone_component<ComponentType>;
+}
+
+
+
+/*-------------------------------------
+ * Non-copyable component types
+-------------------------------------*/
+template <typename ComponentType>
+inline ECSDatabase::ComponentCloneFunc ECSDatabase::_clone_func(std::false_type) noexcept
+{
+    return nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Track how to copy a component and attach it to *this
+-------------------------------------*/
+template <typename ComponentType>
+inline void ECSDatabase::_register_component() noexcept
+{
+    const std::size_t componentId = Component::registration_id<ComponentType>();
+    mCloneFuncs.resize(mComponents.size(), nullptr);
+    mCloneFuncs[componentId] = _clone_func<ComponentType>(std::is_copy_constructible<ComponentType>{});
+
+    mComponents[componentId]->mRegistrationId = componentId;
+    _attach_components();
+}
+
+
+
 /*-------------------------------------
  * Construct a component with no arguments
 -------------------------------------*/
@@ -117,6 +500,8 @@ ComponentCreateStatus ECSDatabase::construct_component()
         return ComponentCreateStatus::REGISTER_ERR_NO_MEMORY;
     }
 
+    _register_component<ComponentType>();
+
     return ComponentCreateStatus::REGISTER_OK;
 }
 
@@ -147,6 +532,8 @@ ComponentCreateStatus ECSDatabase::construct_component(Args&&... args)
         return ComponentCreateStatus::REGISTER_ERR_NO_MEMORY;
     }
 
+    _register_component<ComponentType>();
+
     return ComponentCreateStatus::REGISTER_OK;
 }
 
@@ -164,13 +551,26 @@ void ECSDatabase::destroy_component()
         return;
     }
 
+    if (componentId < mSnapshots.size())
+    {
+        mSnapshots[componentId].reset();
+    }
+
+    mQueries.remove_component(componentId);
+
+  #ifdef LS_GAME_ENABLE_PROFILING
+    mProfiler.reset(componentId);
+  #endif
+
     if ((mComponents.size()-1) == componentId)
     {
         mComponents.pop_back();
+        mCloneFuncs.resize(mComponents.size());
     }
     else
     {
         mComponents[componentId].reset();
+        mCloneFuncs[componentId] = nullptr;
     }
 }
 
@@ -204,6 +604,245 @@ ComponentType* ECSDatabase::component() noexcept
 
 
 
+/*-------------------------------------
+ * Enable component snapshots
+-------------------------------------*/
+template <typename ComponentType>
+bool ECSDatabase::enable_snapshots() noexcept
+{
+    static_assert(std::is_copy_constructible<ComponentType>::value, "Snapshots require a copyable component type.");
+
+    const std::size_t componentId = Component::registration_id<ComponentType>();
+    if (mComponents.size() <= componentId || !mComponents[componentId])
+    {
+        return false;
+    }
+
+    if (mSnapshots.size() <= componentId)
+    {
+        mSnapshots.resize(componentId+1);
+    }
+
+    if (!mSnapshots[componentId])
+    {
+        const ComponentType& c = *static_cast<const ComponentType*>(mComponents[componentId].get());
+        mSnapshots[componentId].reset(new(std::nothrow) ComponentSnapshot<ComponentType>{c});
+    }
+
+    return mSnapshots[componentId] != nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Disable component snapshots
+-------------------------------------*/
+template <typename ComponentType>
+void ECSDatabase::disable_snapshots() noexcept
+{
+    const std::size_t componentId = Component::registration_id<ComponentType>();
+    if (componentId < mSnapshots.size())
+    {
+        mSnapshots[componentId].reset();
+    }
+}
+
+
+
+/*-------------------------------------
+ * Retrieve a component snapshot
+-------------------------------------*/
+template <typename ComponentType>
+const ComponentType* ECSDatabase::snapshot() noexcept
+{
+    const std::size_t componentId = Component::registration_id<ComponentType>();
+    if (mSnapshots.size() <= componentId || !mSnapshots[componentId])
+    {
+        return nullptr;
+    }
+
+    ComponentSnapshot<ComponentType>* pSnapshot = static_cast<ComponentSnapshot<ComponentType>*>(mSnapshots[componentId].get());
+    return &pSnapshot->acquire();
+}
+
+
+
+/*-------------------------------------
+ * Retrieve a component's registration ID
+-------------------------------------*/
+template <typename ComponentType>
+inline std::size_t ECSDatabase::component_id() noexcept
+{
+    return Component::registration_id<ComponentType>();
+}
+
+
+
+/*-------------------------------------
+ * Cached multi-component query
+-------------------------------------*/
+template <typename... ComponentTypes>
+inline const EntitySet* ECSDatabase::query() noexcept
+{
+    return query(std::vector<std::size_t>{Component::registration_id<ComponentTypes>()...}, std::vector<std::size_t>{});
+}
+
+
+
+/*-------------------------------------
+ * Track query changes
+-------------------------------------*/
+template <typename... ComponentTypes>
+inline bool ECSDatabase::track_query() noexcept
+{
+    return track_query(std::vector<std::size_t>{Component::registration_id<ComponentTypes>()...}, std::vector<std::size_t>{});
+}
+
+
+
+/*-------------------------------------
+ * Entities which began matching a query
+-------------------------------------*/
+template <typename... ComponentTypes>
+inline const EntitySet* ECSDatabase::query_entered() noexcept
+{
+    return query_entered(std::vector<std::size_t>{Component::registration_id<ComponentTypes>()...}, std::vector<std::size_t>{});
+}
+
+
+
+/*-------------------------------------
+ * Entities which stopped matching a query
+-------------------------------------*/
+template <typename... ComponentTypes>
+inline const EntitySet* ECSDatabase::query_left() noexcept
+{
+    return query_left(std::vector<std::size_t>{Component::registration_id<ComponentTypes>()...}, std::vector<std::size_t>{});
+}
+
+
+
+/*-------------------------------------
+ * Start a new tick of query changes
+-------------------------------------*/
+inline void ECSDatabase::clear_query_changes() noexcept
+{
+    mQueries.clear_changes();
+}
+
+
+
+/*-------------------------------------
+ * Component update timing
+-------------------------------------*/
+template <typename ComponentType>
+inline bool ECSDatabase::update_timing(ComponentTiming& outTiming) noexcept
+{
+    return update_timing(Component::registration_id<ComponentType>(), outTiming);
+}
+
+
+
+/*-------------------------------------
+ * Number of entities pending destruction
+-------------------------------------*/
+inline std::size_t ECSDatabase::num_deferred_entities() const noexcept
+{
+    return mDeadEntities.size();
+}
+
+
+
+/*-------------------------------------
+ * Check if an entity is asleep
+-------------------------------------*/
+inline bool ECSDatabase::is_dormant(const Entity& e) const noexcept
+{
+    return mDormantEntities.contains(e);
+}
+
+
+
+/*-------------------------------------
+ * Number of sleeping entities
+-------------------------------------*/
+inline std::size_t ECSDatabase::num_dormant_entities() const noexcept
+{
+    return mDormantEntities.size();
+}
+
+
+
+/*-------------------------------------
+ * IDs changed by compaction
+-------------------------------------*/
+inline const std::vector<EntityRemap>& ECSDatabase::compact_remap() const noexcept
+{
+    return mCompactRemap;
+}
+
+
+
+/*-------------------------------------
+ * Discard the compaction remap table
+-------------------------------------*/
+inline void ECSDatabase::clear_compact_remap() noexcept
+{
+    mCompactRemap.clear();
+}
+
+
+
+/*-------------------------------------
+ * Query cache budget
+-------------------------------------*/
+inline void ECSDatabase::query_cache_limit(std::size_t numBytes) noexcept
+{
+    mQueries.memory_limit(numBytes);
+}
+
+
+
+/*-------------------------------------
+ * Query cache budget
+-------------------------------------*/
+inline std::size_t ECSDatabase::query_cache_limit() const noexcept
+{
+    return mQueries.memory_limit();
+}
+
+
+
+/*-------------------------------------
+ * Query cache size
+-------------------------------------*/
+inline std::size_t ECSDatabase::query_cache_usage() const noexcept
+{
+    return mQueries.memory_usage();
+}
+
+
+
+/*-------------------------------------
+ * Minimum width of bitmap queries
+-------------------------------------*/
+inline void ECSDatabase::query_bitmap_threshold(std::size_t numComponents) noexcept
+{
+    mQueries.bitmap_threshold(numComponents);
+}
+
+
+
+/*-------------------------------------
+ * Minimum width of bitmap queries
+-------------------------------------*/
+inline std::size_t ECSDatabase::query_bitmap_threshold() const noexcept
+{
+    return mQueries.bitmap_threshold();
+}
+
+
+
 } // end game namespace
 } // end ls namespace
 
@@ -2,6 +2,7 @@
 #ifndef LS_GAME_ENTITY_HPP
 #define LS_GAME_ENTITY_HPP
 
+#include <climits> // CHAR_BIT
 #include <cstdint> // uint32_t
 #include <cstdlib>
 #include <functional> // std::equal_to
@@ -11,7 +12,30 @@ namespace ls
 namespace game
 {
 
-typedef size_t EntityIdType;
+/*-----------------------------------------------------------------------------
+ * Entity IDs are native-width by default. Building with
+ * LS_GAME_USE_32BIT_ENTITY_IDS halves the size of every entity handle and
+ * sparse index, splitting each ID into a 24-bit index and an 8-bit
+ * generation which is bumped whenever an index is recycled.
+ *
+ * Generation shifts are split in two so native-width IDs, which have no
+ * generation bits, never shift by the full width of the type.
+-----------------------------------------------------------------------------*/
+#ifdef LS_GAME_USE_32BIT_ENTITY_IDS
+    typedef uint32_t EntityIdType;
+#else
+    typedef size_t EntityIdType;
+#endif
+
+enum : unsigned
+{
+    ENTITY_GENERATION_BITS = (sizeof(EntityIdType) == sizeof(uint32_t)) ? 8u : 0u,
+    ENTITY_INDEX_BITS = (unsigned)(sizeof(EntityIdType) * CHAR_BIT) - ENTITY_GENERATION_BITS
+};
+
+constexpr EntityIdType ENTITY_INDEX_MASK = ~(EntityIdType)0 >> ENTITY_GENERATION_BITS;
+
+constexpr EntityIdType ENTITY_GENERATION_MASK = (~(EntityIdType)0 >> (ENTITY_INDEX_BITS-1u)) >> 1u;
 
 
 
@@ -22,6 +46,36 @@ struct Entity
 
 
 
+/*-------------------------------------
+ * Index of an entity within sparse arrays
+-------------------------------------*/
+constexpr EntityIdType entity_index(const Entity& e) noexcept
+{
+    return e.id & ENTITY_INDEX_MASK;
+}
+
+
+
+/*-------------------------------------
+ * Number of times an entity's index has been recycled
+-------------------------------------*/
+constexpr EntityIdType entity_generation(const Entity& e) noexcept
+{
+    return (e.id >> (ENTITY_INDEX_BITS-1u)) >> 1u;
+}
+
+
+
+/*-------------------------------------
+ * Build an entity from an index and generation
+-------------------------------------*/
+constexpr Entity make_entity(EntityIdType index, EntityIdType generation) noexcept
+{
+    return Entity{(EntityIdType)((index & ENTITY_INDEX_MASK) | (((generation & ENTITY_GENERATION_MASK) << (ENTITY_INDEX_BITS-1u)) << 1u))};
+}
+
+
+
 } // end game namespace
 } // end ls namespace
 
@@ -0,0 +1,186 @@
+
+#ifndef LS_GAME_ENTITY_BITMAP_HPP
+#define LS_GAME_ENTITY_BITMAP_HPP
+
+#include <cstdint> // uint64_t
+#include <cstdlib> // size_t
+
+#include "lightsky/game/EntitySet.hpp"
+#include "lightsky/game/MemoryStats.hpp"
+#include "lightsky/game/PagedArray.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Entity Bitmap
+ *
+ * A set of entity indices stored as one bit per index. Bits are packed into
+ * 64-bit words within a PagedArray, whose unallocated pages read as zero, so
+ * a range of indices without any members only costs a page pointer. Set
+ * operations combine whole pages of words at a time, skipping pages which
+ * are unallocated in either operand, and release any page left empty.
+ *
+ * Copies share pages until either copy modifies them.
+-----------------------------------------------------------------------------*/
+class EntityBitmap
+{
+  public:
+    enum : std::size_t
+    {
+        BITS_PER_WORD = 64,
+        WORDS_PER_PAGE = PagedArray<uint64_t>::PAGE_SIZE,
+        BITS_PER_PAGE = BITS_PER_WORD * WORDS_PER_PAGE
+    };
+
+  private:
+    PagedArray<uint64_t> mWords;
+
+    static unsigned _lowest_bit(uint64_t word) noexcept;
+
+    static std::size_t _count_bits(uint64_t word) noexcept;
+
+  public:
+    ~EntityBitmap() noexcept = default;
+
+    EntityBitmap() noexcept = default;
+
+    EntityBitmap(const EntityBitmap&) = default;
+
+    EntityBitmap(EntityBitmap&&) noexcept = default;
+
+    EntityBitmap& operator=(const EntityBitmap&) = default;
+
+    EntityBitmap& operator=(EntityBitmap&&) noexcept = default;
+
+    // Returns false if memory ran out.
+    bool insert(std::size_t index) noexcept;
+
+    // Returns false if a shared page could not be duplicated.
+    bool erase(std::size_t index) noexcept;
+
+    bool contains(std::size_t index) const noexcept;
+
+    // Replace the contents of *this with the index of every entity within a
+    // set. Returns false if memory ran out, leaving *this empty.
+    bool assign(const EntitySet& entities) noexcept;
+
+    // Keep only the indices which are also within "b".
+    bool intersect(const EntityBitmap& b) noexcept;
+
+    // Add every index within "b".
+    bool unite(const EntityBitmap& b) noexcept;
+
+    // Remove every index within "b".
+    bool subtract(const EntityBitmap& b) noexcept;
+
+    // Number of indices within *this. Runs in time proportional to the
+    // number of allocated pages.
+    std::size_t count() const noexcept;
+
+    bool empty() const noexcept;
+
+    void clear() noexcept;
+
+    // One past the largest index which may be within *this.
+    std::size_t capacity() const noexcept;
+
+    // Call "func(index)" for every index within *this, in ascending order.
+    template <typename Func>
+    void for_each(Func&& func) const noexcept;
+
+    const PagedArray<uint64_t>& words() const noexcept;
+
+    MemoryStats memory_stats() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Position of the lowest set bit
+-------------------------------------*/
+inline unsigned EntityBitmap::_lowest_bit(uint64_t word) noexcept
+{
+  #if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctzll(word);
+  #else
+    unsigned bit = 0;
+    while (!(word & 1ull))
+    {
+        word >>= 1u;
+        ++bit;
+    }
+    return bit;
+  #endif
+}
+
+
+
+/*-------------------------------------
+ * Check for an index
+-------------------------------------*/
+inline bool EntityBitmap::contains(std::size_t index) const noexcept
+{
+    const std::size_t w = index / BITS_PER_WORD;
+    return w < mWords.size() && (mWords[w] & (1ull << (index % BITS_PER_WORD))) != 0;
+}
+
+
+
+/*-------------------------------------
+ * Largest addressable index
+-------------------------------------*/
+inline std::size_t EntityBitmap::capacity() const noexcept
+{
+    return mWords.size() * BITS_PER_WORD;
+}
+
+
+
+/*-------------------------------------
+ * Visit all indices
+-------------------------------------*/
+template <typename Func>
+void EntityBitmap::for_each(Func&& func) const noexcept
+{
+    for (std::size_t p = 0; p < mWords.num_pages(); ++p)
+    {
+        const uint64_t* pWords = mWords.page(p);
+        if (!pWords)
+        {
+            continue;
+        }
+
+        const std::size_t numWords = mWords.page_count(p);
+        const std::size_t pageBegin = p * BITS_PER_PAGE;
+
+        for (std::size_t w = 0; w < numWords; ++w)
+        {
+            for (uint64_t bits = pWords[w]; bits; bits &= bits - 1ull)
+            {
+                func(pageBegin + w * BITS_PER_WORD + _lowest_bit(bits));
+            }
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Raw word storage
+-------------------------------------*/
+inline const PagedArray<uint64_t>& EntityBitmap::words() const noexcept
+{
+    return mWords;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_ENTITY_BITMAP_HPP */
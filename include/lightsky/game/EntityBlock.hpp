@@ -0,0 +1,86 @@
+
+#ifndef LS_GAME_ENTITY_BLOCK_HPP
+#define LS_GAME_ENTITY_BLOCK_HPP
+
+#include <cstdlib> // size_t
+#include <vector>
+
+#include "lightsky/game/Entity.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+class ECSDatabase;
+
+
+
+/*-----------------------------------------------------------------------------
+ * Entity Block
+ *
+ * Per-thread entity allocator. Each block reserves a contiguous range of
+ * entity IDs from an ECSDatabase using a single atomic operation, then hands
+ * them out without further synchronization. Entities created through a block
+ * are added to the database's entity table at the next call to
+ * ECSDatabase::sync_entities().
+ *
+ * Blocks are registered with a database upon construction and must be
+ * constructed and destroyed on the thread which owns the database. Each
+ * block may then be used by one worker thread at a time.
+-----------------------------------------------------------------------------*/
+class EntityBlock
+{
+    friend class ECSDatabase;
+
+  private:
+    ECSDatabase* mDb;
+
+    std::size_t mBlockSize;
+
+    EntityIdType mNextId;
+
+    EntityIdType mEndId;
+
+    // Entities created since the last sync point.
+    std::vector<Entity> mPending;
+
+  public:
+    ~EntityBlock() noexcept;
+
+    EntityBlock(ECSDatabase& db, std::size_t blockSize = 1024) noexcept;
+
+    EntityBlock(const EntityBlock&) = delete;
+
+    EntityBlock(EntityBlock&&) = delete;
+
+    EntityBlock& operator=(const EntityBlock&) = delete;
+
+    EntityBlock& operator=(EntityBlock&&) = delete;
+
+    // Thread-safe with respect to other blocks. Returns an entity with an ID
+    // of ECSDatabase::INVALID_ENTITY if all IDs have been exhausted.
+    Entity create_entity() noexcept;
+
+    // Number of entities waiting to be merged into the database.
+    std::size_t num_pending() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Number of un-merged entities
+-------------------------------------*/
+inline std::size_t EntityBlock::num_pending() const noexcept
+{
+    return mPending.size();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_ENTITY_BLOCK_HPP */
@@ -0,0 +1,216 @@
+
+#ifndef LS_GAME_ENTITY_SET_HPP
+#define LS_GAME_ENTITY_SET_HPP
+
+#include <cstdlib> // size_t
+
+#include "lightsky/game/Entity.hpp"
+#include "lightsky/game/PagedArray.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Entity Set
+ *
+ * Sparse set of entities. Entities are kept in a packed array for iteration
+ * while a sparse, paged index maps each entity index to its packed position.
+ * Both arrays are copy-on-write so copying a set only copies page pointers.
+ *
+ * When entity IDs carry generation bits, an entity is only contained if its
+ * generation matches the packed entity sharing its index.
+-----------------------------------------------------------------------------*/
+class EntitySet
+{
+    friend class RollbackBuffer;
+
+  private:
+    // Packed array of all entities in *this.
+    PagedArray<Entity> mDense;
+
+    // Maps an entity index to (index+1) within the dense array. Zero
+    // indicates an entity is not contained within *this.
+    PagedArray<EntityIdType> mSparse;
+
+  public:
+    ~EntitySet() noexcept = default;
+
+    EntitySet() noexcept = default;
+
+    EntitySet(const EntitySet&) = default;
+
+    EntitySet(EntitySet&&) noexcept = default;
+
+    EntitySet& operator=(const EntitySet&) = default;
+
+    EntitySet& operator=(EntitySet&&) noexcept = default;
+
+    // Returns false if an entity with the same index already exists or
+    // memory ran out.
+    bool insert(const Entity& e) noexcept;
+
+    // Swap-and-pop removal. Returns false if the entity does not exist or
+    // memory ran out, in which case *this is left unmodified.
+    bool erase(const Entity& e) noexcept;
+
+    // Duplicate every shared page which "erase(e)" writes, so that a
+    // following call to "erase(e)" cannot fail.
+    bool reserve_erase(const Entity& e) noexcept;
+
+    bool contains(const Entity& e) const noexcept;
+
+    // Check for an entity of any generation at an index.
+    bool contains_index(std::size_t index) const noexcept;
+
+    // Exchange the packed positions of two entities. Returns false, leaving
+    // *this unmodified, if a shared page could not be duplicated.
+    bool swap(std::size_t indexA, std::size_t indexB) noexcept;
+
+    // Change the ID of an entity while keeping its packed position. The
+    // index of "to" must not already be in use. Returns false, leaving *this
+    // unmodified, if memory ran out. Renaming the entity back afterwards
+    // cannot fail.
+    bool rename(const Entity& from, const Entity& to) noexcept;
+
+    // Trim the sparse index to the largest contained ID and release unused
+    // pages back to the allocator.
+    void shrink_to_fit() noexcept;
+
+    // Retrieve the packed index of an entity. An entity with the same index
+    // must exist.
+    std::size_t index_of(const Entity& e) const noexcept;
+
+    std::size_t size() const noexcept;
+
+    bool empty() const noexcept;
+
+    void clear() noexcept;
+
+    const Entity& operator[](std::size_t index) const noexcept;
+
+    const PagedArray<Entity>& dense() const noexcept;
+
+    const PagedArray<EntityIdType>& sparse() const noexcept;
+
+    MemoryStats memory_stats() const noexcept;
+
+    // Ratio of entities to slots within the sparse index.
+    double load_factor() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Check if an entity exists
+-------------------------------------*/
+inline bool EntitySet::contains(const Entity& e) const noexcept
+{
+    const EntityIdType index = entity_index(e);
+
+    return index < mSparse.size()
+        && mSparse[index] != 0
+        && (ENTITY_GENERATION_BITS == 0 || mDense[mSparse[index]-1].id == e.id);
+}
+
+
+
+/*-------------------------------------
+ * Check if an entity index is in use
+-------------------------------------*/
+inline bool EntitySet::contains_index(std::size_t index) const noexcept
+{
+    return index < mSparse.size() && mSparse[index] != 0;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve the packed index of an entity
+-------------------------------------*/
+inline std::size_t EntitySet::index_of(const Entity& e) const noexcept
+{
+    return (std::size_t)mSparse[entity_index(e)] - 1;
+}
+
+
+
+/*-------------------------------------
+ * Number of entities
+-------------------------------------*/
+inline std::size_t EntitySet::size() const noexcept
+{
+    return mDense.size();
+}
+
+
+
+/*-------------------------------------
+ * Check for entities
+-------------------------------------*/
+inline bool EntitySet::empty() const noexcept
+{
+    return mDense.empty();
+}
+
+
+
+/*-------------------------------------
+ * Retrieve a packed entity
+-------------------------------------*/
+inline const Entity& EntitySet::operator[](std::size_t index) const noexcept
+{
+    return mDense[index];
+}
+
+
+
+/*-------------------------------------
+ * Packed entities
+-------------------------------------*/
+inline const PagedArray<Entity>& EntitySet::dense() const noexcept
+{
+    return mDense;
+}
+
+
+
+/*-------------------------------------
+ * Sparse entity index
+-------------------------------------*/
+inline const PagedArray<EntityIdType>& EntitySet::sparse() const noexcept
+{
+    return mSparse;
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+inline MemoryStats EntitySet::memory_stats() const noexcept
+{
+    MemoryStats stats = mDense.memory_stats();
+    stats += mSparse.memory_stats();
+    return stats;
+}
+
+
+
+/*-------------------------------------
+ * Sparse index utilization
+-------------------------------------*/
+inline double EntitySet::load_factor() const noexcept
+{
+    return mSparse.empty() ? 0.0 : ((double)mDense.size() / (double)mSparse.size());
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_ENTITY_SET_HPP */
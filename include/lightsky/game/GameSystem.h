@@ -13,6 +13,8 @@
 
 #include "lightsky/setup/Api.h"
 
+#include "lightsky/game/Tracer.hpp"
+
 
 
 namespace ls
@@ -304,6 +306,7 @@ inline bool GameSystem::start()
 -------------------------------------*/
 inline void GameSystem::run()
 {
+    LS_GAME_TRACE_SCOPE("GameSystem::run");
     update_tick_time();
     update_game_states();
 }
@@ -0,0 +1,127 @@
+
+#ifndef LS_GAME_MEMORY_STATS_HPP
+#define LS_GAME_MEMORY_STATS_HPP
+
+#include <cstdlib> // size_t
+#include <vector>
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Memory Statistics
+ *
+ * Memory consumed by a container. Pages shared between copy-on-write copies
+ * are reported in full by every owner and additionally counted within
+ * "sharedBytes".
+-----------------------------------------------------------------------------*/
+struct MemoryStats
+{
+    // Bytes occupied by live elements.
+    std::size_t usedBytes;
+
+    // Bytes allocated, including unused page slots and bookkeeping.
+    std::size_t reservedBytes;
+
+    // Bytes within pages which are referenced by more than one owner.
+    std::size_t sharedBytes;
+
+    MemoryStats& operator+=(const MemoryStats& stats) noexcept;
+
+    // Fraction of reserved memory which holds no live elements.
+    double fragmentation() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Accumulate statistics
+-------------------------------------*/
+inline MemoryStats& MemoryStats::operator+=(const MemoryStats& stats) noexcept
+{
+    usedBytes += stats.usedBytes;
+    reservedBytes += stats.reservedBytes;
+    sharedBytes += stats.sharedBytes;
+    return *this;
+}
+
+
+
+/*-------------------------------------
+ * Unused fraction of reserved memory
+-------------------------------------*/
+inline double MemoryStats::fragmentation() const noexcept
+{
+    return reservedBytes ? (1.0 - ((double)usedBytes / (double)reservedBytes)) : 0.0;
+}
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Memory Statistics
+-----------------------------------------------------------------------------*/
+struct ComponentMemoryStats
+{
+    // Registration ID, see ECSDatabase::component_id().
+    std::size_t componentId;
+
+    std::size_t numEntities;
+
+    // Ratio of entities to slots within the component's sparse entity index.
+    // Low values indicate a component holding few entities with large IDs.
+    double loadFactor;
+
+    MemoryStats storage;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * ECS Database Memory Statistics
+-----------------------------------------------------------------------------*/
+struct ECSMemoryStats
+{
+    // Entity table and pending deferred destructions.
+    MemoryStats entities;
+
+    // Ratio of live entities to slots within the entity table's sparse index.
+    double entityLoadFactor;
+
+    // Sum of all per-component statistics.
+    MemoryStats components;
+
+    MemoryStats queries;
+
+    // Component tables, clone functions, and snapshot bookkeeping.
+    MemoryStats overhead;
+
+    // Statistics of each constructed component.
+    std::vector<ComponentMemoryStats> componentStats;
+
+    MemoryStats total() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Combined statistics
+-------------------------------------*/
+inline MemoryStats ECSMemoryStats::total() const noexcept
+{
+    MemoryStats stats = entities;
+    stats += components;
+    stats += queries;
+    stats += overhead;
+    return stats;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_MEMORY_STATS_HPP */
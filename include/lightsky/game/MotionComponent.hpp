@@ -0,0 +1,133 @@
+
+#ifndef LS_GAME_MOTION_COMPONENT_HPP
+#define LS_GAME_MOTION_COMPONENT_HPP
+
+#include "lightsky/math/vec3.h"
+
+#include "lightsky/game/ColumnComponent.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Motion Component
+ *
+ * Stores the position and linear velocity of entities as six float columns.
+ * Each update integrates every position by its velocity over a fixed time
+ * step, using SSE or NEON kernels where available and a scalar loop
+ * otherwise.
+-----------------------------------------------------------------------------*/
+class MotionComponent final : public ColumnComponent<float, float, float, float, float, float>
+{
+  public:
+    enum : std::size_t
+    {
+        POSITION_X = 0,
+        POSITION_Y = 1,
+        POSITION_Z = 2,
+        VELOCITY_X = 3,
+        VELOCITY_Y = 4,
+        VELOCITY_Z = 5
+    };
+
+  private:
+    float mTimeStep;
+
+  public:
+    virtual ~MotionComponent() noexcept override = default;
+
+    MotionComponent() noexcept;
+
+    MotionComponent(const MotionComponent&) noexcept = default;
+
+    MotionComponent(MotionComponent&&) noexcept = default;
+
+    MotionComponent& operator=(const MotionComponent&) noexcept = default;
+
+    MotionComponent& operator=(MotionComponent&&) noexcept = default;
+
+    // Time step, in seconds, applied by "update()".
+    void time_step(float seconds) noexcept;
+
+    float time_step() const noexcept;
+
+    // Retrieve the position of an entity. The entity must belong to *this.
+    math::vec3 position(const Entity& e) const noexcept;
+
+    // Returns false if the entity does not belong to *this or a shared chunk
+    // could not be duplicated.
+    bool position(const Entity& e, const math::vec3& p) noexcept;
+
+    // Retrieve the velocity of an entity. The entity must belong to *this.
+    math::vec3 velocity(const Entity& e) const noexcept;
+
+    // Returns false if the entity does not belong to *this or a shared chunk
+    // could not be duplicated.
+    bool velocity(const Entity& e, const math::vec3& v) noexcept;
+
+    // Advance all awake positions by "velocity * seconds". Returns false if a
+    // shared chunk could not be duplicated, leaving later chunks unchanged.
+    bool integrate(float seconds) noexcept;
+
+    // Integrates a single entity by the current time step.
+    virtual void update_entity(const Entity& e) noexcept override;
+
+    // Integrates all entities by the current time step.
+    virtual void update() noexcept override;
+};
+
+
+
+template <>
+std::size_t Component::registration_id<MotionComponent>() noexcept;
+
+
+
+/*-------------------------------------
+ * Set the time step
+-------------------------------------*/
+inline void MotionComponent::time_step(float seconds) noexcept
+{
+    mTimeStep = seconds;
+}
+
+
+
+/*-------------------------------------
+ * Get the time step
+-------------------------------------*/
+inline float MotionComponent::time_step() const noexcept
+{
+    return mTimeStep;
+}
+
+
+
+/*-------------------------------------
+ * Get an entity's position
+-------------------------------------*/
+inline math::vec3 MotionComponent::position(const Entity& e) const noexcept
+{
+    return math::vec3{get<POSITION_X>(e), get<POSITION_Y>(e), get<POSITION_Z>(e)};
+}
+
+
+
+/*-------------------------------------
+ * Get an entity's velocity
+-------------------------------------*/
+inline math::vec3 MotionComponent::velocity(const Entity& e) const noexcept
+{
+    return math::vec3{get<VELOCITY_X>(e), get<VELOCITY_Y>(e), get<VELOCITY_Z>(e)};
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_MOTION_COMPONENT_HPP */
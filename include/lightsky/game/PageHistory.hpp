@@ -0,0 +1,354 @@
+
+#ifndef LS_GAME_PAGE_HISTORY_HPP
+#define LS_GAME_PAGE_HISTORY_HPP
+
+#include <cstdlib> // size_t
+#include <deque>
+#include <utility> // std::pair
+#include <vector>
+
+#include "lightsky/game/PagedArray.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Page History (type-erased interface)
+-----------------------------------------------------------------------------*/
+class PageHistoryBase
+{
+  public:
+    virtual ~PageHistoryBase() noexcept {}
+
+    // Capture all pages modified since the previous save.
+    virtual bool save() noexcept = 0;
+
+    // Revert unsaved changes, then undo the last "numSaves" saves.
+    virtual void restore(std::size_t numSaves) noexcept = 0;
+
+    // Forget the oldest save so it can no longer be restored.
+    virtual void drop_oldest() noexcept = 0;
+
+    virtual std::size_t num_saves() const noexcept = 0;
+
+    // Stop referencing the tracked array without modifying it. Used when the
+    // tracked array has been destroyed.
+    virtual void detach() noexcept = 0;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Page History
+ *
+ * Undo log for a single PagedArray. The history keeps a copy of the array as
+ * of the most recent save, sharing all of its pages with the array itself.
+ * Any write to the array then duplicates the written page which allows both
+ * saving and restoring to only visit pages which have changed.
+-----------------------------------------------------------------------------*/
+template <typename T, std::size_t PageSize>
+class PageHistory final : public PageHistoryBase
+{
+  private:
+    typedef typename PagedArray<T, PageSize>::Page Page;
+
+    // Pages replaced by a save, along with the array dimensions prior to it.
+    struct Delta
+    {
+        std::size_t size;
+        std::size_t numPages;
+        std::vector<std::pair<std::size_t, Page*>> pages;
+    };
+
+    PagedArray<T, PageSize>* mArray;
+
+    // Copy of the tracked array at the time of the most recent save.
+    PagedArray<T, PageSize> mBase;
+
+    std::deque<Delta> mDeltas;
+
+    static void _add_ref(Page* pPage) noexcept;
+
+    static void _release_delta(Delta& d) noexcept;
+
+  public:
+    virtual ~PageHistory() noexcept override;
+
+    PageHistory(PagedArray<T, PageSize>& a) noexcept;
+
+    PageHistory(const PageHistory&) = delete;
+
+    PageHistory(PageHistory&&) = delete;
+
+    PageHistory& operator=(const PageHistory&) = delete;
+
+    PageHistory& operator=(PageHistory&&) = delete;
+
+    virtual bool save() noexcept override;
+
+    virtual void restore(std::size_t numSaves) noexcept override;
+
+    virtual void drop_oldest() noexcept override;
+
+    virtual std::size_t num_saves() const noexcept override;
+
+    virtual void detach() noexcept override;
+};
+
+
+
+/*-------------------------------------
+ * Reference a page
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline void PageHistory<T, PageSize>::_add_ref(Page* pPage) noexcept
+{
+    if (pPage)
+    {
+        pPage->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Release all pages held by a delta
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline void PageHistory<T, PageSize>::_release_delta(Delta& d) noexcept
+{
+    for (std::pair<std::size_t, Page*>& p : d.pages)
+    {
+        PagedArray<T, PageSize>::_release_page(p.second);
+    }
+
+    d.pages.clear();
+}
+
+
+
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PageHistory<T, PageSize>::~PageHistory() noexcept
+{
+    for (Delta& d : mDeltas)
+    {
+        _release_delta(d);
+    }
+
+    if (mArray)
+    {
+        mArray->track_changes(false);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PageHistory<T, PageSize>::PageHistory(PagedArray<T, PageSize>& a) noexcept :
+    mArray{&a},
+    mBase{a},
+    mDeltas{}
+{
+    a.track_changes(true);
+    a.clear_changes();
+}
+
+
+
+/*-------------------------------------
+ * Record all modified pages
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+bool PageHistory<T, PageSize>::save() noexcept
+{
+    if (!mArray)
+    {
+        return false;
+    }
+
+    PagedArray<T, PageSize>& curr = *mArray;
+    std::vector<Page*>& basePages = mBase.mPages;
+    std::vector<Page*>& currPages = curr.mPages;
+
+    mDeltas.emplace_back();
+    Delta& d = mDeltas.back();
+    d.size = mBase.mSize;
+    d.numPages = basePages.size();
+
+    if (basePages.size() < currPages.size())
+    {
+        basePages.resize(currPages.size(), nullptr);
+    }
+
+    // Pages listed more than once will already match after the first visit
+    for (std::size_t pageId : curr.mChangedPages)
+    {
+        if (pageId >= currPages.size() || basePages[pageId] == currPages[pageId])
+        {
+            continue;
+        }
+
+        // Transfer the base array's reference into the delta
+        d.pages.emplace_back(pageId, basePages[pageId]);
+        basePages[pageId] = currPages[pageId];
+        _add_ref(currPages[pageId]);
+    }
+
+    // Pages which were removed from the array since the last save
+    for (std::size_t pageId = currPages.size(); pageId < basePages.size(); ++pageId)
+    {
+        d.pages.emplace_back(pageId, basePages[pageId]);
+    }
+
+    basePages.resize(currPages.size());
+    mBase.mSize = curr.mSize;
+    curr.clear_changes();
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Undo modifications
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+void PageHistory<T, PageSize>::restore(std::size_t numSaves) noexcept
+{
+    if (!mArray)
+    {
+        return;
+    }
+
+    PagedArray<T, PageSize>& curr = *mArray;
+    std::vector<Page*>& basePages = mBase.mPages;
+    std::vector<Page*>& currPages = curr.mPages;
+
+    // Every page which may differ between the base and tracked arrays
+    std::vector<std::size_t>& touched = curr.mChangedPages;
+
+    for (std::size_t pageId = basePages.size(); pageId < currPages.size(); ++pageId)
+    {
+        touched.push_back(pageId);
+    }
+
+    for (std::size_t pageId = currPages.size(); pageId < basePages.size(); ++pageId)
+    {
+        touched.push_back(pageId);
+    }
+
+    for (; numSaves && !mDeltas.empty(); --numSaves)
+    {
+        Delta& d = mDeltas.back();
+
+        if (basePages.size() < d.numPages)
+        {
+            for (std::size_t pageId = basePages.size(); pageId < d.numPages; ++pageId)
+            {
+                touched.push_back(pageId);
+            }
+
+            basePages.resize(d.numPages, nullptr);
+        }
+
+        for (std::pair<std::size_t, Page*>& p : d.pages)
+        {
+            if (p.first < d.numPages)
+            {
+                PagedArray<T, PageSize>::_release_page(basePages[p.first]);
+                basePages[p.first] = p.second;
+                touched.push_back(p.first);
+            }
+            else
+            {
+                PagedArray<T, PageSize>::_release_page(p.second);
+            }
+        }
+
+        for (std::size_t pageId = d.numPages; pageId < basePages.size(); ++pageId)
+        {
+            PagedArray<T, PageSize>::_release_page(basePages[pageId]);
+        }
+
+        basePages.resize(d.numPages);
+        mBase.mSize = d.size;
+
+        d.pages.clear();
+        mDeltas.pop_back();
+    }
+
+    // Point all modified pages back to the base array
+    for (std::size_t pageId = basePages.size(); pageId < currPages.size(); ++pageId)
+    {
+        PagedArray<T, PageSize>::_release_page(currPages[pageId]);
+    }
+
+    currPages.resize(basePages.size(), nullptr);
+
+    for (std::size_t pageId : touched)
+    {
+        if (pageId < currPages.size() && currPages[pageId] != basePages[pageId])
+        {
+            PagedArray<T, PageSize>::_release_page(currPages[pageId]);
+            currPages[pageId] = basePages[pageId];
+            _add_ref(currPages[pageId]);
+        }
+    }
+
+    curr.mSize = mBase.mSize;
+    curr.clear_changes();
+}
+
+
+
+/*-------------------------------------
+ * Forget the oldest save
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+void PageHistory<T, PageSize>::drop_oldest() noexcept
+{
+    if (!mDeltas.empty())
+    {
+        _release_delta(mDeltas.front());
+        mDeltas.pop_front();
+    }
+}
+
+
+
+/*-------------------------------------
+ * Number of restorable saves
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline std::size_t PageHistory<T, PageSize>::num_saves() const noexcept
+{
+    return mDeltas.size();
+}
+
+
+
+/*-------------------------------------
+ * Stop tracking an array
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline void PageHistory<T, PageSize>::detach() noexcept
+{
+    mArray = nullptr;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_PAGE_HISTORY_HPP */
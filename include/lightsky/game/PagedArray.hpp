@@ -0,0 +1,784 @@
+
+#ifndef LS_GAME_PAGED_ARRAY_HPP
+#define LS_GAME_PAGED_ARRAY_HPP
+
+#include <algorithm> // std::copy, std::fill
+#include <atomic>
+#include <cstdint> // uintptr_t
+#include <cstdlib> // size_t
+#include <new> // std::nothrow
+#include <utility> // std::move
+#include <vector>
+
+#include "lightsky/game/MemoryStats.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+template <typename T, std::size_t PageSize>
+class PageHistory;
+
+
+
+/*-----------------------------------------------------------------------------
+ * Paged Array
+ *
+ * A dynamic array built from fixed-size pages. Pages are reference-counted
+ * and shared between copies of an array. A page is only duplicated when one
+ * of its owners writes to it (copy-on-write), making copies of large arrays
+ * cost one pointer per page.
+ *
+ * Pages are allocated lazily. An unallocated page reads as if it was filled
+ * with value-initialized elements. Growing the array never moves existing
+ * elements, and popping elements releases trailing pages once a spare empty
+ * page is already held.
+ *
+ * The elements of each page begin on a PAGE_ALIGNMENT boundary. Every page
+ * holds PageSize elements, even the last, so SIMD loops may safely read past
+ * "page_count()" up to the end of a page.
+-----------------------------------------------------------------------------*/
+template <typename T, std::size_t PageSize = 1024>
+class PagedArray
+{
+    static_assert(PageSize > 0 && (PageSize & (PageSize-1)) == 0, "Page sizes must be a power of 2.");
+
+    template <typename, std::size_t>
+    friend class PageHistory;
+
+  public:
+    typedef T value_type;
+
+    enum : std::size_t
+    {
+        PAGE_SIZE = PageSize,
+        PAGE_ALIGNMENT = 64
+    };
+
+  private:
+    // Elements are placed first so they share the page's alignment.
+    struct Page
+    {
+        T data[PageSize];
+        std::atomic_size_t refs;
+    };
+
+    static_assert(alignof(Page) <= PAGE_ALIGNMENT, "Page elements exceed the maximum page alignment.");
+
+    std::vector<Page*> mPages;
+
+    std::size_t mSize;
+
+    // Pages which were allocated or duplicated since the last call to
+    // "clear_changes()". Only recorded when change tracking is enabled.
+    std::vector<std::size_t> mChangedPages;
+
+    bool mTrackChanges;
+
+    static const T& _default_value() noexcept;
+
+    static Page* _alloc_page() noexcept;
+
+    static Page* _copy_page(const Page* pSrc) noexcept;
+
+    static void _release_page(Page* pPage) noexcept;
+
+    Page* _writable_page(std::size_t pageId) noexcept;
+
+    void _mark_changed(std::size_t firstPage, std::size_t lastPage) noexcept;
+
+  public:
+    ~PagedArray() noexcept;
+
+    PagedArray() noexcept;
+
+    PagedArray(const PagedArray& a);
+
+    PagedArray(PagedArray&& a) noexcept;
+
+    PagedArray& operator=(const PagedArray& a);
+
+    PagedArray& operator=(PagedArray&& a) noexcept;
+
+    std::size_t size() const noexcept;
+
+    bool empty() const noexcept;
+
+    std::size_t num_pages() const noexcept;
+
+    std::size_t capacity() const noexcept;
+
+    const T& operator[](std::size_t index) const noexcept;
+
+    // Retrieve a writable element. Returns NULL if a shared page could not
+    // be duplicated.
+    T* writable(std::size_t index) noexcept;
+
+    bool set(std::size_t index, const T& value) noexcept;
+
+    bool push_back(const T& value) noexcept;
+
+    // Pages which become empty are released, keeping one spare page so an
+    // array oscillating around a page boundary doesn't reallocate.
+    void pop_back() noexcept;
+
+    // Grow or shrink the array. New elements are not allocated until written.
+    bool resize(std::size_t numElements) noexcept;
+
+    void clear() noexcept;
+
+    // Release all pages which contain no elements.
+    void shrink_to_fit() noexcept;
+
+    // Retrieve the number of valid elements within a page.
+    std::size_t page_count(std::size_t pageId) const noexcept;
+
+    // Retrieve a page for reading. Returns NULL if the page is unallocated.
+    const T* page(std::size_t pageId) const noexcept;
+
+    // Retrieve a page for writing, allocating or un-sharing it as needed.
+    T* writable_page(std::size_t pageId) noexcept;
+
+    // Release the storage of a page, which then reads as value-initialized
+    // elements. Pointers into the page become invalid.
+    void release_page(std::size_t pageId) noexcept;
+
+    // Determine if a page is referenced by more than one array.
+    bool is_page_shared(std::size_t pageId) const noexcept;
+
+    // Record the ID of every page which gets allocated or duplicated. A page
+    // which is shared with a copy of *this is always duplicated before its
+    // first write, so the record contains every page modified since the
+    // last copy was made.
+    void track_changes(bool doTrack) noexcept;
+
+    bool is_tracking_changes() const noexcept;
+
+    // Memory used by all elements and allocated pages. Runs in time
+    // proportional to the number of pages.
+    MemoryStats memory_stats() const noexcept;
+
+    const std::vector<std::size_t>& changed_pages() const noexcept;
+
+    void clear_changes() noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Zero-valued element for unallocated pages
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+const T& PagedArray<T, PageSize>::_default_value() noexcept
+{
+    static const T defaultVal{};
+    return defaultVal;
+}
+
+
+
+/*-------------------------------------
+ * Allocate a page
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+typename PagedArray<T, PageSize>::Page* PagedArray<T, PageSize>::_alloc_page() noexcept
+{
+    char* const pMem = static_cast<char*>(::operator new(sizeof(Page) + PAGE_ALIGNMENT, std::nothrow));
+    if (!pMem)
+    {
+        return nullptr;
+    }
+
+    // The distance to the start of the allocation is kept in the byte
+    // preceding the page. It's always within [1, PAGE_ALIGNMENT].
+    const std::size_t offset = PAGE_ALIGNMENT - ((std::uintptr_t)pMem % PAGE_ALIGNMENT);
+    char* const pAligned = pMem + offset;
+    pAligned[-1] = (char)(unsigned char)offset;
+
+    Page* pPage = new(pAligned) Page{};
+    pPage->refs.store(1, std::memory_order_relaxed);
+
+    return pPage;
+}
+
+
+
+/*-------------------------------------
+ * Duplicate a shared page
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+typename PagedArray<T, PageSize>::Page* PagedArray<T, PageSize>::_copy_page(const Page* pSrc) noexcept
+{
+    Page* pPage = _alloc_page();
+    if (pPage)
+    {
+        std::copy(pSrc->data, pSrc->data+PageSize, pPage->data);
+    }
+
+    return pPage;
+}
+
+
+
+/*-------------------------------------
+ * Drop a reference to a page
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+void PagedArray<T, PageSize>::_release_page(Page* pPage) noexcept
+{
+    if (pPage && pPage->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        char* const pAligned = reinterpret_cast<char*>(pPage);
+        const std::size_t offset = (unsigned char)pAligned[-1];
+
+        pPage->~Page();
+        ::operator delete(pAligned - offset);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Copy-on-write
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+typename PagedArray<T, PageSize>::Page* PagedArray<T, PageSize>::_writable_page(std::size_t pageId) noexcept
+{
+    Page* pPage = mPages[pageId];
+
+    if (!pPage)
+    {
+        pPage = _alloc_page();
+    }
+    else if (pPage->refs.load(std::memory_order_acquire) > 1)
+    {
+        pPage = _copy_page(pPage);
+        if (pPage)
+        {
+            _release_page(mPages[pageId]);
+        }
+    }
+    else
+    {
+        return pPage;
+    }
+
+    if (pPage)
+    {
+        mPages[pageId] = pPage;
+
+        if (mTrackChanges)
+        {
+            mChangedPages.push_back(pageId);
+        }
+    }
+
+    return pPage;
+}
+
+
+
+/*-------------------------------------
+ * Record a range of pages as modified
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+void PagedArray<T, PageSize>::_mark_changed(std::size_t firstPage, std::size_t lastPage) noexcept
+{
+    if (mTrackChanges)
+    {
+        for (std::size_t p = firstPage; p < lastPage; ++p)
+        {
+            mChangedPages.push_back(p);
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PagedArray<T, PageSize>::~PagedArray() noexcept
+{
+    clear();
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PagedArray<T, PageSize>::PagedArray() noexcept :
+    mPages{},
+    mSize{0},
+    mChangedPages{},
+    mTrackChanges{false}
+{}
+
+
+
+/*-------------------------------------
+ * Copy Constructor (shares all pages)
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PagedArray<T, PageSize>::PagedArray(const PagedArray& a) :
+    mPages{a.mPages},
+    mSize{a.mSize},
+    mChangedPages{},
+    mTrackChanges{false}
+{
+    for (Page* pPage : mPages)
+    {
+        if (pPage)
+        {
+            pPage->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Move Constructor
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PagedArray<T, PageSize>::PagedArray(PagedArray&& a) noexcept :
+    mPages{std::move(a.mPages)},
+    mSize{a.mSize},
+    mChangedPages{},
+    mTrackChanges{false}
+{
+    a.mPages.clear();
+    a.mSize = 0;
+}
+
+
+
+/*-------------------------------------
+ * Copy Operator (shares all pages)
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PagedArray<T, PageSize>& PagedArray<T, PageSize>::operator=(const PagedArray& a)
+{
+    if (this != &a)
+    {
+        for (Page* pPage : a.mPages)
+        {
+            if (pPage)
+            {
+                pPage->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        clear();
+        mPages = a.mPages;
+        mSize = a.mSize;
+
+        _mark_changed(0, mPages.size());
+    }
+
+    return *this;
+}
+
+
+
+/*-------------------------------------
+ * Move Operator
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+PagedArray<T, PageSize>& PagedArray<T, PageSize>::operator=(PagedArray&& a) noexcept
+{
+    if (this != &a)
+    {
+        clear();
+        mPages = std::move(a.mPages);
+        mSize = a.mSize;
+
+        _mark_changed(0, mPages.size());
+
+        a.mPages.clear();
+        a.mSize = 0;
+    }
+
+    return *this;
+}
+
+
+
+/*-------------------------------------
+ * Number of elements
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline std::size_t PagedArray<T, PageSize>::size() const noexcept
+{
+    return mSize;
+}
+
+
+
+/*-------------------------------------
+ * Check if there are any elements
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline bool PagedArray<T, PageSize>::empty() const noexcept
+{
+    return mSize == 0;
+}
+
+
+
+/*-------------------------------------
+ * Number of pages
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline std::size_t PagedArray<T, PageSize>::num_pages() const noexcept
+{
+    return mPages.size();
+}
+
+
+
+/*-------------------------------------
+ * Number of addressable elements
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline std::size_t PagedArray<T, PageSize>::capacity() const noexcept
+{
+    return mPages.size() * PageSize;
+}
+
+
+
+/*-------------------------------------
+ * Element retrieval (const)
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline const T& PagedArray<T, PageSize>::operator[](std::size_t index) const noexcept
+{
+    const Page* pPage = mPages[index / PageSize];
+    return pPage ? pPage->data[index % PageSize] : _default_value();
+}
+
+
+
+/*-------------------------------------
+ * Element retrieval
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline T* PagedArray<T, PageSize>::writable(std::size_t index) noexcept
+{
+    Page* pPage = _writable_page(index / PageSize);
+    return pPage ? (pPage->data + (index % PageSize)) : nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Element assignment
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline bool PagedArray<T, PageSize>::set(std::size_t index, const T& value) noexcept
+{
+    T* pElement = writable(index);
+    if (pElement)
+    {
+        *pElement = value;
+    }
+
+    return pElement != nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Append an element
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+bool PagedArray<T, PageSize>::push_back(const T& value) noexcept
+{
+    if (mSize == capacity())
+    {
+        mPages.push_back(nullptr);
+    }
+
+    if (!set(mSize, value))
+    {
+        return false;
+    }
+
+    ++mSize;
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove the last element
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline void PagedArray<T, PageSize>::pop_back() noexcept
+{
+    if (mSize)
+    {
+        // reset the element so pages which are re-used read as new. Shared
+        // pages are left alone rather than duplicated to clear one element,
+        // "resize()" clears any such leftovers if the array grows again.
+        --mSize;
+        if (!is_page_shared(mSize / PageSize))
+        {
+            set(mSize, _default_value());
+        }
+
+        // The page at "mSize / PageSize" is kept as a spare once emptied
+        const std::size_t spareId = mSize / PageSize;
+        if ((mSize % PageSize) == 0 && spareId+1 < mPages.size())
+        {
+            release_page(spareId+1);
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Grow or shrink
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+bool PagedArray<T, PageSize>::resize(std::size_t numElements) noexcept
+{
+    const std::size_t numPages = (numElements + PageSize - 1) / PageSize;
+
+    _mark_changed(std::min(numPages, mPages.size()), std::max(numPages, mPages.size()));
+
+    for (std::size_t p = numPages; p < mPages.size(); ++p)
+    {
+        _release_page(mPages[p]);
+    }
+
+    mPages.resize(numPages, nullptr);
+
+    // Elements popped from a shared page were never reset
+    if (numElements > mSize && is_page_shared(mSize / PageSize))
+    {
+        Page* pPage = _writable_page(mSize / PageSize);
+        if (!pPage)
+        {
+            return false;
+        }
+
+        std::fill(pPage->data + (mSize % PageSize), pPage->data + PageSize, _default_value());
+    }
+
+    // clear the tail of a partially used page
+    if (numElements < mSize && (numElements % PageSize) && mPages.back())
+    {
+        Page* pPage = _writable_page(numPages-1);
+        if (!pPage)
+        {
+            return false;
+        }
+
+        std::fill(pPage->data + (numElements % PageSize), pPage->data + PageSize, _default_value());
+    }
+
+    mSize = numElements;
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove all elements
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+void PagedArray<T, PageSize>::clear() noexcept
+{
+    _mark_changed(0, mPages.size());
+
+    for (Page* pPage : mPages)
+    {
+        _release_page(pPage);
+    }
+
+    mPages.clear();
+    mSize = 0;
+}
+
+
+
+/*-------------------------------------
+ * Release unused pages
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+void PagedArray<T, PageSize>::shrink_to_fit() noexcept
+{
+    const std::size_t numPages = (mSize + PageSize - 1) / PageSize;
+
+    _mark_changed(numPages, mPages.size());
+
+    for (std::size_t p = numPages; p < mPages.size(); ++p)
+    {
+        _release_page(mPages[p]);
+    }
+
+    mPages.resize(numPages);
+    mPages.shrink_to_fit();
+}
+
+
+
+/*-------------------------------------
+ * Number of valid elements in a page
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline std::size_t PagedArray<T, PageSize>::page_count(std::size_t pageId) const noexcept
+{
+    const std::size_t pageStart = pageId * PageSize;
+    return (pageStart >= mSize) ? 0 : std::min<std::size_t>(PageSize, mSize - pageStart);
+}
+
+
+
+/*-------------------------------------
+ * Page retrieval (const)
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline const T* PagedArray<T, PageSize>::page(std::size_t pageId) const noexcept
+{
+    const Page* pPage = mPages[pageId];
+    return pPage ? pPage->data : nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Page retrieval
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline T* PagedArray<T, PageSize>::writable_page(std::size_t pageId) noexcept
+{
+    Page* pPage = _writable_page(pageId);
+    return pPage ? pPage->data : nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Page release
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline void PagedArray<T, PageSize>::release_page(std::size_t pageId) noexcept
+{
+    if (mPages[pageId])
+    {
+        _release_page(mPages[pageId]);
+        mPages[pageId] = nullptr;
+        _mark_changed(pageId, pageId+1);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Check for page sharing
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline bool PagedArray<T, PageSize>::is_page_shared(std::size_t pageId) const noexcept
+{
+    const Page* pPage = mPages[pageId];
+    return pPage && pPage->refs.load(std::memory_order_acquire) > 1;
+}
+
+
+
+/*-------------------------------------
+ * Enable or disable change tracking
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline void PagedArray<T, PageSize>::track_changes(bool doTrack) noexcept
+{
+    mTrackChanges = doTrack;
+    if (!doTrack)
+    {
+        mChangedPages.clear();
+    }
+}
+
+
+
+/*-------------------------------------
+ * Check if changes are tracked
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline bool PagedArray<T, PageSize>::is_tracking_changes() const noexcept
+{
+    return mTrackChanges;
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+MemoryStats PagedArray<T, PageSize>::memory_stats() const noexcept
+{
+    MemoryStats stats{0, 0, 0};
+
+    stats.reservedBytes += mPages.capacity() * sizeof(Page*);
+    stats.reservedBytes += mChangedPages.capacity() * sizeof(std::size_t);
+
+    for (std::size_t p = 0; p < mPages.size(); ++p)
+    {
+        const Page* pPage = mPages[p];
+        if (!pPage)
+        {
+            continue;
+        }
+
+        // Unallocated pages hold no memory, even if they are within range
+        stats.usedBytes += page_count(p) * sizeof(T);
+        stats.reservedBytes += sizeof(Page) + PAGE_ALIGNMENT;
+
+        if (pPage->refs.load(std::memory_order_acquire) > 1)
+        {
+            stats.sharedBytes += sizeof(Page) + PAGE_ALIGNMENT;
+        }
+    }
+
+    return stats;
+}
+
+
+
+/*-------------------------------------
+ * Pages modified since the last reset
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline const std::vector<std::size_t>& PagedArray<T, PageSize>::changed_pages() const noexcept
+{
+    return mChangedPages;
+}
+
+
+
+/*-------------------------------------
+ * Reset the record of modified pages
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+inline void PagedArray<T, PageSize>::clear_changes() noexcept
+{
+    mChangedPages.clear();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_PAGED_ARRAY_HPP */
@@ -0,0 +1,173 @@
+
+#ifndef LS_GAME_ROLLBACK_BUFFER_HPP
+#define LS_GAME_ROLLBACK_BUFFER_HPP
+
+#include <cstdint> // uint64_t
+#include <deque>
+#include <new> // std::nothrow
+#include <utility> // std::move
+#include <vector>
+
+#include "lightsky/utils/Pointer.h"
+
+#include "lightsky/game/Entity.hpp"
+#include "lightsky/game/PageHistory.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+class Component;
+class ECSDatabase;
+class EntitySet;
+
+
+
+/*-----------------------------------------------------------------------------
+ * Rollback Buffer
+ *
+ * Ring of per-tick world states for rollback netcode. Only the pages of the
+ * entity table and component storage which changed during a tick are saved,
+ * so both "save_tick()" and "rollback_to()" run in time proportional to the
+ * amount of modified data rather than the size of the world.
+ *
+ * Component data which is not stored within a PagedArray registered through
+ * Component::track_history() is not captured. The tracked database must
+ * outlive *this and must not be moved. Components may be constructed or
+ * destroyed at any time, but doing so discards all saved ticks.
+-----------------------------------------------------------------------------*/
+class RollbackBuffer
+{
+  private:
+    struct SavedTick
+    {
+        uint64_t tick;
+        std::size_t minEntityId;
+
+        // Size of each tracked component's awake prefix.
+        std::vector<std::size_t> numActive;
+    };
+
+    ECSDatabase* mDb;
+
+    std::size_t mMaxTicks;
+
+    std::vector<utils::Pointer<PageHistoryBase>> mHistories;
+
+    // Components being tracked, used to detect changes in the database layout.
+    std::vector<const Component*> mComponents;
+
+    std::deque<SavedTick> mTicks;
+
+    bool _layout_changed() const noexcept;
+
+    bool _rebuild() noexcept;
+
+  public:
+    ~RollbackBuffer() noexcept;
+
+    RollbackBuffer(ECSDatabase& db, std::size_t maxTicks) noexcept;
+
+    RollbackBuffer(const RollbackBuffer&) = delete;
+
+    RollbackBuffer(RollbackBuffer&&) = delete;
+
+    RollbackBuffer& operator=(const RollbackBuffer&) = delete;
+
+    RollbackBuffer& operator=(RollbackBuffer&&) = delete;
+
+    // Track changes to a paged array. Called from Component::track_history().
+    template <typename T, std::size_t PageSize>
+    bool track(PagedArray<T, PageSize>& a) noexcept;
+
+    bool track(EntitySet& entities) noexcept;
+
+    // Save all changes made since the previous tick. Tick numbers must
+    // increase with each save. The oldest tick is discarded once more than
+    // "max_ticks()" ticks have been saved.
+    bool save_tick(uint64_t tick) noexcept;
+
+    // Restore the database to the state it was in when "tick" was saved.
+    // All newer ticks and any pending deferred entity destructions are
+    // discarded.
+    bool rollback_to(uint64_t tick) noexcept;
+
+    // Release all saved ticks and stop tracking changes.
+    void clear() noexcept;
+
+    std::size_t max_ticks() const noexcept;
+
+    std::size_t num_ticks() const noexcept;
+
+    uint64_t oldest_tick() const noexcept;
+
+    uint64_t newest_tick() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Track a paged array
+-------------------------------------*/
+template <typename T, std::size_t PageSize>
+bool RollbackBuffer::track(PagedArray<T, PageSize>& a) noexcept
+{
+    utils::Pointer<PageHistoryBase> history{new(std::nothrow) PageHistory<T, PageSize>{a}};
+    if (!history)
+    {
+        return false;
+    }
+
+    mHistories.push_back(std::move(history));
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Maximum number of saved ticks
+-------------------------------------*/
+inline std::size_t RollbackBuffer::max_ticks() const noexcept
+{
+    return mMaxTicks;
+}
+
+
+
+/*-------------------------------------
+ * Number of saved ticks
+-------------------------------------*/
+inline std::size_t RollbackBuffer::num_ticks() const noexcept
+{
+    return mTicks.size();
+}
+
+
+
+/*-------------------------------------
+ * Oldest restorable tick
+-------------------------------------*/
+inline uint64_t RollbackBuffer::oldest_tick() const noexcept
+{
+    return mTicks.empty() ? 0 : mTicks.front().tick;
+}
+
+
+
+/*-------------------------------------
+ * Most recently saved tick
+-------------------------------------*/
+inline uint64_t RollbackBuffer::newest_tick() const noexcept
+{
+    return mTicks.empty() ? 0 : mTicks.back().tick;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_ROLLBACK_BUFFER_HPP */
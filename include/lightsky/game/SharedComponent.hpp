@@ -0,0 +1,512 @@
+
+#ifndef LS_GAME_SHARED_COMPONENT_HPP
+#define LS_GAME_SHARED_COMPONENT_HPP
+
+#include <cstdint> // uint32_t
+#include <cstdlib> // size_t
+#include <cstring> // std::memcpy
+#include <functional> // std::hash, std::equal_to
+#include <type_traits> // std::integral_constant, std::is_trivially_copyable
+#include <unordered_map>
+#include <vector>
+
+#include "lightsky/utils/Assertions.h"
+
+#include "lightsky/game/ColumnComponent.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Shared Component
+ *
+ * A component whose entities reference interned values rather than holding
+ * their own copies. Each distinct value is stored once while every entity
+ * keeps a 32-bit value ID within a single column, so entities can still be
+ * processed chunk by chunk.
+ *
+ * Values which are no longer referenced stay interned, keeping their IDs,
+ * until "shrink_to_fit()" releases them. Releasing values renumbers the
+ * remaining IDs, so rollback history saved beforehand must not be restored.
+-----------------------------------------------------------------------------*/
+template <typename T, typename Hash = std::hash<T>, typename KeyEqual = std::equal_to<T>>
+class SharedComponent : public ColumnComponent<uint32_t>
+{
+  public:
+    typedef uint32_t ValueId;
+
+    enum : ValueId
+    {
+        INVALID_VALUE = ~(ValueId)0
+    };
+
+  private:
+    typedef ColumnComponent<uint32_t> BaseType;
+
+    // Interned values, indexed by ID.
+    std::vector<T> mValues;
+
+    std::unordered_map<T, ValueId, Hash, KeyEqual> mLookup;
+
+    // Scratch storage for "for_each_group()".
+    std::vector<std::size_t> mGroupOffsets;
+
+    std::vector<Entity> mGroupEntities;
+
+    ValueId _intern(const T& value) noexcept;
+
+    static bool _write_value(const T& value, std::vector<char>& outData, std::true_type) noexcept;
+
+    static bool _write_value(const T&, std::vector<char>&, std::false_type) noexcept;
+
+    static bool _read_value(T& outValue, const char* pData, std::size_t numBytes, std::true_type) noexcept;
+
+    static bool _read_value(T&, const char*, std::size_t, std::false_type) noexcept;
+
+  protected:
+    // New entities reference a default-constructed value.
+    virtual bool insert_data(std::size_t index) noexcept override;
+
+    virtual void clear_data() noexcept override;
+
+    // Releases values which are no longer referenced by any entity.
+    virtual void shrink_data() noexcept override;
+
+  public:
+    virtual ~SharedComponent() noexcept override = default;
+
+    SharedComponent() = default;
+
+    SharedComponent(const SharedComponent&) = default;
+
+    SharedComponent(SharedComponent&&) = default;
+
+    SharedComponent& operator=(const SharedComponent&) = default;
+
+    SharedComponent& operator=(SharedComponent&&) = default;
+
+    // Retrieve the value of an entity. The entity must belong to *this.
+    const T& value(const Entity& e) const noexcept;
+
+    // Reference an interned copy of "value" from an entity. Returns false if
+    // the entity does not belong to *this or memory ran out.
+    bool value(const Entity& e, const T& value) noexcept;
+
+    // Retrieve the ID of an entity's value. The entity must belong to *this.
+    ValueId value_id(const Entity& e) const noexcept;
+
+    // Retrieve an interned value by ID.
+    const T& value_at(ValueId valueId) const noexcept;
+
+    // Returns INVALID_VALUE if a value has not been interned.
+    ValueId find_value(const T& value) const noexcept;
+
+    // Number of interned values, including those which are no longer
+    // referenced.
+    std::size_t num_values() const noexcept;
+
+    // Call "func(value, pEntities, numEntities)" once for each value which is
+    // referenced by an awake entity, passing all awake entities which
+    // reference it. Entities are bucketed with a counting sort, leaving
+    // component storage untouched.
+    template <typename Func>
+    void for_each_group(Func&& func) noexcept;
+
+    virtual MemoryStats memory_stats() const noexcept override;
+
+    // Values are serialized by copying their bytes, so deserialized entities
+    // reference an equal interned value. Fails if T is not trivially
+    // copyable.
+    virtual bool serialize_data(std::size_t index, std::vector<char>& outData) const noexcept override;
+
+    virtual bool deserialize_data(std::size_t index, const char* pData, std::size_t numBytes) noexcept override;
+};
+
+
+
+/*-------------------------------------
+ * Store a value once
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+typename SharedComponent<T, Hash, KeyEqual>::ValueId SharedComponent<T, Hash, KeyEqual>::_intern(const T& value) noexcept
+{
+    const typename std::unordered_map<T, ValueId, Hash, KeyEqual>::const_iterator iter = mLookup.find(value);
+    if (iter != mLookup.end())
+    {
+        return iter->second;
+    }
+
+    if (mValues.size() >= (std::size_t)INVALID_VALUE)
+    {
+        return INVALID_VALUE;
+    }
+
+    const ValueId valueId = (ValueId)mValues.size();
+    mValues.push_back(value);
+    mLookup.emplace(value, valueId);
+
+    return valueId;
+}
+
+
+
+/*-------------------------------------
+ * Serialize a trivially copyable value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline bool SharedComponent<T, Hash, KeyEqual>::_write_value(const T& value, std::vector<char>& outData, std::true_type) noexcept
+{
+    const char* pValue = reinterpret_cast<const char*>(&value);
+    outData.insert(outData.end(), pValue, pValue + sizeof(T));
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Values which can't be serialized
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline bool SharedComponent<T, Hash, KeyEqual>::_write_value(const T&, std::vector<char>&, std::false_type) noexcept
+{
+    return false;
+}
+
+
+
+/*-------------------------------------
+ * Deserialize a trivially copyable value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline bool SharedComponent<T, Hash, KeyEqual>::_read_value(T& outValue, const char* pData, std::size_t numBytes, std::true_type) noexcept
+{
+    if (numBytes != sizeof(T))
+    {
+        return false;
+    }
+
+    std::memcpy(&outValue, pData, sizeof(T));
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Values which can't be deserialized
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline bool SharedComponent<T, Hash, KeyEqual>::_read_value(T&, const char*, std::size_t, std::false_type) noexcept
+{
+    return false;
+}
+
+
+
+/*-------------------------------------
+ * Reference the default value from a new entity
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+bool SharedComponent<T, Hash, KeyEqual>::insert_data(std::size_t index) noexcept
+{
+    if (!BaseType::insert_data(index))
+    {
+        return false;
+    }
+
+    const ValueId valueId = _intern(T{});
+
+    if (valueId == INVALID_VALUE || !set<0>(mEntities[index], valueId))
+    {
+        // Removes the row which was just appended
+        BaseType::erase_data(index);
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove all values
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+void SharedComponent<T, Hash, KeyEqual>::clear_data() noexcept
+{
+    BaseType::clear_data();
+    mValues.clear();
+    mLookup.clear();
+}
+
+
+
+/*-------------------------------------
+ * Release unreferenced values
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+void SharedComponent<T, Hash, KeyEqual>::shrink_data() noexcept
+{
+    BaseType::shrink_data();
+
+    std::vector<ValueId> remap(mValues.size(), INVALID_VALUE);
+
+    for (std::size_t c = 0; c < num_chunks(); ++c)
+    {
+        const ValueId* pIds = column<0>(c);
+
+        for (std::size_t row = 0; row < chunk_size(c); ++row)
+        {
+            remap[pIds[row]] = 0;
+        }
+    }
+
+    ValueId numValues = 0;
+    for (ValueId& newId : remap)
+    {
+        if (newId != INVALID_VALUE)
+        {
+            newId = numValues++;
+        }
+    }
+
+    if (numValues == mValues.size())
+    {
+        mGroupOffsets.shrink_to_fit();
+        mGroupEntities.shrink_to_fit();
+        return;
+    }
+
+    // Duplicate any shared chunks before changing values so a failure
+    // leaves *this untouched
+    for (std::size_t c = 0; c < num_chunks(); ++c)
+    {
+        if (!writable_column<0>(c))
+        {
+            return;
+        }
+    }
+
+    for (std::size_t c = 0; c < num_chunks(); ++c)
+    {
+        ValueId* pIds = writable_column<0>(c);
+
+        for (std::size_t row = 0; row < chunk_size(c); ++row)
+        {
+            pIds[row] = remap[pIds[row]];
+        }
+    }
+
+    std::vector<T> values;
+    values.reserve(numValues);
+    mLookup.clear();
+
+    for (std::size_t i = 0; i < mValues.size(); ++i)
+    {
+        if (remap[i] != INVALID_VALUE)
+        {
+            mLookup.emplace(mValues[i], (ValueId)values.size());
+            values.push_back(std::move(mValues[i]));
+        }
+    }
+
+    mValues = std::move(values);
+    mGroupOffsets.clear();
+    mGroupOffsets.shrink_to_fit();
+    mGroupEntities.clear();
+    mGroupEntities.shrink_to_fit();
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an entity's value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline const T& SharedComponent<T, Hash, KeyEqual>::value(const Entity& e) const noexcept
+{
+    return mValues[get<0>(e)];
+}
+
+
+
+/*-------------------------------------
+ * Assign an entity's value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+bool SharedComponent<T, Hash, KeyEqual>::value(const Entity& e, const T& value) noexcept
+{
+    if (!contains(e))
+    {
+        return false;
+    }
+
+    const ValueId valueId = _intern(value);
+    return valueId != INVALID_VALUE && set<0>(e, valueId);
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an entity's value ID
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline typename SharedComponent<T, Hash, KeyEqual>::ValueId SharedComponent<T, Hash, KeyEqual>::value_id(const Entity& e) const noexcept
+{
+    return get<0>(e);
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an interned value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline const T& SharedComponent<T, Hash, KeyEqual>::value_at(ValueId valueId) const noexcept
+{
+    LS_DEBUG_ASSERT(valueId < mValues.size());
+    return mValues[valueId];
+}
+
+
+
+/*-------------------------------------
+ * Look up an interned value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline typename SharedComponent<T, Hash, KeyEqual>::ValueId SharedComponent<T, Hash, KeyEqual>::find_value(const T& value) const noexcept
+{
+    const typename std::unordered_map<T, ValueId, Hash, KeyEqual>::const_iterator iter = mLookup.find(value);
+    return (iter == mLookup.end()) ? (ValueId)INVALID_VALUE : iter->second;
+}
+
+
+
+/*-------------------------------------
+ * Number of interned values
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+inline std::size_t SharedComponent<T, Hash, KeyEqual>::num_values() const noexcept
+{
+    return mValues.size();
+}
+
+
+
+/*-------------------------------------
+ * Visit awake entities grouped by value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+template <typename Func>
+void SharedComponent<T, Hash, KeyEqual>::for_each_group(Func&& func) noexcept
+{
+    mGroupOffsets.assign(mValues.size(), 0);
+    mGroupEntities.resize(num_active());
+
+    for (std::size_t c = 0; c < num_active_chunks(); ++c)
+    {
+        const ValueId* pIds = column<0>(c);
+
+        for (std::size_t row = 0; row < active_chunk_size(c); ++row)
+        {
+            ++mGroupOffsets[pIds[row]];
+        }
+    }
+
+    // Convert counts into the first slot of each group
+    std::size_t numEntities = 0;
+    for (std::size_t& offset : mGroupOffsets)
+    {
+        const std::size_t count = offset;
+        offset = numEntities;
+        numEntities += count;
+    }
+
+    // Placing entities advances each offset to the end of its group
+    for (std::size_t c = 0; c < num_active_chunks(); ++c)
+    {
+        const ValueId* pIds = column<0>(c);
+        const Entity* pEntities = chunk_entities(c);
+
+        for (std::size_t row = 0; row < active_chunk_size(c); ++row)
+        {
+            mGroupEntities[mGroupOffsets[pIds[row]]++] = pEntities[row];
+        }
+    }
+
+    std::size_t groupBegin = 0;
+    for (std::size_t i = 0; i < mValues.size(); ++i)
+    {
+        const std::size_t groupEnd = mGroupOffsets[i];
+
+        if (groupEnd > groupBegin)
+        {
+            func(mValues[i], mGroupEntities.data() + groupBegin, groupEnd - groupBegin);
+        }
+
+        groupBegin = groupEnd;
+    }
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+MemoryStats SharedComponent<T, Hash, KeyEqual>::memory_stats() const noexcept
+{
+    MemoryStats stats = BaseType::memory_stats();
+
+    stats.usedBytes += mValues.size() * sizeof(T);
+    stats.reservedBytes += mValues.capacity() * sizeof(T);
+
+    // Approximates one heap node per lookup entry
+    stats.usedBytes += mLookup.size() * (sizeof(T) + sizeof(ValueId));
+    stats.reservedBytes += mLookup.size() * (sizeof(T) + sizeof(ValueId) + sizeof(void*));
+    stats.reservedBytes += mLookup.bucket_count() * sizeof(void*);
+
+    stats.reservedBytes += mGroupOffsets.capacity() * sizeof(std::size_t);
+    stats.reservedBytes += mGroupEntities.capacity() * sizeof(Entity);
+
+    return stats;
+}
+
+
+
+/*-------------------------------------
+ * Serialize an entity's value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+bool SharedComponent<T, Hash, KeyEqual>::serialize_data(std::size_t index, std::vector<char>& outData) const noexcept
+{
+    return _write_value(mValues[get<0>(mEntities[index])], outData, std::integral_constant<bool, std::is_trivially_copyable<T>::value>{});
+}
+
+
+
+/*-------------------------------------
+ * Deserialize an entity's value
+-------------------------------------*/
+template <typename T, typename Hash, typename KeyEqual>
+bool SharedComponent<T, Hash, KeyEqual>::deserialize_data(std::size_t index, const char* pData, std::size_t numBytes) noexcept
+{
+    T v{};
+
+    if (!_read_value(v, pData, numBytes, std::integral_constant<bool, std::is_trivially_copyable<T>::value>{}))
+    {
+        return false;
+    }
+
+    return value(mEntities[index], v);
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_SHARED_COMPONENT_HPP */
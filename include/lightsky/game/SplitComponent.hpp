@@ -0,0 +1,208 @@
+
+#ifndef LS_GAME_SPLIT_COMPONENT_HPP
+#define LS_GAME_SPLIT_COMPONENT_HPP
+
+#include <cstdlib> // size_t
+#include <limits> // std::numeric_limits
+#include <type_traits> // std::is_integral, std::is_unsigned, std::is_floating_point
+
+#include "lightsky/utils/Assertions.h"
+
+#include "lightsky/game/ColumnComponent.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Cold Data Codecs
+ *
+ * A codec converts between a cold value and the type which is stored for it.
+ * Codecs provide "value_type", "encoded_type", and static "encode()" and
+ * "decode()" functions.
+-----------------------------------------------------------------------------*/
+// Stores values unchanged.
+template <typename T>
+struct RawCodec
+{
+    typedef T value_type;
+    typedef T encoded_type;
+
+    static encoded_type encode(const value_type& value) noexcept
+    {
+        return value;
+    }
+
+    static value_type decode(const encoded_type& value) noexcept
+    {
+        return value;
+    }
+};
+
+
+
+// Stores floating-point values within [MinValue, MaxValue] as unsigned
+// integers spanning the full range of "Encoded". Values outside the range are
+// clamped, and decoded values are accurate to within half of one step,
+// "(MaxValue - MinValue) / std::numeric_limits<Encoded>::max() / 2".
+template <typename Encoded, int MinValue, int MaxValue, typename T = float>
+struct QuantizedCodec
+{
+    static_assert(std::is_unsigned<Encoded>::value, "Quantized values must be stored as unsigned integers.");
+    static_assert(std::is_floating_point<T>::value, "Only floating-point values can be quantized.");
+    static_assert(MinValue < MaxValue, "Quantization requires a non-empty range.");
+
+    typedef T value_type;
+    typedef Encoded encoded_type;
+
+    static encoded_type encode(const value_type& value) noexcept
+    {
+        const T range = (T)MaxValue - (T)MinValue;
+        const T steps = (T)std::numeric_limits<Encoded>::max();
+        const T t = (value - (T)MinValue) / range;
+
+        if (!(t > T{0}))
+        {
+            return 0;
+        }
+
+        return (t < T{1}) ? (Encoded)(t * steps + T{0.5}) : std::numeric_limits<Encoded>::max();
+    }
+
+    static value_type decode(const encoded_type& value) noexcept
+    {
+        const T range = (T)MaxValue - (T)MinValue;
+        const T steps = (T)std::numeric_limits<Encoded>::max();
+
+        return (T)MinValue + ((T)value / steps) * range;
+    }
+};
+
+
+
+// Stores integers as their difference from "Base" within a narrower type.
+// Values must lie within [Base + min(Encoded), Base + max(Encoded)].
+template <typename T, typename Encoded, T Base>
+struct OffsetCodec
+{
+    static_assert(std::is_integral<T>::value && std::is_integral<Encoded>::value, "Offsets are only supported between integer types.");
+
+    typedef T value_type;
+    typedef Encoded encoded_type;
+
+    static encoded_type encode(const value_type& value) noexcept
+    {
+        LS_DEBUG_ASSERT((T)((T)(Encoded)(value - Base) + Base) == value);
+        return (Encoded)(value - Base);
+    }
+
+    static value_type decode(const encoded_type& value) noexcept
+    {
+        return (T)((T)value + Base);
+    }
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Split Component
+ *
+ * A column component whose data is split into frequently-accessed hot
+ * columns and a single cold value per entity. Hot columns keep their
+ * indices within "column()" and "get()", so update loops touch only the hot
+ * chunks. Cold values are encoded by "ColdCodec" into a final column of
+ * their own, which is never read unless cold values are requested.
+ *
+ * Cold values with several fields can use a structure along with a codec
+ * which encodes each field.
+-----------------------------------------------------------------------------*/
+template <typename ColdCodec, typename... HotTypes>
+class SplitComponent : public ColumnComponent<HotTypes..., typename ColdCodec::encoded_type>
+{
+  public:
+    typedef ColumnComponent<HotTypes..., typename ColdCodec::encoded_type> BaseType;
+
+    typedef typename ColdCodec::value_type cold_type;
+
+    typedef typename ColdCodec::encoded_type encoded_type;
+
+    enum : std::size_t
+    {
+        COLD_COLUMN = sizeof...(HotTypes)
+    };
+
+    virtual ~SplitComponent() noexcept override = default;
+
+    SplitComponent() noexcept = default;
+
+    SplitComponent(const SplitComponent&) = default;
+
+    SplitComponent(SplitComponent&&) noexcept = default;
+
+    SplitComponent& operator=(const SplitComponent&) = default;
+
+    SplitComponent& operator=(SplitComponent&&) noexcept = default;
+
+    // Decode the cold value of an entity. The entity must belong to *this.
+    cold_type cold(const Entity& e) const noexcept;
+
+    // Encode the cold value of an entity. Returns false if the entity does
+    // not belong to *this or a shared chunk could not be duplicated.
+    bool cold(const Entity& e, const cold_type& value) noexcept;
+
+    // Decode the cold values of every row within a chunk into "pOut", which
+    // must hold at least "chunk_size(chunkId)" values. Returns the number of
+    // values decoded.
+    std::size_t decode_chunk(std::size_t chunkId, cold_type* pOut) const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Decode a cold value
+-------------------------------------*/
+template <typename ColdCodec, typename... HotTypes>
+inline typename SplitComponent<ColdCodec, HotTypes...>::cold_type SplitComponent<ColdCodec, HotTypes...>::cold(const Entity& e) const noexcept
+{
+    return ColdCodec::decode(this->template get<COLD_COLUMN>(e));
+}
+
+
+
+/*-------------------------------------
+ * Encode a cold value
+-------------------------------------*/
+template <typename ColdCodec, typename... HotTypes>
+inline bool SplitComponent<ColdCodec, HotTypes...>::cold(const Entity& e, const cold_type& value) noexcept
+{
+    return this->template set<COLD_COLUMN>(e, ColdCodec::encode(value));
+}
+
+
+
+/*-------------------------------------
+ * Decode a chunk of cold values
+-------------------------------------*/
+template <typename ColdCodec, typename... HotTypes>
+std::size_t SplitComponent<ColdCodec, HotTypes...>::decode_chunk(std::size_t chunkId, cold_type* pOut) const noexcept
+{
+    const std::size_t numRows = this->chunk_size(chunkId);
+    const encoded_type* pEncoded = this->template column<COLD_COLUMN>(chunkId);
+
+    for (std::size_t i = 0; i < numRows; ++i)
+    {
+        pOut[i] = ColdCodec::decode(pEncoded ? pEncoded[i] : encoded_type{});
+    }
+
+    return numRows;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_SPLIT_COMPONENT_HPP */
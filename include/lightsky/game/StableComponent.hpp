@@ -0,0 +1,685 @@
+
+#ifndef LS_GAME_STABLE_COMPONENT_HPP
+#define LS_GAME_STABLE_COMPONENT_HPP
+
+#include <cstdint> // uint32_t
+#include <cstdlib> // size_t
+#include <cstring> // std::memcpy
+#include <type_traits> // std::integral_constant, std::is_trivially_copyable
+#include <vector>
+
+#include "lightsky/utils/Assertions.h"
+
+#include "lightsky/game/ColumnComponent.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Stable Component
+ *
+ * A component which keeps each entity's value at a fixed address. Values are
+ * placed into slots within fixed-size pages and never move while their
+ * entity belongs to *this, so other systems may cache pointers to them
+ * between structural changes. Entities keep a 32-bit slot ID within a single
+ * column, which is the only data moved when entities are removed or sorted.
+ *
+ * Removed slots are recycled before new slots are appended. A page whose
+ * slots are all unused is released immediately, and reads as NULL until
+ * one of its slots is reused.
+ *
+ * Stable addresses and copy-on-write sharing cannot be combined. Copies of
+ * *this, including those made by "RollbackBuffer::save_tick()", share pages
+ * until either side writes to them, and the writer then moves to a duplicate
+ * page. Pointers retrieved before a copy is made must be retrieved again
+ * afterward. Writing through an old pointer modifies the copy instead of
+ * *this. Debug builds assert when a page which was moved this way has been
+ * written to by the next call which writes values.
+-----------------------------------------------------------------------------*/
+template <typename T>
+class StableComponent : public ColumnComponent<uint32_t>
+{
+  public:
+    typedef uint32_t SlotId;
+
+    enum : std::size_t
+    {
+        PAGE_SIZE = CHUNK_SIZE
+    };
+
+    enum : SlotId
+    {
+        INVALID_SLOT = ~(SlotId)0
+    };
+
+  private:
+    typedef ColumnComponent<uint32_t> BaseType;
+
+    PagedArray<T, PAGE_SIZE> mSlots;
+
+    // Packed index of the entity within each slot, plus one. Unused slots
+    // hold zero, as do released pages.
+    PagedArray<SlotId, PAGE_SIZE> mSlotRows;
+
+    // Stack of unused slots within the range of "mSlots".
+    PagedArray<SlotId> mFreeSlots;
+
+    // Number of used slots within each page.
+    PagedArray<SlotId> mPageCounts;
+
+  #ifndef NDEBUG
+    // The page which was last moved to a duplicate, kept alive along with a
+    // hash of its contents to catch writes through stale pointers.
+    PagedArray<T, PAGE_SIZE> mMovedPage;
+    std::size_t mMovedPageId = 0;
+    uint64_t mMovedPageHash = 0;
+
+    static uint64_t _hash_page(const T* pValues) noexcept;
+  #endif
+
+    // All writes to "mSlots" pass through here.
+    T* _writable_slots(std::size_t pageId) noexcept;
+
+    // Returns INVALID_SLOT if memory ran out.
+    SlotId _alloc_slot(std::size_t index) noexcept;
+
+    static bool _write_value(const T& value, std::vector<char>& outData, std::true_type) noexcept;
+
+    static bool _write_value(const T&, std::vector<char>&, std::false_type) noexcept;
+
+    static bool _read_value(T& outValue, const char* pData, std::size_t numBytes, std::true_type) noexcept;
+
+    static bool _read_value(T&, const char*, std::size_t, std::false_type) noexcept;
+
+  protected:
+    // New entities hold a value-initialized T.
+    virtual bool insert_data(std::size_t index) noexcept override;
+
+    virtual bool erase_data(std::size_t index) noexcept override;
+
+    virtual void clear_data() noexcept override;
+
+    virtual bool swap_data(std::size_t indexA, std::size_t indexB) noexcept override;
+
+    virtual void shrink_data() noexcept override;
+
+    virtual void restore_data() noexcept override;
+
+  public:
+    virtual ~StableComponent() noexcept override = default;
+
+    StableComponent() = default;
+
+    StableComponent(const StableComponent&) = default;
+
+    StableComponent(StableComponent&&) = default;
+
+    StableComponent& operator=(const StableComponent&) = default;
+
+    StableComponent& operator=(StableComponent&&) = default;
+
+    // Retrieve the value of an entity. The entity must belong to *this.
+    const T& value(const Entity& e) const noexcept;
+
+    // Returns false if the entity does not belong to *this or a shared page
+    // could not be duplicated.
+    bool value(const Entity& e, const T& value) noexcept;
+
+    // Retrieve a writable pointer to an entity's value, which stays valid
+    // until the entity is removed, *this is cleared or copied, or a rollback
+    // is performed. Returns
+    // NULL if the entity does not belong to *this or a shared page could not
+    // be duplicated.
+    T* writable(const Entity& e) noexcept;
+
+    // Slot holding an entity's value. The entity must belong to *this.
+    SlotId slot(const Entity& e) const noexcept;
+
+    std::size_t num_pages() const noexcept;
+
+    // Number of used slots within a page.
+    std::size_t page_count(std::size_t pageId) const noexcept;
+
+    // Values of a page, holding PAGE_SIZE elements. Returns NULL if the page
+    // was released.
+    const T* page(std::size_t pageId) const noexcept;
+
+    // Returns NULL if the page was released or could not be duplicated.
+    T* writable_page(std::size_t pageId) noexcept;
+
+    // Call "func(entity, value)" for every entity within *this, walking
+    // pages in address order.
+    template <typename Func>
+    void for_each(Func&& func) noexcept;
+
+    virtual void track_history(RollbackBuffer& rb) noexcept override;
+
+    virtual MemoryStats memory_stats() const noexcept override;
+
+    // Values are serialized by copying their bytes. Fails if T is not
+    // trivially copyable.
+    virtual bool serialize_data(std::size_t index, std::vector<char>& outData) const noexcept override;
+
+    virtual bool deserialize_data(std::size_t index, const char* pData, std::size_t numBytes) noexcept override;
+};
+
+
+
+/*-------------------------------------
+ * Place an entity into a slot
+-------------------------------------*/
+template <typename T>
+typename StableComponent<T>::SlotId StableComponent<T>::_alloc_slot(std::size_t index) noexcept
+{
+    const bool isNewSlot = mFreeSlots.empty();
+    SlotId slot;
+
+    if (isNewSlot)
+    {
+        if (mSlots.size() >= (std::size_t)INVALID_SLOT)
+        {
+            return INVALID_SLOT;
+        }
+
+        if (mPageCounts.size() <= mSlots.size() / PAGE_SIZE && !mPageCounts.push_back(0))
+        {
+            return INVALID_SLOT;
+        }
+
+        if (!mSlots.push_back(T{}))
+        {
+            return INVALID_SLOT;
+        }
+
+        if (!mSlotRows.push_back(0))
+        {
+            mSlots.pop_back();
+            return INVALID_SLOT;
+        }
+
+        slot = (SlotId)(mSlots.size() - 1);
+    }
+    else
+    {
+        slot = mFreeSlots[mFreeSlots.size() - 1];
+    }
+
+    const std::size_t pageId = slot / PAGE_SIZE;
+    SlotId* pCount = mPageCounts.writable(pageId);
+    SlotId* pRow = mSlotRows.writable(slot);
+
+    // Released pages are re-allocated here so later writes can't fail
+    if (!pCount || !pRow || !_writable_slots(slot / PAGE_SIZE))
+    {
+        if (isNewSlot)
+        {
+            mSlots.pop_back();
+            mSlotRows.pop_back();
+        }
+
+        return INVALID_SLOT;
+    }
+
+    *pRow = (SlotId)(index + 1);
+    ++(*pCount);
+
+    if (!isNewSlot)
+    {
+        mFreeSlots.pop_back();
+    }
+
+    return slot;
+}
+
+
+
+#ifndef NDEBUG
+/*-------------------------------------
+ * Hash the bytes of a page (FNV-1a)
+-------------------------------------*/
+template <typename T>
+uint64_t StableComponent<T>::_hash_page(const T* pValues) noexcept
+{
+    const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(pValues);
+    uint64_t hash = 14695981039346656037ull;
+
+    for (std::size_t i = 0; i < sizeof(T) * PAGE_SIZE; ++i)
+    {
+        hash = (hash ^ pBytes[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+#endif
+
+
+
+/*-------------------------------------
+ * Un-share a page of values
+-------------------------------------*/
+template <typename T>
+T* StableComponent<T>::_writable_slots(std::size_t pageId) noexcept
+{
+    #ifndef NDEBUG
+        // Writes through a pointer retrieved before the page moved
+        LS_DEBUG_ASSERT(mMovedPage.empty() || _hash_page(mMovedPage.page(mMovedPageId)) == mMovedPageHash);
+        mMovedPage.clear();
+
+        if (pageId < mSlots.num_pages() && mSlots.is_page_shared(pageId))
+        {
+            mMovedPage = mSlots;
+            mMovedPageId = pageId;
+            mMovedPageHash = _hash_page(mSlots.page(pageId));
+
+            for (std::size_t p = 0; p < mMovedPage.num_pages(); ++p)
+            {
+                if (p != pageId)
+                {
+                    mMovedPage.release_page(p);
+                }
+            }
+        }
+    #endif
+
+    return mSlots.writable_page(pageId);
+}
+
+
+
+/*-------------------------------------
+ * Serialize a trivially copyable value
+-------------------------------------*/
+template <typename T>
+inline bool StableComponent<T>::_write_value(const T& value, std::vector<char>& outData, std::true_type) noexcept
+{
+    const char* pValue = reinterpret_cast<const char*>(&value);
+    outData.insert(outData.end(), pValue, pValue + sizeof(T));
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Values which can't be serialized
+-------------------------------------*/
+template <typename T>
+inline bool StableComponent<T>::_write_value(const T&, std::vector<char>&, std::false_type) noexcept
+{
+    return false;
+}
+
+
+
+/*-------------------------------------
+ * Deserialize a trivially copyable value
+-------------------------------------*/
+template <typename T>
+inline bool StableComponent<T>::_read_value(T& outValue, const char* pData, std::size_t numBytes, std::true_type) noexcept
+{
+    if (numBytes != sizeof(T))
+    {
+        return false;
+    }
+
+    std::memcpy(&outValue, pData, sizeof(T));
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Values which can't be deserialized
+-------------------------------------*/
+template <typename T>
+inline bool StableComponent<T>::_read_value(T&, const char*, std::size_t, std::false_type) noexcept
+{
+    return false;
+}
+
+
+
+/*-------------------------------------
+ * Assign a slot to a new entity
+-------------------------------------*/
+template <typename T>
+bool StableComponent<T>::insert_data(std::size_t index) noexcept
+{
+    if (!BaseType::insert_data(index))
+    {
+        return false;
+    }
+
+    const SlotId slot = _alloc_slot(index);
+
+    if (slot == INVALID_SLOT)
+    {
+        // Removes the row which was just appended
+        BaseType::erase_data(index);
+        return false;
+    }
+
+    // The appended row was just written, so its chunk is never shared
+    set<0>(mEntities[index], slot);
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Release an entity's slot
+-------------------------------------*/
+template <typename T>
+bool StableComponent<T>::erase_data(std::size_t index) noexcept
+{
+    const std::size_t last = mEntities.size() - 1;
+    const SlotId slot = get<0>(mEntities[index]);
+    const SlotId lastSlot = get<0>(mEntities[last]);
+    const std::size_t pageId = slot / PAGE_SIZE;
+
+    // Duplicate all shared pages up-front so a failure leaves *this
+    // untouched
+    T* const pPage = _writable_slots(pageId);
+    T* pValue = pPage ? (pPage + slot % PAGE_SIZE) : nullptr;
+    SlotId* pRow = mSlotRows.writable(slot);
+    SlotId* pLastRow = mSlotRows.writable(lastSlot);
+    SlotId* pCount = mPageCounts.writable(pageId);
+
+    if (!pValue || !pRow || !pLastRow || !pCount || !mFreeSlots.push_back(slot))
+    {
+        return false;
+    }
+
+    if (!BaseType::erase_data(index))
+    {
+        mFreeSlots.pop_back();
+        return false;
+    }
+
+    // The last entity's slot ID was moved into "index"
+    *pLastRow = (SlotId)(index + 1);
+    *pRow = 0;
+
+    if (--(*pCount))
+    {
+        *pValue = T{};
+    }
+    else
+    {
+        mSlots.release_page(pageId);
+        mSlotRows.release_page(pageId);
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove all values
+-------------------------------------*/
+template <typename T>
+void StableComponent<T>::clear_data() noexcept
+{
+    BaseType::clear_data();
+    mSlots.clear();
+    mSlotRows.clear();
+    mFreeSlots.clear();
+    mPageCounts.clear();
+}
+
+
+
+/*-------------------------------------
+ * Exchange the slot IDs of two rows
+-------------------------------------*/
+template <typename T>
+bool StableComponent<T>::swap_data(std::size_t indexA, std::size_t indexB) noexcept
+{
+    SlotId* pRowA = mSlotRows.writable(get<0>(mEntities[indexA]));
+    SlotId* pRowB = mSlotRows.writable(get<0>(mEntities[indexB]));
+
+    if (!pRowA || !pRowB || !BaseType::swap_data(indexA, indexB))
+    {
+        return false;
+    }
+
+    *pRowA = (SlotId)(indexB + 1);
+    *pRowB = (SlotId)(indexA + 1);
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Release unused slot storage
+-------------------------------------*/
+template <typename T>
+void StableComponent<T>::shrink_data() noexcept
+{
+    BaseType::shrink_data();
+    mSlots.shrink_to_fit();
+    mSlotRows.shrink_to_fit();
+    mFreeSlots.shrink_to_fit();
+    mPageCounts.shrink_to_fit();
+}
+
+
+
+/*-------------------------------------
+ * Forget moved pages after a rollback
+-------------------------------------*/
+template <typename T>
+void StableComponent<T>::restore_data() noexcept
+{
+    BaseType::restore_data();
+
+    // Every page may have been replaced, which is checked no further
+    #ifndef NDEBUG
+        mMovedPage.clear();
+    #endif
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an entity's value
+-------------------------------------*/
+template <typename T>
+inline const T& StableComponent<T>::value(const Entity& e) const noexcept
+{
+    return mSlots[get<0>(e)];
+}
+
+
+
+/*-------------------------------------
+ * Assign an entity's value
+-------------------------------------*/
+template <typename T>
+bool StableComponent<T>::value(const Entity& e, const T& value) noexcept
+{
+    T* pValue = writable(e);
+    if (pValue)
+    {
+        *pValue = value;
+    }
+
+    return pValue != nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an entity's writable value
+-------------------------------------*/
+template <typename T>
+inline T* StableComponent<T>::writable(const Entity& e) noexcept
+{
+    if (!contains(e))
+    {
+        return nullptr;
+    }
+
+    const SlotId slot = get<0>(e);
+    T* const pPage = _writable_slots(slot / PAGE_SIZE);
+
+    return pPage ? (pPage + slot % PAGE_SIZE) : nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an entity's slot
+-------------------------------------*/
+template <typename T>
+inline typename StableComponent<T>::SlotId StableComponent<T>::slot(const Entity& e) const noexcept
+{
+    return get<0>(e);
+}
+
+
+
+/*-------------------------------------
+ * Number of slot pages
+-------------------------------------*/
+template <typename T>
+inline std::size_t StableComponent<T>::num_pages() const noexcept
+{
+    return mSlots.num_pages();
+}
+
+
+
+/*-------------------------------------
+ * Number of used slots in a page
+-------------------------------------*/
+template <typename T>
+inline std::size_t StableComponent<T>::page_count(std::size_t pageId) const noexcept
+{
+    return (pageId < mPageCounts.size()) ? mPageCounts[pageId] : 0;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve a page of values (const)
+-------------------------------------*/
+template <typename T>
+inline const T* StableComponent<T>::page(std::size_t pageId) const noexcept
+{
+    return mSlots.page(pageId);
+}
+
+
+
+/*-------------------------------------
+ * Retrieve a page of values
+-------------------------------------*/
+template <typename T>
+inline T* StableComponent<T>::writable_page(std::size_t pageId) noexcept
+{
+    return mSlots.page(pageId) ? _writable_slots(pageId) : nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Visit all values in address order
+-------------------------------------*/
+template <typename T>
+template <typename Func>
+void StableComponent<T>::for_each(Func&& func) noexcept
+{
+    for (std::size_t p = 0; p < num_pages(); ++p)
+    {
+        const SlotId* pRows = mSlotRows.page(p);
+        T* pValues = writable_page(p);
+
+        if (!pRows || !pValues)
+        {
+            continue;
+        }
+
+        const std::size_t numSlots = mSlots.page_count(p);
+
+        for (std::size_t i = 0; i < numSlots; ++i)
+        {
+            if (pRows[i])
+            {
+                func(mEntities[pRows[i] - 1], pValues[i]);
+            }
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Track all slot storage for rollback
+-------------------------------------*/
+template <typename T>
+void StableComponent<T>::track_history(RollbackBuffer& rb) noexcept
+{
+    BaseType::track_history(rb);
+    rb.track(mSlots);
+    rb.track(mSlotRows);
+    rb.track(mFreeSlots);
+    rb.track(mPageCounts);
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+template <typename T>
+MemoryStats StableComponent<T>::memory_stats() const noexcept
+{
+    MemoryStats stats = BaseType::memory_stats();
+    stats += mSlots.memory_stats();
+    stats += mSlotRows.memory_stats();
+    stats += mFreeSlots.memory_stats();
+    stats += mPageCounts.memory_stats();
+
+    return stats;
+}
+
+
+
+/*-------------------------------------
+ * Serialize an entity's value
+-------------------------------------*/
+template <typename T>
+bool StableComponent<T>::serialize_data(std::size_t index, std::vector<char>& outData) const noexcept
+{
+    return _write_value(value(mEntities[index]), outData, std::integral_constant<bool, std::is_trivially_copyable<T>::value>{});
+}
+
+
+
+/*-------------------------------------
+ * Deserialize an entity's value
+-------------------------------------*/
+template <typename T>
+bool StableComponent<T>::deserialize_data(std::size_t index, const char* pData, std::size_t numBytes) noexcept
+{
+    T v{};
+
+    if (!_read_value(v, pData, numBytes, std::integral_constant<bool, std::is_trivially_copyable<T>::value>{}))
+    {
+        return false;
+    }
+
+    return value(mEntities[index], v);
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_STABLE_COMPONENT_HPP */
@@ -0,0 +1,147 @@
+
+#ifndef LS_GAME_SWEEP_AND_PRUNE_HPP
+#define LS_GAME_SWEEP_AND_PRUNE_HPP
+
+#include <cstdint> // int64_t
+#include <cstdlib> // size_t
+#include <vector>
+
+#include "lightsky/game/Entity.hpp"
+#include "lightsky/game/EntitySet.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+class BoundsComponent;
+class Dispatcher;
+
+
+
+/*-----------------------------------------------------------------------------
+ * Overlapping entity pair. The ID of "a" is always less than the ID of "b".
+-----------------------------------------------------------------------------*/
+struct EntityPair
+{
+    Entity a;
+    Entity b;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Sweep and Prune
+ *
+ * Broadphase pair generation over a BoundsComponent. Bounds are kept in a
+ * persistent array sorted along the X axis. Each update re-sorts the array
+ * from the previous frame's order, which costs roughly one pass when
+ * entities move coherently. Updates which would need more than
+ * MAX_SORT_SWAPS_PER_PROXY swaps per proxy, such as after teleports, fall
+ * back to a full sort with the same result.
+ *
+ * Pairs are found by sweeping the sorted array. The sweep can be split into
+ * independent jobs which callers run on their own worker threads. Merging
+ * the jobs' output produces the same pairs in the same order as a
+ * single-threaded sweep.
+-----------------------------------------------------------------------------*/
+class SweepAndPrune
+{
+  public:
+    enum : std::size_t
+    {
+        MAX_SORT_SWAPS_PER_PROXY = 4
+    };
+
+  private:
+    struct Proxy
+    {
+        float minBounds[3];
+        float maxBounds[3];
+        Entity entity;
+    };
+
+    // Sorted by "minBounds[0]".
+    std::vector<Proxy> mProxies;
+
+    // Entities which currently own a proxy.
+    EntitySet mTracked;
+
+    // Set if an entity could not be removed from "mTracked", which must then
+    // be rebuilt from the proxies.
+    bool mTrackedStale = false;
+
+    std::vector<EntityPair> mPairs;
+
+    static bool _overlaps(const Proxy& p, const Proxy& q) noexcept;
+
+  public:
+    ~SweepAndPrune() noexcept = default;
+
+    SweepAndPrune() noexcept = default;
+
+    SweepAndPrune(const SweepAndPrune&) = default;
+
+    SweepAndPrune(SweepAndPrune&&) noexcept = default;
+
+    SweepAndPrune& operator=(const SweepAndPrune&) = default;
+
+    SweepAndPrune& operator=(SweepAndPrune&&) noexcept = default;
+
+    // Synchronize with the current contents of a bounds component. Returns
+    // false if memory for new entities could not be allocated, in which case
+    // they're added by the next update.
+    bool update(const BoundsComponent& bounds) noexcept;
+
+    // Find all overlapping pairs on the calling thread.
+    const std::vector<EntityPair>& sweep() noexcept;
+
+    // Run a single job of a sweep split into "numJobs" parts. Safe to call
+    // concurrently for different jobs once "update()" has returned.
+    void sweep_job(std::size_t jobId, std::size_t numJobs, std::vector<EntityPair>& outPairs) const noexcept;
+
+    // Replace the current pairs with the output of jobs [0, numJobs) of a
+    // split sweep, concatenated in job order.
+    const std::vector<EntityPair>& merge_jobs(const std::vector<EntityPair>* pJobPairs, std::size_t numJobs) noexcept;
+
+    // Pairs found by the most recent call to "sweep()" or "merge_jobs()".
+    const std::vector<EntityPair>& pairs() const noexcept;
+
+    // Queue each pair from the most recent sweep as an event. "type" is
+    // assigned to each event, "info" holds the pair's index within the
+    // batch, and "extra1" and "extra2" hold the entity IDs.
+    void dispatch_pairs(Dispatcher& dispatcher, int64_t type) const noexcept;
+
+    std::size_t num_proxies() const noexcept;
+
+    void clear() noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Retrieve the current pairs
+-------------------------------------*/
+inline const std::vector<EntityPair>& SweepAndPrune::pairs() const noexcept
+{
+    return mPairs;
+}
+
+
+
+/*-------------------------------------
+ * Number of tracked bounds
+-------------------------------------*/
+inline std::size_t SweepAndPrune::num_proxies() const noexcept
+{
+    return mProxies.size();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_SWEEP_AND_PRUNE_HPP */
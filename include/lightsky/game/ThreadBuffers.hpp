@@ -0,0 +1,323 @@
+
+#ifndef LS_GAME_THREAD_BUFFERS_HPP
+#define LS_GAME_THREAD_BUFFERS_HPP
+
+#include <atomic>
+#include <cstdint> // uint64_t
+#include <cstdlib> // size_t
+#include <new> // std::nothrow
+#include <thread> // std::thread::id
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Thread Buffers
+ *
+ * A set of single-producer/single-consumer rings, one per thread which pushes
+ * data into *this. Producers never contend with each other and only perform
+ * a relaxed load, an acquire load, and a release store per push. A single
+ * consumer thread drains all rings at once.
+ *
+ * Rings are allocated on a thread's first push and released when *this is
+ * destroyed. Values pushed while a ring is full are dropped.
+-----------------------------------------------------------------------------*/
+template <typename T, std::size_t Capacity>
+class ThreadBuffers
+{
+  private:
+    struct Ring
+    {
+        Ring* pNext;
+
+        // Written by the producing thread only.
+        std::atomic_size_t head;
+
+        // Written by the consuming thread only.
+        std::atomic_size_t tail;
+
+        std::thread::id threadId;
+
+        // Sequential index of the producing thread, starting at 0.
+        std::size_t threadIndex;
+
+        T data[Capacity];
+    };
+
+    // Uniquely identifies *this to the thread-local ring cache, even if
+    // another instance is later constructed at the same address.
+    uint64_t mInstanceId;
+
+    // Lock-free list of all rings.
+    std::atomic<Ring*> mRings;
+
+    std::atomic_size_t mNumRings;
+
+    std::atomic<uint64_t> mNumDropped;
+
+    static uint64_t _next_instance_id() noexcept;
+
+    Ring* _thread_ring() noexcept;
+
+    void _release_rings() noexcept;
+
+  public:
+    ~ThreadBuffers() noexcept;
+
+    ThreadBuffers() noexcept;
+
+    ThreadBuffers(const ThreadBuffers&) = delete;
+
+    // Must not be moved while any thread is pushing data.
+    ThreadBuffers(ThreadBuffers&& tb) noexcept;
+
+    ThreadBuffers& operator=(const ThreadBuffers&) = delete;
+
+    ThreadBuffers& operator=(ThreadBuffers&& tb) noexcept;
+
+    // Add a value to the calling thread's ring. Returns false if the value
+    // was dropped.
+    bool push(const T& value) noexcept;
+
+    // Pass every queued value to "func(const T&, std::size_t threadIndex)"
+    // in the order each thread pushed them. Must only be called from one
+    // thread at a time.
+    template <typename ConsumerFunc>
+    void consume(ConsumerFunc&& func) noexcept;
+
+    // Number of values dropped because a ring was full.
+    uint64_t num_dropped() const noexcept;
+
+    void reset_num_dropped() noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Generate a unique instance ID
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+uint64_t ThreadBuffers<T, Capacity>::_next_instance_id() noexcept
+{
+    static std::atomic<uint64_t> idCount{0};
+    return idCount.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve the calling thread's ring
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+typename ThreadBuffers<T, Capacity>::Ring* ThreadBuffers<T, Capacity>::_thread_ring() noexcept
+{
+    // Caches the ring of the most recently used instance on each thread
+    static thread_local uint64_t tlsInstanceId = 0;
+    static thread_local Ring* tlsRing = nullptr;
+
+    if (tlsInstanceId == mInstanceId)
+    {
+        return tlsRing;
+    }
+
+    const std::thread::id threadId = std::this_thread::get_id();
+    Ring* pRing = mRings.load(std::memory_order_acquire);
+
+    while (pRing && pRing->threadId != threadId)
+    {
+        pRing = pRing->pNext;
+    }
+
+    if (!pRing)
+    {
+        pRing = new(std::nothrow) Ring;
+        if (!pRing)
+        {
+            return nullptr;
+        }
+
+        pRing->head.store(0, std::memory_order_relaxed);
+        pRing->tail.store(0, std::memory_order_relaxed);
+        pRing->threadId = threadId;
+        pRing->threadIndex = mNumRings.fetch_add(1, std::memory_order_relaxed);
+        pRing->pNext = mRings.load(std::memory_order_relaxed);
+
+        while (!mRings.compare_exchange_weak(pRing->pNext, pRing, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    tlsInstanceId = mInstanceId;
+    tlsRing = pRing;
+
+    return pRing;
+}
+
+
+
+/*-------------------------------------
+ * Free all rings
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+void ThreadBuffers<T, Capacity>::_release_rings() noexcept
+{
+    Ring* pRing = mRings.exchange(nullptr, std::memory_order_acq_rel);
+
+    while (pRing)
+    {
+        Ring* pNext = pRing->pNext;
+        delete pRing;
+        pRing = pNext;
+    }
+
+    mNumRings.store(0, std::memory_order_relaxed);
+}
+
+
+
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+ThreadBuffers<T, Capacity>::~ThreadBuffers() noexcept
+{
+    _release_rings();
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+ThreadBuffers<T, Capacity>::ThreadBuffers() noexcept :
+    mInstanceId{_next_instance_id()},
+    mRings{nullptr},
+    mNumRings{0},
+    mNumDropped{0}
+{}
+
+
+
+/*-------------------------------------
+ * Move Constructor
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+ThreadBuffers<T, Capacity>::ThreadBuffers(ThreadBuffers&& tb) noexcept :
+    mInstanceId{tb.mInstanceId},
+    mRings{tb.mRings.exchange(nullptr, std::memory_order_acq_rel)},
+    mNumRings{tb.mNumRings.exchange(0, std::memory_order_relaxed)},
+    mNumDropped{tb.mNumDropped.exchange(0, std::memory_order_relaxed)}
+{
+    // Threads which cached a ring of "tb" now use the rings of *this
+    tb.mInstanceId = _next_instance_id();
+}
+
+
+
+/*-------------------------------------
+ * Move Operator
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+ThreadBuffers<T, Capacity>& ThreadBuffers<T, Capacity>::operator=(ThreadBuffers&& tb) noexcept
+{
+    if (this != &tb)
+    {
+        _release_rings();
+
+        mInstanceId = tb.mInstanceId;
+        mRings.store(tb.mRings.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_release);
+        mNumRings.store(tb.mNumRings.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        mNumDropped.store(tb.mNumDropped.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+
+        tb.mInstanceId = _next_instance_id();
+    }
+
+    return *this;
+}
+
+
+
+/*-------------------------------------
+ * Queue a value
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+bool ThreadBuffers<T, Capacity>::push(const T& value) noexcept
+{
+    Ring* pRing = _thread_ring();
+    if (!pRing)
+    {
+        mNumDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const std::size_t head = pRing->head.load(std::memory_order_relaxed);
+    const std::size_t tail = pRing->tail.load(std::memory_order_acquire);
+
+    if (head - tail >= Capacity)
+    {
+        mNumDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    pRing->data[head % Capacity] = value;
+    pRing->head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Drain all rings
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+template <typename ConsumerFunc>
+void ThreadBuffers<T, Capacity>::consume(ConsumerFunc&& func) noexcept
+{
+    for (Ring* pRing = mRings.load(std::memory_order_acquire); pRing; pRing = pRing->pNext)
+    {
+        const std::size_t head = pRing->head.load(std::memory_order_acquire);
+        std::size_t tail = pRing->tail.load(std::memory_order_relaxed);
+
+        for (; tail != head; ++tail)
+        {
+            func(static_cast<const T&>(pRing->data[tail % Capacity]), pRing->threadIndex);
+        }
+
+        pRing->tail.store(tail, std::memory_order_release);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Number of dropped values
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+inline uint64_t ThreadBuffers<T, Capacity>::num_dropped() const noexcept
+{
+    return mNumDropped.load(std::memory_order_relaxed);
+}
+
+
+
+/*-------------------------------------
+ * Reset the number of dropped values
+-------------------------------------*/
+template <typename T, std::size_t Capacity>
+inline void ThreadBuffers<T, Capacity>::reset_num_dropped() noexcept
+{
+    mNumDropped.store(0, std::memory_order_relaxed);
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_THREAD_BUFFERS_HPP */
@@ -0,0 +1,209 @@
+
+#ifndef LS_GAME_TRACER_HPP
+#define LS_GAME_TRACER_HPP
+
+#include <atomic>
+#include <cstdint> // uint64_t
+#include <cstdlib> // size_t
+#include <deque>
+#include <iosfwd> // std::ostream
+
+#include "lightsky/game/ThreadBuffers.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Trace Event
+-----------------------------------------------------------------------------*/
+struct TraceEvent
+{
+    // Must point to a string which outlives the tracer, such as a literal.
+    const char* name;
+
+    uint64_t startNanos;
+
+    uint64_t durationNanos;
+
+    // Optional numeric argument, such as a component ID. Set to
+    // Tracer::NO_ARG if unused.
+    std::size_t arg;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Tracer
+ *
+ * Records timed zones from any thread and exports them in the Chrome Trace
+ * Event format, readable by chrome://tracing and the Perfetto UI. Each
+ * thread records into its own ring (see ThreadBuffers). Events are gathered
+ * once per frame by GameSystem, keeping the most recent "max_events()".
+ *
+ * Zones are only recorded while the tracer is enabled and only from code
+ * built with LS_GAME_ENABLE_PROFILING.
+-----------------------------------------------------------------------------*/
+class Tracer
+{
+  public:
+    enum : std::size_t
+    {
+        THREAD_BUFFER_SIZE = 16384,
+        DEFAULT_MAX_EVENTS = 1024 * 1024,
+        NO_ARG = ~(std::size_t)0
+    };
+
+  private:
+    struct RecordedEvent
+    {
+        TraceEvent event;
+        std::size_t threadIndex;
+    };
+
+    std::atomic_bool mEnabled;
+
+    ThreadBuffers<TraceEvent, THREAD_BUFFER_SIZE> mBuffers;
+
+    std::deque<RecordedEvent> mEvents;
+
+    std::size_t mMaxEvents;
+
+    Tracer() noexcept;
+
+  public:
+    ~Tracer() noexcept = default;
+
+    Tracer(const Tracer&) = delete;
+
+    Tracer(Tracer&&) = delete;
+
+    Tracer& operator=(const Tracer&) = delete;
+
+    Tracer& operator=(Tracer&&) = delete;
+
+    // Process-wide tracer used by all LS_GAME_TRACE_SCOPE() zones.
+    static Tracer& global() noexcept;
+
+    void enable(bool doEnable) noexcept;
+
+    bool is_enabled() const noexcept;
+
+    // Record a zone from the calling thread. Lock-free.
+    void record(const char* name, uint64_t startNanos, uint64_t durationNanos, std::size_t arg = NO_ARG) noexcept;
+
+    // Gather events from all threads. The following functions must only be
+    // called from one thread at a time.
+    void collect() noexcept;
+
+    void max_events(std::size_t maxEvents) noexcept;
+
+    std::size_t max_events() const noexcept;
+
+    // Number of gathered events.
+    std::size_t num_events() const noexcept;
+
+    // Number of events lost because a thread recorded them faster than they
+    // were gathered.
+    uint64_t num_dropped() const noexcept;
+
+    void clear() noexcept;
+
+    // Gather all events and write them as Chrome Trace Event JSON.
+    bool write_chrome_trace(std::ostream& out) noexcept;
+
+    bool write_chrome_trace(const char* path) noexcept;
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * Trace Zone
+ *
+ * Records the lifetime of a scope with the global tracer.
+-----------------------------------------------------------------------------*/
+class TraceZone
+{
+  private:
+    // NULL if the tracer was disabled upon construction.
+    const char* mName;
+
+    std::size_t mArg;
+
+    uint64_t mStartNanos;
+
+  public:
+    ~TraceZone() noexcept;
+
+    TraceZone(const char* name, std::size_t arg = Tracer::NO_ARG) noexcept;
+
+    TraceZone(const TraceZone&) = delete;
+
+    TraceZone(TraceZone&&) = delete;
+
+    TraceZone& operator=(const TraceZone&) = delete;
+
+    TraceZone& operator=(TraceZone&&) = delete;
+};
+
+
+
+/*-------------------------------------
+ * Check if zones are recorded
+-------------------------------------*/
+inline bool Tracer::is_enabled() const noexcept
+{
+    return mEnabled.load(std::memory_order_relaxed);
+}
+
+
+
+/*-------------------------------------
+ * Maximum number of gathered events
+-------------------------------------*/
+inline std::size_t Tracer::max_events() const noexcept
+{
+    return mMaxEvents;
+}
+
+
+
+/*-------------------------------------
+ * Number of gathered events
+-------------------------------------*/
+inline std::size_t Tracer::num_events() const noexcept
+{
+    return mEvents.size();
+}
+
+
+
+/*-------------------------------------
+ * Number of lost events
+-------------------------------------*/
+inline uint64_t Tracer::num_dropped() const noexcept
+{
+    return mBuffers.num_dropped();
+}
+
+
+
+// Only one zone may be declared per scope.
+#ifndef LS_GAME_TRACE_SCOPE
+    #ifdef LS_GAME_ENABLE_PROFILING
+        #define LS_GAME_TRACE_SCOPE( ... ) \
+            const ls::game::TraceZone lsGameTraceZone{__VA_ARGS__}
+    #else
+        #define LS_GAME_TRACE_SCOPE( ... )
+    #endif
+#endif
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_TRACER_HPP */
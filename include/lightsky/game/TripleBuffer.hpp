@@ -0,0 +1,166 @@
+
+#ifndef LS_GAME_TRIPLE_BUFFER_HPP
+#define LS_GAME_TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Triple Buffer
+ *
+ * Lock-free, wait-free exchange of values between one writer thread and one
+ * reader thread. The writer fills "back()" then calls "publish()". The reader
+ * calls "acquire()" to retrieve the most recently published value, which
+ * remains untouched by the writer until the reader acquires again.
+-----------------------------------------------------------------------------*/
+template <typename T>
+class TripleBuffer
+{
+  private:
+    enum : unsigned
+    {
+        INDEX_MASK = 0x03u,
+        NEW_DATA_BIT = 0x04u
+    };
+
+    T mBuffers[3];
+
+    // Index of the buffer waiting to be acquired by the reader. The writer
+    // and reader each own one of the remaining two buffers.
+    std::atomic_uint mMiddle;
+
+    unsigned mBack;
+
+    unsigned mFront;
+
+  public:
+    ~TripleBuffer() noexcept = default;
+
+    TripleBuffer() noexcept;
+
+    TripleBuffer(const T& initialValue);
+
+    TripleBuffer(const TripleBuffer&) = delete;
+
+    TripleBuffer(TripleBuffer&&) = delete;
+
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    TripleBuffer& operator=(TripleBuffer&&) = delete;
+
+    // Writer thread only.
+    T& back() noexcept;
+
+    // Writer thread only.
+    void publish() noexcept;
+
+    // Check if new data was published since the last acquisition.
+    bool has_update() const noexcept;
+
+    // Reader thread only.
+    const T& acquire() noexcept;
+
+    // Reader thread only. Retrieve the last acquired value.
+    const T& front() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+template <typename T>
+TripleBuffer<T>::TripleBuffer() noexcept :
+    mBuffers{},
+    mMiddle{1},
+    mBack{0},
+    mFront{2}
+{}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+template <typename T>
+TripleBuffer<T>::TripleBuffer(const T& initialValue) :
+    mBuffers{initialValue, initialValue, initialValue},
+    mMiddle{1},
+    mBack{0},
+    mFront{2}
+{}
+
+
+
+/*-------------------------------------
+ * Writable buffer
+-------------------------------------*/
+template <typename T>
+inline T& TripleBuffer<T>::back() noexcept
+{
+    return mBuffers[mBack];
+}
+
+
+
+/*-------------------------------------
+ * Swap the back buffer with the middle buffer
+-------------------------------------*/
+template <typename T>
+inline void TripleBuffer<T>::publish() noexcept
+{
+    const unsigned prevMiddle = mMiddle.exchange(mBack | NEW_DATA_BIT, std::memory_order_acq_rel);
+    mBack = prevMiddle & INDEX_MASK;
+}
+
+
+
+/*-------------------------------------
+ * Check for newly published data
+-------------------------------------*/
+template <typename T>
+inline bool TripleBuffer<T>::has_update() const noexcept
+{
+    return (mMiddle.load(std::memory_order_relaxed) & NEW_DATA_BIT) != 0;
+}
+
+
+
+/*-------------------------------------
+ * Swap the front buffer with the middle buffer
+-------------------------------------*/
+template <typename T>
+inline const T& TripleBuffer<T>::acquire() noexcept
+{
+    if (has_update())
+    {
+        const unsigned prevMiddle = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+        mFront = prevMiddle & INDEX_MASK;
+    }
+
+    return mBuffers[mFront];
+}
+
+
+
+/*-------------------------------------
+ * Readable buffer
+-------------------------------------*/
+template <typename T>
+inline const T& TripleBuffer<T>::front() const noexcept
+{
+    return mBuffers[mFront];
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_TRIPLE_BUFFER_HPP */
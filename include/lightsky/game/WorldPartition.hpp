@@ -0,0 +1,265 @@
+
+#ifndef LS_GAME_WORLD_PARTITION_HPP
+#define LS_GAME_WORLD_PARTITION_HPP
+
+#include <condition_variable>
+#include <cstdint> // uint64_t
+#include <cstdlib> // size_t
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "lightsky/math/vec3.h"
+
+#include "lightsky/game/ECSDatabase.hpp"
+#include "lightsky/game/Entity.hpp"
+#include "lightsky/game/EntitySet.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+typedef uint64_t CellId;
+
+
+
+enum class CellState : unsigned
+{
+    CELL_ERR_IO,
+    CELL_LOADED,
+    CELL_UNLOADING,
+    CELL_UNLOADED,
+    CELL_LOADING
+};
+
+
+
+/*-----------------------------------------------------------------------------
+ * World Partition
+ *
+ * Groups the entities of an ECSDatabase into cells which can be streamed to
+ * and from disk. Unloading a cell serializes its entities, destroys them, and
+ * writes the result on a background I/O thread. Loading a cell reads it on
+ * the same thread, after which "sync()" merges its entities back into the
+ * database at a frame sync point, never creating more than the merge budget
+ * per call.
+ *
+ * Loaded entities receive new IDs and keep their dormancy. Components are identified in cell files
+ * by registration ID, which is only stable within the running process, so
+ * cell files act as a streaming cache rather than save data.
+ *
+ * Entities leave their cell when the database destroys them and follow their
+ * new IDs after compaction.
+ *
+ * The database must outlive *this and must not be moved while *this exists.
+-----------------------------------------------------------------------------*/
+class WorldPartition final : private EntityListener
+{
+  private:
+    enum class IOJobType
+    {
+        IO_READ,
+        IO_WRITE
+    };
+
+    struct IOJob
+    {
+        IOJobType type;
+        CellId cellId;
+        std::vector<char> data;
+    };
+
+    // A cell read from disk, waiting to be merged into the database.
+    struct PendingCell
+    {
+        CellId cellId;
+        bool ok;
+        std::vector<char> data;
+
+        // Read position and number of entities left to merge.
+        std::size_t offset;
+        uint64_t numRemaining;
+
+        // Entities created from this cell so far, destroyed again if the
+        // rest of the cell fails to merge.
+        EntitySet created;
+    };
+
+    ECSDatabase& mDb;
+
+    std::string mDirectory;
+
+    std::size_t mMergeBudget;
+
+    std::unordered_map<EntityIdType, CellId> mEntityCells;
+
+    std::unordered_map<CellId, EntitySet> mCellEntities;
+
+    std::unordered_map<CellId, CellState> mCellStates;
+
+    // Entities created by the most recent call to "sync()".
+    std::vector<Entity> mMerged;
+
+    // Cells being merged, in the order they finished loading. Only
+    // accessed by the thread which owns the database.
+    std::deque<PendingCell> mMerging;
+
+    // I/O jobs whose results have not been collected by "sync()".
+    std::size_t mNumIOJobs;
+
+    // Shared with the I/O thread.
+    std::mutex mLock;
+    std::condition_variable mWakeup;
+    std::deque<IOJob> mJobs;
+    std::deque<PendingCell> mLoaded;
+    std::vector<CellId> mWritten;
+    std::vector<CellId> mFailedWrites;
+    bool mStopping;
+
+    std::thread mIOThread;
+
+    void _run_io() noexcept;
+
+    void _push_job(IOJobType type, CellId cellId, std::vector<char>&& data) noexcept;
+
+    bool _serialize_cell(const EntitySet& entities, std::vector<char>& outData) const noexcept;
+
+    // Returns false if the cell data is malformed.
+    bool _merge_entity(PendingCell& cell) noexcept;
+
+    // Destroy every entity created from a cell which failed to merge.
+    void _discard_merge(PendingCell& cell) noexcept;
+
+    virtual void on_destroy(const Entity& e) noexcept override;
+
+    virtual void on_rename(const Entity& from, const Entity& to) noexcept override;
+
+  public:
+    enum : std::size_t
+    {
+        DEFAULT_MERGE_BUDGET = 1024
+    };
+
+    // Drains all pending writes before returning.
+    virtual ~WorldPartition() noexcept override;
+
+    // Cell files are stored within "directory", which must already exist.
+    // No cells can be assigned or streamed until "start()" succeeds.
+    WorldPartition(ECSDatabase& db, const std::string& directory) noexcept;
+
+    WorldPartition(const WorldPartition&) = delete;
+
+    WorldPartition(WorldPartition&&) = delete;
+
+    WorldPartition& operator=(const WorldPartition&) = delete;
+
+    WorldPartition& operator=(WorldPartition&&) = delete;
+
+    // Launch the background I/O thread and begin following entity
+    // destructions. Returns false if the thread could not be created.
+    bool start() noexcept;
+
+    bool is_started() const noexcept;
+
+    // Retrieve the cell which contains a position on a grid along the X and
+    // Z axes.
+    static CellId cell_at(const math::vec3& position, float cellSize) noexcept;
+
+    // Path of the file which stores an unloaded cell.
+    std::string cell_path(CellId cellId) const noexcept;
+
+    // Place an entity within a cell, removing it from its previous cell.
+    // Returns false if the entity does not exist or *this is not started.
+    bool assign(const Entity& e, CellId cellId) noexcept;
+
+    // Remove an entity from its cell. The entity stays resident.
+    void unassign(const Entity& e) noexcept;
+
+    // Returns false if the entity is not assigned to a cell.
+    bool cell_of(const Entity& e, CellId& outCellId) const noexcept;
+
+    // Cells which have never been assigned entities are CELL_LOADED.
+    CellState cell_state(CellId cellId) const noexcept;
+
+    // Serialize and destroy all entities within a loaded cell, then write
+    // the cell to disk in the background. Returns false if the cell is not
+    // loaded or a component's data could not be serialized, in which case
+    // no entity is destroyed.
+    bool unload(CellId cellId) noexcept;
+
+    // Read an unloaded or failed cell in the background. Its entities are
+    // created by later calls to "sync()". A read queued behind a failed
+    // write finds no file and fails. If a cell fails partway through
+    // merging, the entities already created from it are destroyed.
+    bool load(CellId cellId) noexcept;
+
+    // Maximum number of entities created by each call to "sync()". Zero is
+    // treated as one.
+    void merge_budget(std::size_t maxEntities) noexcept;
+
+    std::size_t merge_budget() const noexcept;
+
+    // Merge loaded cells into the database and update the state of cells
+    // which finished writing. Must be called from the thread which owns the
+    // database. Returns the number of entities created.
+    std::size_t sync() noexcept;
+
+    // Entities created by the most recent call to "sync()".
+    const std::vector<Entity>& merged_entities() const noexcept;
+
+    // Number of cells waiting on disk I/O or being merged.
+    std::size_t num_pending_cells() const noexcept;
+};
+
+
+
+/*-------------------------------------
+ * Set the per-sync merge budget
+-------------------------------------*/
+inline void WorldPartition::merge_budget(std::size_t maxEntities) noexcept
+{
+    mMergeBudget = maxEntities ? maxEntities : 1;
+}
+
+
+
+/*-------------------------------------
+ * Get the per-sync merge budget
+-------------------------------------*/
+inline std::size_t WorldPartition::merge_budget() const noexcept
+{
+    return mMergeBudget;
+}
+
+
+
+/*-------------------------------------
+ * Check for a running I/O thread
+-------------------------------------*/
+inline bool WorldPartition::is_started() const noexcept
+{
+    return mIOThread.joinable();
+}
+
+
+
+/*-------------------------------------
+ * Entities created during the last sync
+-------------------------------------*/
+inline const std::vector<Entity>& WorldPartition::merged_entities() const noexcept
+{
+    return mMerged;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
+
+#endif /* LS_GAME_WORLD_PARTITION_HPP */
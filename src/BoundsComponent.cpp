@@ -0,0 +1,29 @@
+
+#include "lightsky/game/BoundsComponent.hpp"
+
+LS_GAME_REGISTER_COMPONENT(ls::game::BoundsComponent)
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-------------------------------------
+ * Set an entity's bounds
+-------------------------------------*/
+bool BoundsComponent::bounds(const Entity& e, const math::vec3& minBounds, const math::vec3& maxBounds) noexcept
+{
+    return set<MIN_X>(e, minBounds[0])
+        && set<MIN_Y>(e, minBounds[1])
+        && set<MIN_Z>(e, minBounds[2])
+        && set<MAX_X>(e, maxBounds[0])
+        && set<MAX_Y>(e, maxBounds[1])
+        && set<MAX_Z>(e, maxBounds[2]);
+}
+
+
+
+} // end game namespace
+} // end ls namespace
@@ -1,8 +1,10 @@
 
+#include <algorithm> // std::sort
 #include <atomic>
 #include <utility> // std::move
 
 #include "lightsky/game/Component.hpp"
+#include "lightsky/game/RollbackBuffer.hpp"
 
 namespace ls
 {
@@ -11,6 +13,16 @@ namespace game
 
 
 
+void ComponentListener::on_erase_batch(std::size_t componentId, const std::vector<Entity>& entities) noexcept
+{
+    for (const Entity& e : entities)
+    {
+        on_erase(componentId, e);
+    }
+}
+
+
+
 std::size_t Component::_increment_component_id() noexcept
 {
     static std::atomic_size_t idCount{0};
@@ -21,20 +33,79 @@ std::size_t Component::_increment_component_id() noexcept
 
 Component::~Component() noexcept
 {
-    clear();
+    mEntities.clear();
 }
 
 
 
-Component::Component() noexcept
+Component::Component() noexcept :
+    mRegistrationId{0},
+    mListener{nullptr},
+    mUpdateSlices{1},
+    mUpdateBudget{0},
+    mUpdateCursor{0},
+    mDormantEntities{nullptr},
+    mNumActive{0},
+    mOrder{ComponentOrder::ORDER_PACKED},
+    mOrderDirty{false},
+    mEntities{}
 {
 }
 
 
 
+Component::Component(const Component& c) :
+    mRegistrationId{c.mRegistrationId},
+    mListener{nullptr},
+    mUpdateSlices{c.mUpdateSlices},
+    mUpdateBudget{c.mUpdateBudget},
+    mUpdateCursor{c.mUpdateCursor},
+    mDormantEntities{nullptr},
+    mNumActive{c.mNumActive},
+    mOrder{c.mOrder},
+    mOrderDirty{c.mOrderDirty},
+    mEntities{c.mEntities}
+{}
+
+
+
 Component::Component(Component&& c) noexcept :
+    mRegistrationId{c.mRegistrationId},
+    mListener{nullptr},
+    mUpdateSlices{c.mUpdateSlices},
+    mUpdateBudget{c.mUpdateBudget},
+    mUpdateCursor{c.mUpdateCursor},
+    mDormantEntities{nullptr},
+    mNumActive{c.mNumActive},
+    mOrder{c.mOrder},
+    mOrderDirty{c.mOrderDirty},
     mEntities{std::move(c.mEntities)}
-{}
+{
+    c.mNumActive = 0;
+}
+
+
+
+Component& Component::operator=(const Component& c)
+{
+    if (this != &c)
+    {
+        mUpdateSlices = c.mUpdateSlices;
+        mUpdateBudget = c.mUpdateBudget;
+        mUpdateCursor = c.mUpdateCursor;
+        mNumActive = c.mNumActive;
+        mOrder = c.mOrder;
+        mOrderDirty = c.mOrderDirty;
+        mEntities = c.mEntities;
+
+        if (mListener)
+        {
+            mListener->on_reset(mRegistrationId);
+        }
+    }
+
+    return *this;
+}
 
 
 
@@ -42,7 +113,19 @@ Component& Component::operator=(Component&& c) noexcept
 {
     if (this != &c)
     {
+        mUpdateSlices = c.mUpdateSlices;
+        mUpdateBudget = c.mUpdateBudget;
+        mUpdateCursor = c.mUpdateCursor;
+        mNumActive = c.mNumActive;
+        mOrder = c.mOrder;
+        mOrderDirty = c.mOrderDirty;
         mEntities = std::move(c.mEntities);
+        c.mNumActive = 0;
+
+        if (mListener)
+        {
+            mListener->on_reset(mRegistrationId);
+        }
     }
 
     return *this;
@@ -50,38 +133,416 @@ Component& Component::operator=(Component&& c) noexcept
 
 
 
+bool Component::insert_data(std::size_t) noexcept
+{
+    return true;
+}
+
+
+
+bool Component::erase_data(std::size_t) noexcept
+{
+    return true;
+}
+
+
+
+void Component::clear_data() noexcept
+{
+}
+
+
+
+bool Component::swap_data(std::size_t, std::size_t) noexcept
+{
+    return true;
+}
+
+
+
+void Component::shrink_data() noexcept
+{
+}
+
+
+
+void Component::restore_data() noexcept
+{
+}
+
+
+
+bool Component::_rename(const Entity& from, const Entity& to) noexcept
+{
+    mOrderDirty = true;
+    return mEntities.rename(from, to);
+}
+
+
+
+bool Component::_swap(std::size_t indexA, std::size_t indexB) noexcept
+{
+    if (!mEntities.swap(indexA, indexB))
+    {
+        return false;
+    }
+
+    // Swapping back only touches pages which were just un-shared
+    if (!swap_data(indexA, indexB))
+    {
+        mEntities.swap(indexA, indexB);
+        return false;
+    }
+
+    mOrderDirty = true;
+    return true;
+}
+
+
+
+bool Component::_sleep(const Entity& e) noexcept
+{
+    const std::size_t index = mEntities.index_of(e);
+
+    if (index >= mNumActive)
+    {
+        return true;
+    }
+
+    if (index != mNumActive-1 && !_swap(index, mNumActive-1))
+    {
+        return false;
+    }
+
+    --mNumActive;
+    return true;
+}
+
+
+
+bool Component::_wake(const Entity& e) noexcept
+{
+    const std::size_t index = mEntities.index_of(e);
+
+    if (index < mNumActive)
+    {
+        return true;
+    }
+
+    if (index != mNumActive && !_swap(index, mNumActive))
+    {
+        return false;
+    }
+
+    ++mNumActive;
+    return true;
+}
+
+
+
+void Component::shrink_to_fit() noexcept
+{
+    mEntities.shrink_to_fit();
+    shrink_data();
+}
+
+
+
+bool Component::serialize_data(std::size_t, std::vector<char>&) const noexcept
+{
+    return false;
+}
+
+
+
+bool Component::deserialize_data(std::size_t, const char*, std::size_t numBytes) noexcept
+{
+    return numBytes == 0;
+}
+
+
+
 ComponentAddStatus Component::insert(const Entity& e) noexcept
 {
-    auto&& iter = mEntities.find(e);
-    if (iter == mEntities.end())
+    if (e.id == ~(EntityIdType)0)
+    {
+        return ComponentAddStatus::ADD_ERR_INVALID_ARGS;
+    }
+
+    if (mEntities.contains(e))
     {
-        return mEntities.insert(e).second ? ComponentAddStatus::ADD_OK : ComponentAddStatus::ADD_ERR_OTHER;
+        return ComponentAddStatus::ADD_ERR_ENTITY_EXISTS;
     }
 
-    return ComponentAddStatus::ADD_ERR_ENTITY_EXISTS;
+    if (!mEntities.insert(e))
+    {
+        return ComponentAddStatus::ADD_ERR_NO_MEMORY;
+    }
+
+    const std::size_t index = mEntities.size()-1;
+
+    if (!insert_data(index))
+    {
+        mEntities.erase(e);
+        return ComponentAddStatus::ADD_ERR_NO_MEMORY;
+    }
+
+    // New entities join the awake prefix unless they were put to sleep
+    if (!mDormantEntities || !mDormantEntities->contains(e))
+    {
+        if (index != mNumActive && !_swap(mNumActive, index))
+        {
+            erase_data(index);
+            mEntities.erase(e);
+            return ComponentAddStatus::ADD_ERR_NO_MEMORY;
+        }
+
+        ++mNumActive;
+    }
+
+    mOrderDirty = true;
+
+    if (mListener)
+    {
+        mListener->on_insert(mRegistrationId, e);
+    }
+
+    return ComponentAddStatus::ADD_OK;
+}
+
+
+
+bool Component::_erase_row(std::size_t index) noexcept
+{
+    const Entity e = mEntities[index];
+    const bool isActive = index < mNumActive;
+
+    // Move awake entities to the end of the awake prefix first, so the
+    // swap-and-pop below only moves a dormant entity within the dormant
+    // range
+    if (isActive && mNumActive != mEntities.size())
+    {
+        if (index != mNumActive-1 && !_swap(index, mNumActive-1))
+        {
+            return false;
+        }
+
+        index = mNumActive-1;
+    }
+
+    // Removal can only fail if a shared page could not be duplicated. The
+    // entity pages are reserved first so the data is never moved without
+    // its entity.
+    if (!mEntities.reserve_erase(e) || !erase_data(index))
+    {
+        return false;
+    }
+
+    mEntities.erase(e);
+
+    if (isActive)
+    {
+        --mNumActive;
+    }
+
+    mOrderDirty = true;
+    return true;
 }
 
 
 
 ComponentRemoveStatus Component::erase(const Entity& e) noexcept
 {
-    auto&& iter = mEntities.find(e);
-    if (iter != mEntities.end())
+    if (!mEntities.contains(e))
     {
-        mEntities.erase(e);
-        return ComponentRemoveStatus::REMOVE_OK;
+        return ComponentRemoveStatus::REMOVE_ERR_ENTITY_MISSING;
+    }
+
+    if (!_erase_row(mEntities.index_of(e)))
+    {
+        return ComponentRemoveStatus::REMOVE_ERR_NO_MEMORY;
+    }
+
+    if (mListener)
+    {
+        mListener->on_erase(mRegistrationId, e);
+    }
+
+    return ComponentRemoveStatus::REMOVE_OK;
+}
+
+
+
+std::size_t Component::erase(const std::vector<Entity>& entities, std::vector<Entity>* pFailed) noexcept
+{
+    // Removed entities are only gathered when someone will be told of them
+    std::vector<Entity> erased;
+    std::size_t numErased = 0;
+
+    if (mListener)
+    {
+        erased.reserve(entities.size());
+    }
+
+    for (const Entity& e : entities)
+    {
+        if (!mEntities.contains(e))
+        {
+            continue;
+        }
+
+        if (_erase_row(mEntities.index_of(e)))
+        {
+            ++numErased;
+
+            if (mListener)
+            {
+                erased.push_back(e);
+            }
+        }
+        else if (pFailed)
+        {
+            pFailed->push_back(e);
+        }
+    }
+
+    if (!erased.empty())
+    {
+        mListener->on_erase_batch(mRegistrationId, erased);
     }
 
-    return ComponentRemoveStatus::REMOVE_ERR_ENTITY_MISSING;
+    return numErased;
+}
+
+
+
+void Component::track_history(RollbackBuffer& rb) noexcept
+{
+    rb.track(mEntities);
+}
+
+
+
+MemoryStats Component::memory_stats() const noexcept
+{
+    return mEntities.memory_stats();
+}
+
+
+
+bool Component::sort_entities() noexcept
+{
+    const auto compareIds = [](const Entity& a, const Entity& b) noexcept->bool
+    {
+        return entity_index(a) < entity_index(b);
+    };
+
+    // Entities created in order and appended to the awake prefix leave it
+    // sorted, making this check the common case
+    std::size_t firstUnsorted = 1;
+    while (firstUnsorted < mNumActive && !compareIds(mEntities[firstUnsorted], mEntities[firstUnsorted-1]))
+    {
+        ++firstUnsorted;
+    }
+
+    if (firstUnsorted < mNumActive)
+    {
+        std::vector<Entity> order;
+        order.reserve(mNumActive);
+
+        for (std::size_t i = 0; i < mNumActive; ++i)
+        {
+            order.push_back(mEntities[i]);
+        }
+
+        std::sort(order.begin(), order.end(), compareIds);
+
+        // Each swap moves one entity into its final position
+        for (std::size_t i = 0; i < order.size(); ++i)
+        {
+            const std::size_t index = mEntities.index_of(order[i]);
+            if (index != i && !_swap(i, index))
+            {
+                return false;
+            }
+        }
+    }
+
+    mOrderDirty = false;
+    return true;
 }
 
 
 
 void Component::update() noexcept
 {
-    for (const game::Entity& e : mEntities)
+    LS_GAME_PROFILE_UPDATE(*this);
+
+    // A failed sort still visits every entity, just in packed order
+    if (mOrder == ComponentOrder::ORDER_SORTED && mOrderDirty)
+    {
+        sort_entities();
+    }
+
+    if (mUpdateSlices <= 1 && !mUpdateBudget)
+    {
+        for (std::size_t i = 0; i < mNumActive; ++i)
+        {
+            this->update_entity(mEntities[i]);
+        }
+
+        return;
+    }
+
+    const std::size_t numEntities = mNumActive;
+    const std::size_t sliceSize = (numEntities + mUpdateSlices - 1) / mUpdateSlices;
+    const uint64_t deadline = mUpdateBudget ? (ComponentProfiler::now() + mUpdateBudget * 1000u) : 0;
+
+    std::size_t i = 0;
+
+    // Entities removed by "update_entity()" may shrink the awake prefix, so
+    // the cursor is re-checked against the current size
+    for (; i < sliceSize; ++i)
+    {
+        if (mUpdateCursor >= mNumActive)
+        {
+            mUpdateCursor = 0;
+
+            if (!mNumActive)
+            {
+                break;
+            }
+        }
+
+        // Reading the clock costs more than most updates, so the budget is
+        // only checked every few entities
+        if (deadline && i && !(i % UPDATE_BUDGET_INTERVAL) && ComponentProfiler::now() >= deadline)
+        {
+            break;
+        }
+
+        this->update_entity(mEntities[mUpdateCursor++]);
+    }
+
+    #ifdef LS_GAME_ENABLE_PROFILING
+        mNumUpdated = i;
+    #endif
+
+    if (mUpdateCursor >= mNumActive)
+    {
+        mUpdateCursor = 0;
+    }
+}
+
+
+
+void Component::update_range(std::size_t first, std::size_t count) noexcept
+{
+    const std::size_t last = std::min(mNumActive, first + count);
+
+    for (std::size_t i = first; i < last; ++i)
     {
-        this->update_entity(e);
+        this->update_entity(mEntities[i]);
     }
 }
 
@@ -0,0 +1,217 @@
+
+#include <algorithm> // std::sort
+#include <chrono> // std::chrono::steady_clock
+
+#include "lightsky/game/Component.hpp"
+#include "lightsky/game/ComponentProfiler.hpp"
+#include "lightsky/game/Tracer.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Anonymous helper functions
+-----------------------------------------------------------------------------*/
+namespace
+{
+
+
+
+/*-------------------------------------
+ * Nearest-rank percentile of sorted values
+-------------------------------------*/
+template <typename T>
+inline T percentile(const std::vector<T>& sortedValues, std::size_t pct) noexcept
+{
+    const std::size_t rank = (sortedValues.size() * pct + 99) / 100;
+    return sortedValues[rank ? (rank-1) : 0];
+}
+
+
+
+} // end anonymous namespace
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Profiler
+-----------------------------------------------------------------------------*/
+/*-------------------------------------
+ * Gather samples from all threads
+-------------------------------------*/
+void ComponentProfiler::_collect() noexcept
+{
+    mBuffers.consume([this](const Sample& s, std::size_t) noexcept->void
+    {
+        if (mWindows.size() <= s.componentId)
+        {
+            mWindows.resize(s.componentId+1, Window{0, Sample{0, 0, 0}, 0, std::vector<Sample>{}});
+        }
+
+        Window& w = mWindows[s.componentId];
+        w.numUpdates += 1;
+        w.last = s;
+
+        if (w.samples.size() < WINDOW_SIZE)
+        {
+            w.samples.push_back(s);
+        }
+        else
+        {
+            w.samples[w.next] = s;
+        }
+
+        w.next = (w.next + 1) % WINDOW_SIZE;
+    });
+}
+
+
+
+/*-------------------------------------
+ * Record an update
+-------------------------------------*/
+void ComponentProfiler::record(std::size_t componentId, uint64_t nanos, std::size_t numEntities) noexcept
+{
+    mBuffers.push(Sample{componentId, nanos, numEntities});
+}
+
+
+
+/*-------------------------------------
+ * Summarize the updates of a component
+-------------------------------------*/
+bool ComponentProfiler::timing(std::size_t componentId, ComponentTiming& outTiming) noexcept
+{
+    _collect();
+
+    if (componentId >= mWindows.size() || !mWindows[componentId].numUpdates)
+    {
+        return false;
+    }
+
+    const Window& w = mWindows[componentId];
+    std::vector<uint64_t> nanos;
+    std::vector<double> nanosPerEntity;
+    nanos.reserve(w.samples.size());
+    nanosPerEntity.reserve(w.samples.size());
+
+    for (const Sample& s : w.samples)
+    {
+        nanos.push_back(s.nanos);
+        nanosPerEntity.push_back((double)s.nanos / (double)(s.numEntities ? s.numEntities : 1));
+    }
+
+    std::sort(nanos.begin(), nanos.end());
+    std::sort(nanosPerEntity.begin(), nanosPerEntity.end());
+
+    outTiming.componentId = componentId;
+    outTiming.numUpdates = w.numUpdates;
+    outTiming.lastNanos = w.last.nanos;
+    outTiming.lastEntities = w.last.numEntities;
+    outTiming.p50Nanos = percentile(nanos, 50);
+    outTiming.p95Nanos = percentile(nanos, 95);
+    outTiming.p99Nanos = percentile(nanos, 99);
+    outTiming.p50NanosPerEntity = percentile(nanosPerEntity, 50);
+    outTiming.p95NanosPerEntity = percentile(nanosPerEntity, 95);
+    outTiming.p99NanosPerEntity = percentile(nanosPerEntity, 99);
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Discard the samples of a component
+-------------------------------------*/
+void ComponentProfiler::reset(std::size_t componentId) noexcept
+{
+    _collect();
+
+    if (componentId < mWindows.size())
+    {
+        mWindows[componentId] = Window{0, Sample{0, 0, 0}, 0, std::vector<Sample>{}};
+    }
+}
+
+
+
+/*-------------------------------------
+ * Discard all samples
+-------------------------------------*/
+void ComponentProfiler::clear() noexcept
+{
+    _collect();
+    mWindows.clear();
+    mBuffers.reset_num_dropped();
+}
+
+
+
+/*-------------------------------------
+ * Number of discarded samples
+-------------------------------------*/
+uint64_t ComponentProfiler::num_dropped() const noexcept
+{
+    return mBuffers.num_dropped();
+}
+
+
+
+/*-------------------------------------
+ * Current time
+-------------------------------------*/
+uint64_t ComponentProfiler::now() noexcept
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+
+
+/*-----------------------------------------------------------------------------
+ * Component Update Timer
+-----------------------------------------------------------------------------*/
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+ComponentUpdateTimer::~ComponentUpdateTimer() noexcept
+{
+    #ifdef LS_GAME_ENABLE_PROFILING
+        const uint64_t duration = ComponentProfiler::now() - mStartTime;
+
+        if (mComponent.mProfiler)
+        {
+            mComponent.mProfiler->record(mComponent.mRegistrationId, duration, mComponent.mNumUpdated);
+        }
+
+        Tracer& tracer = Tracer::global();
+        if (tracer.is_enabled())
+        {
+            tracer.record("Component::update", mStartTime, duration, mComponent.mRegistrationId);
+        }
+    #endif
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+ComponentUpdateTimer::ComponentUpdateTimer(Component& c) noexcept :
+    mComponent{c},
+    mStartTime{ComponentProfiler::now()}
+{
+    #ifdef LS_GAME_ENABLE_PROFILING
+        c.mNumUpdated = c.mNumActive;
+    #endif
+}
+
+
+
+} // end game namespace
+} // end ls namespace
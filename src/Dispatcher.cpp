@@ -10,6 +10,7 @@
 #include "lightsky/game/Event.h"
 #include "lightsky/game/Subscriber.h"
 #include "lightsky/game/Dispatcher.h"
+#include "lightsky/game/Tracer.hpp"
 
 
 
@@ -103,6 +104,8 @@ Dispatcher& Dispatcher::operator=(Dispatcher&& d)
 -------------------------------------*/
 void Dispatcher::dispatch()
 {
+    LS_GAME_TRACE_SCOPE("Dispatcher::dispatch");
+
     std::size_t sentinel = mEvents.size();
 
     for (std::size_t i = 0; i < sentinel; ++i)
@@ -1,4 +1,5 @@
 
+#include <algorithm> // std::find, std::max, std::min, std::sort
 #include <utility> // std::move
 
 #include "lightsky/utils/Assertions.h"
@@ -14,24 +15,66 @@ namespace game
 
 ECSDatabase::~ECSDatabase() noexcept
 {
+    for (EntityBlock* pBlock : mEntityBlocks)
+    {
+        pBlock->mDb = nullptr;
+    }
 }
 
 
 
 ECSDatabase::ECSDatabase() noexcept :
     mComponents{},
+    mCloneFuncs{},
     mEntities{},
-    mMinEntityId{0}
-{}
+    mDeadEntities{},
+    mDormantEntities{},
+    mMinEntityId{0},
+    mGenerations{},
+    mEntityBlocks{},
+    mEntityListeners{},
+    mReservedIdBegin{(std::size_t)INVALID_ENTITY},
+    mNextReservedId{(std::size_t)INVALID_ENTITY},
+    mSnapshots{},
+    mQueries{},
+    mCompaction{},
+    mCompactRemap{}
+{
+    mQueries.hidden_entities(&mDeadEntities);
+}
 
 
 
 ECSDatabase::ECSDatabase(ECSDatabase&& db) noexcept :
     mComponents{std::move(db.mComponents)},
+    mCloneFuncs{std::move(db.mCloneFuncs)},
     mEntities{std::move(db.mEntities)},
-    mMinEntityId{db.mMinEntityId}
+    mDeadEntities{std::move(db.mDeadEntities)},
+    mDormantEntities{std::move(db.mDormantEntities)},
+    mMinEntityId{db.mMinEntityId},
+    mGenerations{std::move(db.mGenerations)},
+    mEntityBlocks{std::move(db.mEntityBlocks)},
+    mReservedIdBegin{db.mReservedIdBegin},
+    mNextReservedId{db.mNextReservedId.load(std::memory_order_acquire)},
+    mSnapshots{std::move(db.mSnapshots)},
+    mQueries{std::move(db.mQueries)},
+    mCompaction{std::move(db.mCompaction)},
+    mCompactRemap{std::move(db.mCompactRemap)}
+  #ifdef LS_GAME_ENABLE_PROFILING
+    , mProfiler{std::move(db.mProfiler)}
+  #endif
 {
+    for (EntityBlock* pBlock : mEntityBlocks)
+    {
+        pBlock->mDb = this;
+    }
+
+    _attach_components();
+
     db.mMinEntityId = 0;
+    db.mEntityBlocks.clear();
+    db.mReservedIdBegin = (std::size_t)INVALID_ENTITY;
+    db.mNextReservedId.store((std::size_t)INVALID_ENTITY, std::memory_order_release);
 }
 
 
@@ -40,11 +83,41 @@ ECSDatabase& ECSDatabase::operator=(ECSDatabase&& db) noexcept
 {
     if (this != &db)
     {
+        for (EntityBlock* pBlock : mEntityBlocks)
+        {
+            pBlock->mDb = nullptr;
+        }
+
         mComponents = std::move(db.mComponents);
+        mCloneFuncs = std::move(db.mCloneFuncs);
         mEntities = std::move(db.mEntities);
+        mDeadEntities = std::move(db.mDeadEntities);
+        mDormantEntities = std::move(db.mDormantEntities);
         mMinEntityId = db.mMinEntityId;
+        mGenerations = std::move(db.mGenerations);
+        mEntityBlocks = std::move(db.mEntityBlocks);
+        mReservedIdBegin = db.mReservedIdBegin;
+        mNextReservedId.store(db.mNextReservedId.load(std::memory_order_acquire), std::memory_order_release);
+        mSnapshots = std::move(db.mSnapshots);
+        mQueries = std::move(db.mQueries);
+        mCompaction = std::move(db.mCompaction);
+        mCompactRemap = std::move(db.mCompactRemap);
+
+      #ifdef LS_GAME_ENABLE_PROFILING
+        mProfiler = std::move(db.mProfiler);
+      #endif
+
+        for (EntityBlock* pBlock : mEntityBlocks)
+        {
+            pBlock->mDb = this;
+        }
+
+        _attach_components();
 
         db.mMinEntityId = 0;
+        db.mEntityBlocks.clear();
+        db.mReservedIdBegin = (std::size_t)INVALID_ENTITY;
+        db.mNextReservedId.store((std::size_t)INVALID_ENTITY, std::memory_order_release);
     }
 
     return *this;
@@ -52,33 +125,244 @@ ECSDatabase& ECSDatabase::operator=(ECSDatabase&& db) noexcept
 
 
 
+/*-------------------------------------
+ * Send component notifications to *this
+-------------------------------------*/
+void ECSDatabase::_attach_components() noexcept
+{
+    mQueries.hidden_entities(&mDeadEntities);
+
+    for (utils::Pointer<Component>& c : mComponents)
+    {
+        if (c)
+        {
+            c->mListener = &mQueries;
+            c->mDormantEntities = &mDormantEntities;
+
+          #ifdef LS_GAME_ENABLE_PROFILING
+            c->mProfiler = &mProfiler;
+          #endif
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Find the lowest free entity ID
+-------------------------------------*/
+void ECSDatabase::_update_min_entity_id(std::size_t firstCandidate) noexcept
+{
+    mMinEntityId = std::min(mMinEntityId, firstCandidate);
+
+    while (mEntities.contains_index(mMinEntityId))
+    {
+        ++mMinEntityId;
+    }
+}
+
+
+
+/*-------------------------------------
+ * Handle for a free entity index
+-------------------------------------*/
+Entity ECSDatabase::_make_entity(std::size_t index) const noexcept
+{
+    const EntityIdType generation = (index < mGenerations.size()) ? (EntityIdType)mGenerations[index] : 0;
+    return make_entity((EntityIdType)index, generation);
+}
+
+
+
+/*-------------------------------------
+ * Invalidate handles to a released index
+-------------------------------------*/
+void ECSDatabase::_retire_entity_id(const Entity& e) noexcept
+{
+    static_assert(ENTITY_GENERATION_BITS <= 8, "Entity generations must fit within a byte.");
+
+    if (ENTITY_GENERATION_BITS == 0)
+    {
+        return;
+    }
+
+    const std::size_t index = (std::size_t)entity_index(e);
+
+    // Stale handles may alias the next entity if this fails, but the index
+    // itself remains usable
+    if (index >= mGenerations.size() && !mGenerations.resize(index + 1))
+    {
+        return;
+    }
+
+    mGenerations.set(index, (uint8_t)((mGenerations[index] + 1u) & ENTITY_GENERATION_MASK));
+}
+
+
+
+/*-------------------------------------
+ * Begin tracking a thread-local entity allocator
+-------------------------------------*/
+void ECSDatabase::_register_entity_block(EntityBlock& block) noexcept
+{
+    // Reserve every ID which has never been used by *this
+    if (mEntityBlocks.empty())
+    {
+        mReservedIdBegin = std::max(mEntities.sparse().size(), mGenerations.size());
+        mNextReservedId.store(mReservedIdBegin, std::memory_order_release);
+    }
+
+    mEntityBlocks.push_back(&block);
+}
+
+
+
+/*-------------------------------------
+ * Stop tracking a thread-local entity allocator
+-------------------------------------*/
+void ECSDatabase::_unregister_entity_block(EntityBlock& block) noexcept
+{
+    std::vector<EntityBlock*>::iterator iter = std::find(mEntityBlocks.begin(), mEntityBlocks.end(), &block);
+    if (iter == mEntityBlocks.end())
+    {
+        return;
+    }
+
+    _merge_entity_block(block);
+    mEntityBlocks.erase(iter);
+    block.mDb = nullptr;
+
+    // Return all un-used IDs to the regular entity allocator
+    if (mEntityBlocks.empty())
+    {
+        _update_min_entity_id(mReservedIdBegin);
+        mReservedIdBegin = (std::size_t)INVALID_ENTITY;
+        mNextReservedId.store((std::size_t)INVALID_ENTITY, std::memory_order_release);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Move entities from a block into the entity table
+-------------------------------------*/
+void ECSDatabase::_merge_entity_block(EntityBlock& block) noexcept
+{
+    for (const Entity& e : block.mPending)
+    {
+        mEntities.insert(e);
+    }
+
+    block.mPending.clear();
+
+    // Remaining IDs in the block are released back to *this
+    block.mNextId = 0;
+    block.mEndId = 0;
+}
+
+
+
+/*-------------------------------------
+ * Reserve a range of IDs (thread-safe)
+-------------------------------------*/
+bool ECSDatabase::_reserve_entity_ids(std::size_t count, EntityIdType& outFirstId) noexcept
+{
+    const std::size_t firstId = mNextReservedId.fetch_add(count, std::memory_order_relaxed);
+
+    if (firstId >= (std::size_t)ENTITY_INDEX_MASK - count)
+    {
+        return false;
+    }
+
+    outFirstId = (EntityIdType)firstId;
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Clone all entities and components
+-------------------------------------*/
+ECSCloneStatus ECSDatabase::clone(ECSDatabase& outDb) const noexcept
+{
+    ECSDatabase db{};
+    db.mComponents.resize(mComponents.size());
+    db.mCloneFuncs = mCloneFuncs;
+
+    for (std::size_t i = 0; i < mComponents.size(); ++i)
+    {
+        if (!mComponents[i])
+        {
+            continue;
+        }
+
+        if (!mCloneFuncs[i])
+        {
+            return ECSCloneStatus::CLONE_ERR_COMPONENT_NOT_COPYABLE;
+        }
+
+        db.mComponents[i].reset(mCloneFuncs[i](*mComponents[i]));
+        if (!db.mComponents[i])
+        {
+            return ECSCloneStatus::CLONE_ERR_NO_MEMORY;
+        }
+    }
+
+    db._attach_components();
+
+    db.mEntities = mEntities;
+    db.mDeadEntities = mDeadEntities;
+    db.mDormantEntities = mDormantEntities;
+    db.mMinEntityId = mMinEntityId;
+    db.mGenerations = mGenerations;
+
+    // EntityBlocks are not shared with the clone
+    db._update_min_entity_id(mReservedIdBegin);
+
+    outDb = std::move(db);
+
+    return ECSCloneStatus::CLONE_OK;
+}
+
+
+
 /*-------------------------------------
  * Spawn an entity with a unique ID
 -------------------------------------*/
 Entity ECSDatabase::create_entity() noexcept
 {
-    if (mMinEntityId == std::numeric_limits<std::unordered_set<Entity>::size_type>::max())
+    // The highest index is reserved so no handle can equal INVALID_ENTITY
+    if (mMinEntityId >= (std::size_t)ENTITY_INDEX_MASK)
     {
         return Entity{(EntityIdType)INVALID_ENTITY};
     }
 
+    // All remaining IDs are shared with EntityBlocks on other threads
+    if (mMinEntityId >= mReservedIdBegin)
+    {
+        EntityIdType reservedId;
+        if (!_reserve_entity_ids(1, reservedId) || !mEntities.insert(Entity{reservedId}))
+        {
+            return Entity{(EntityIdType)INVALID_ENTITY};
+        }
+
+        return Entity{reservedId};
+    }
+
     // new entities always get the lowest free index in our set. This will help
     // both get a unique ID and enable us to check if we're out of memory.
-    Entity newEntity{mMinEntityId};
-    std::unordered_set<Entity>::iterator&& iter = mEntities.find(newEntity);
+    Entity newEntity = _make_entity(mMinEntityId);
 
     // make sure we're not creating a previously generated entity
-    LS_ASSERT(iter == mEntities.end()); // insurance
+    LS_ASSERT(!mEntities.contains(newEntity)); // insurance
 
-    mEntities.insert(newEntity);
+    if (!mEntities.insert(newEntity))
+    {
+        return Entity{(EntityIdType)INVALID_ENTITY};
+    }
 
-    while (true)
+    while (mEntities.contains_index(++mMinEntityId))
     {
-        iter = mEntities.find(Entity{++mMinEntityId});
-        if (iter == mEntities.end())
-        {
-            break;
-        }
     }
 
     return newEntity;
@@ -87,31 +371,768 @@ Entity ECSDatabase::create_entity() noexcept
 
 
 /*-------------------------------------
- * Spawn an entity with a unique ID
+ * Merge entities created on other threads
+-------------------------------------*/
+void ECSDatabase::sync_entities() noexcept
+{
+    if (mEntityBlocks.empty())
+    {
+        return;
+    }
+
+    for (EntityBlock* pBlock : mEntityBlocks)
+    {
+        _merge_entity_block(*pBlock);
+    }
+
+    // Un-used IDs from the previous set of reservations can now be re-used
+    const std::size_t prevReservedId = mReservedIdBegin;
+    mReservedIdBegin = mNextReservedId.load(std::memory_order_acquire);
+
+    if (mMinEntityId >= prevReservedId)
+    {
+        _update_min_entity_id(prevReservedId);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Register an entity listener
+-------------------------------------*/
+void ECSDatabase::add_entity_listener(EntityListener& listener) noexcept
+{
+    if (std::find(mEntityListeners.begin(), mEntityListeners.end(), &listener) == mEntityListeners.end())
+    {
+        mEntityListeners.push_back(&listener);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Unregister an entity listener
+-------------------------------------*/
+void ECSDatabase::remove_entity_listener(EntityListener& listener) noexcept
+{
+    const std::vector<EntityListener*>::iterator iter = std::find(mEntityListeners.begin(), mEntityListeners.end(), &listener);
+    if (iter != mEntityListeners.end())
+    {
+        mEntityListeners.erase(iter);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Report a destroyed entity
 -------------------------------------*/
-void ECSDatabase::destroy_entity(Entity& e) noexcept
+void ECSDatabase::_notify_destroy(const Entity& e) const noexcept
 {
-    const std::unordered_set<Entity>::iterator&& iter = mEntities.find(e);
-    LS_DEBUG_ASSERT(iter != mEntities.end()); // no double-freeing
-    mEntities.erase(iter);
+    for (EntityListener* pListener : mEntityListeners)
+    {
+        pListener->on_destroy(e);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove an entity and its components
+-------------------------------------*/
+bool ECSDatabase::destroy_entity(Entity& e) noexcept
+{
+    LS_DEBUG_ASSERT(mEntities.contains(e)); // no double-freeing
 
+    // Releasing the ID of an entity which is still within a component would
+    // hand that component's data to the next entity created with it
     for (utils::Pointer<Component>& component : mComponents)
     {
-        if (component->contains(e))
+        if (component && component->contains(e) && component->erase(e) != ComponentRemoveStatus::REMOVE_OK)
         {
-            component->erase(e);
+            return false;
         }
     }
 
-    if (e.id < mMinEntityId)
+    if (!mEntities.erase(e))
+    {
+        return false;
+    }
+
+    mDeadEntities.erase(e);
+    mDormantEntities.erase(e);
+
+    if (entity_index(e) < mMinEntityId)
+    {
+        mMinEntityId = entity_index(e);
+    }
+
+    _retire_entity_id(e);
+
+    const Entity destroyed = e;
+    e.id = (EntityIdType)INVALID_ENTITY;
+    _notify_destroy(destroyed);
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Mark an entity for destruction
+-------------------------------------*/
+bool ECSDatabase::destroy_deferred(Entity& e) noexcept
+{
+    if (!mEntities.contains(e) || mDeadEntities.contains(e))
+    {
+        return false;
+    }
+
+    if (!mDeadEntities.insert(e))
     {
-        mMinEntityId = e.id;
+        // Fall back to immediate destruction rather than leaking the entity
+        return destroy_entity(e);
     }
 
+    mQueries.hide(e);
     e.id = (EntityIdType)INVALID_ENTITY;
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove all entities marked for destruction
+-------------------------------------*/
+void ECSDatabase::destroy_deferred_entities() noexcept
+{
+    if (mDeadEntities.empty())
+    {
+        return;
+    }
+
+    // Sorting keeps each component's sparse lookups moving in one direction
+    std::vector<Entity> deadEntities;
+    deadEntities.reserve(mDeadEntities.size());
+
+    for (std::size_t i = 0; i < mDeadEntities.size(); ++i)
+    {
+        deadEntities.push_back(mDeadEntities[i]);
+    }
+
+    const auto indexLess = [](const Entity& a, const Entity& b) noexcept->bool
+    {
+        return entity_index(a) < entity_index(b);
+    };
+
+    std::sort(deadEntities.begin(), deadEntities.end(), indexLess);
+
+    // Entities which a component could not release keep their IDs and are
+    // retried by the next call
+    std::vector<Entity> failed;
+
+    for (utils::Pointer<Component>& component : mComponents)
+    {
+        if (component)
+        {
+            component->erase(deadEntities, &failed);
+        }
+    }
+
+    std::sort(failed.begin(), failed.end(), indexLess);
+    mDeadEntities.clear();
+    std::size_t numDestroyed = 0;
+
+    for (const Entity& e : deadEntities)
+    {
+        if (std::binary_search(failed.begin(), failed.end(), e, indexLess) || !mEntities.erase(e))
+        {
+            mDeadEntities.insert(e);
+            continue;
+        }
+
+        mDormantEntities.erase(e);
+        _retire_entity_id(e);
+        mMinEntityId = std::min<std::size_t>(mMinEntityId, entity_index(e));
+        deadEntities[numDestroyed++] = e;
+    }
+
+    for (std::size_t i = 0; i < numDestroyed; ++i)
+    {
+        _notify_destroy(deadEntities[i]);
+    }
 }
 
 
+
+/*-------------------------------------
+ * Exclude an entity from updates
+-------------------------------------*/
+bool ECSDatabase::sleep_entity(const Entity& e) noexcept
+{
+    if (!mEntities.contains(e))
+    {
+        return false;
+    }
+
+    if (mDormantEntities.contains(e))
+    {
+        return true;
+    }
+
+    if (!mDormantEntities.insert(e))
+    {
+        return false;
+    }
+
+    for (utils::Pointer<Component>& component : mComponents)
+    {
+        if (component && component->contains(e) && !component->_sleep(e))
+        {
+            wake_entity(e);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Exclude a batch of entities from updates
+-------------------------------------*/
+std::size_t ECSDatabase::sleep_entities(const std::vector<Entity>& entities) noexcept
+{
+    std::size_t numSlept = 0;
+
+    for (const Entity& e : entities)
+    {
+        if (!mDormantEntities.contains(e) && sleep_entity(e))
+        {
+            ++numSlept;
+        }
+    }
+
+    return numSlept;
+}
+
+
+
+/*-------------------------------------
+ * Return an entity to updates
+-------------------------------------*/
+bool ECSDatabase::wake_entity(const Entity& e) noexcept
+{
+    if (!mDormantEntities.contains(e))
+    {
+        return false;
+    }
+
+    for (utils::Pointer<Component>& component : mComponents)
+    {
+        if (component && component->contains(e) && !component->_wake(e))
+        {
+            return false;
+        }
+    }
+
+    return mDormantEntities.erase(e);
+}
+
+
+
+/*-------------------------------------
+ * Return a batch of entities to updates
+-------------------------------------*/
+std::size_t ECSDatabase::wake_entities(const std::vector<Entity>& entities) noexcept
+{
+    std::size_t numWoken = 0;
+
+    for (const Entity& e : entities)
+    {
+        if (wake_entity(e))
+        {
+            ++numWoken;
+        }
+    }
+
+    return numWoken;
+}
+
+
+
+/*-------------------------------------
+ * Return all entities to updates
+-------------------------------------*/
+void ECSDatabase::wake_all_entities() noexcept
+{
+    // Dormant entities already sit behind each awake prefix, so extending the
+    // prefix wakes them without moving any data. The woken entities are not
+    // in sorted order though.
+    for (utils::Pointer<Component>& component : mComponents)
+    {
+        if (component)
+        {
+            component->mNumActive = component->size();
+            component->mOrderDirty = true;
+        }
+    }
+
+    mDormantEntities.clear();
+}
+
+
+/*-------------------------------------
+ * Rename an entity everywhere, or nowhere
+-------------------------------------*/
+bool ECSDatabase::_rename_entity(const Entity& from, const Entity& to) noexcept
+{
+    std::size_t numRenamed = 0;
+
+    while (numRenamed < mComponents.size())
+    {
+        Component* pComponent = mComponents[numRenamed].get();
+        if (pComponent && pComponent->contains(from) && !pComponent->_rename(from, to))
+        {
+            break;
+        }
+
+        ++numRenamed;
+    }
+
+    bool ret = numRenamed == mComponents.size() && mEntities.rename(from, to);
+
+    if (ret && mDormantEntities.contains(from) && !mDormantEntities.rename(from, to))
+    {
+        mEntities.rename(to, from);
+        ret = false;
+    }
+
+    // Renaming back only writes pages which were just duplicated, so it
+    // can't fail
+    if (!ret)
+    {
+        for (std::size_t i = 0; i < numRenamed; ++i)
+        {
+            Component* pComponent = mComponents[i].get();
+            if (pComponent && pComponent->contains(to))
+            {
+                pComponent->_rename(to, from);
+            }
+        }
+    }
+
+    return ret;
+}
+
+
+
+/*-------------------------------------
+ * Move high entity IDs into free low IDs
+-------------------------------------*/
+bool ECSDatabase::_compact_renumber(std::size_t& budget) noexcept
+{
+    CompactState& state = mCompaction;
+    bool renamed = false;
+    bool ok = true;
+
+    if (state.cursor == (std::size_t)INVALID_ENTITY)
+    {
+        state.cursor = mEntities.sparse().size();
+    }
+
+    while (budget && state.cursor > mMinEntityId)
+    {
+        --budget;
+
+        if (!mEntities.contains_index(--state.cursor))
+        {
+            continue;
+        }
+
+        const Entity from = mEntities[mEntities.index_of(Entity{(EntityIdType)state.cursor})];
+        if (mDeadEntities.contains(from))
+        {
+            continue;
+        }
+
+        const Entity to = _make_entity(mMinEntityId);
+
+        if (!_rename_entity(from, to))
+        {
+            // Resume with the same entity on the next call
+            ++state.cursor;
+            ok = false;
+            break;
+        }
+
+        mCompactRemap.push_back(EntityRemap{from, to});
+        _retire_entity_id(from);
+        _update_min_entity_id(entity_index(to));
+        renamed = true;
+
+        for (EntityListener* pListener : mEntityListeners)
+        {
+            pListener->on_rename(from, to);
+        }
+    }
+
+    // Listeners were already told about every rename, even if a later one
+    // failed
+    if (renamed)
+    {
+        mQueries.invalidate();
+    }
+
+    if (ok && state.cursor <= mMinEntityId)
+    {
+        state.phase = CompactPhase::COMPACT_SORT;
+        state.cursor = 0;
+    }
+
+    return ok;
+}
+
+
+
+/*-------------------------------------
+ * Order each component by entity ID
+-------------------------------------*/
+bool ECSDatabase::_compact_sort(std::size_t& budget) noexcept
+{
+    CompactState& state = mCompaction;
+
+    while (budget && state.cursor < mComponents.size())
+    {
+        Component* pComponent = mComponents[state.cursor].get();
+
+        if (pComponent && state.row == 0 && state.order.empty())
+        {
+            const EntitySet& entities = pComponent->entities();
+            state.order.reserve(entities.size());
+
+            for (std::size_t i = 0; i < entities.size(); ++i)
+            {
+                state.order.push_back(entities[i]);
+            }
+
+            const auto compareIds = [](const Entity& a, const Entity& b) noexcept->bool
+            {
+                return entity_index(a) < entity_index(b);
+            };
+
+            // Awake and dormant entities are sorted within their own ranges
+            const std::vector<Entity>::iterator dormantBegin = state.order.begin() + pComponent->num_active();
+            std::sort(state.order.begin(), dormantBegin, compareIds);
+            std::sort(dormantBegin, state.order.end(), compareIds);
+        }
+
+        if (!pComponent || state.row >= state.order.size())
+        {
+            ++state.cursor;
+            state.row = 0;
+            state.placed = 0;
+            state.order.clear();
+            continue;
+        }
+
+        --budget;
+
+        // Entities may have been added or removed since the order was built
+        const Entity e = state.order[state.row++];
+        if (!pComponent->contains(e) || state.placed >= pComponent->size())
+        {
+            continue;
+        }
+
+        const std::size_t index = pComponent->entities().index_of(e);
+        const std::size_t numActive = pComponent->num_active();
+
+        // Awake entities which were skipped leave the rest of the awake
+        // prefix unsorted
+        if (index >= numActive && state.placed < numActive)
+        {
+            state.placed = numActive;
+        }
+
+        // The entity woke since the order was built
+        if (index < numActive && state.placed >= numActive)
+        {
+            continue;
+        }
+
+        if (index != state.placed && !pComponent->_swap(state.placed, index))
+        {
+            // Retry the same entity on the next call
+            --state.row;
+            return false;
+        }
+
+        ++state.placed;
+    }
+
+    if (state.cursor >= mComponents.size())
+    {
+        state.phase = CompactPhase::COMPACT_SHRINK;
+        state.order.shrink_to_fit();
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Incremental defragmentation
+-------------------------------------*/
+ECSCompactStatus ECSDatabase::compact(std::size_t maxEntities) noexcept
+{
+    if (!mEntityBlocks.empty())
+    {
+        return ECSCompactStatus::COMPACT_ERR_ENTITY_BLOCKS;
+    }
+
+    std::size_t budget = maxEntities;
+
+    if (mCompaction.phase == CompactPhase::COMPACT_RENUMBER && !_compact_renumber(budget))
+    {
+        return ECSCompactStatus::COMPACT_ERR_NO_MEMORY;
+    }
+
+    if (mCompaction.phase == CompactPhase::COMPACT_SORT && !_compact_sort(budget))
+    {
+        return ECSCompactStatus::COMPACT_ERR_NO_MEMORY;
+    }
+
+    if (mCompaction.phase != CompactPhase::COMPACT_SHRINK)
+    {
+        return ECSCompactStatus::COMPACT_IN_PROGRESS;
+    }
+
+    mEntities.shrink_to_fit();
+    mDeadEntities.shrink_to_fit();
+    mDormantEntities.shrink_to_fit();
+
+    for (utils::Pointer<Component>& component : mComponents)
+    {
+        if (component)
+        {
+            component->shrink_to_fit();
+        }
+    }
+
+    mCompaction = CompactState{};
+
+    return ECSCompactStatus::COMPACT_DONE;
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+ECSMemoryStats ECSDatabase::memory_stats() const noexcept
+{
+    ECSMemoryStats stats;
+
+    stats.entities = mEntities.memory_stats();
+    stats.entities += mDeadEntities.memory_stats();
+    stats.entities += mDormantEntities.memory_stats();
+    stats.entityLoadFactor = mEntities.load_factor();
+
+    stats.components = MemoryStats{0, 0, 0};
+    stats.queries = mQueries.memory_stats();
+
+    stats.overhead = MemoryStats{0, 0, 0};
+    stats.overhead.usedBytes += mComponents.size() * sizeof(utils::Pointer<Component>);
+    stats.overhead.reservedBytes += mComponents.capacity() * sizeof(utils::Pointer<Component>);
+    stats.overhead.usedBytes += mCloneFuncs.size() * sizeof(ComponentCloneFunc);
+    stats.overhead.reservedBytes += mCloneFuncs.capacity() * sizeof(ComponentCloneFunc);
+    stats.overhead.usedBytes += mSnapshots.size() * sizeof(utils::Pointer<ComponentSnapshotBase>);
+    stats.overhead.reservedBytes += mSnapshots.capacity() * sizeof(utils::Pointer<ComponentSnapshotBase>);
+    stats.overhead.usedBytes += mEntityBlocks.size() * sizeof(EntityBlock*);
+    stats.overhead.reservedBytes += mEntityBlocks.capacity() * sizeof(EntityBlock*);
+
+    for (std::size_t i = 0; i < mComponents.size(); ++i)
+    {
+        const Component* pComponent = mComponents[i].get();
+        if (!pComponent)
+        {
+            continue;
+        }
+
+        ComponentMemoryStats componentStats;
+        componentStats.componentId = i;
+        componentStats.numEntities = pComponent->size();
+        componentStats.loadFactor = pComponent->entities().load_factor();
+        componentStats.storage = pComponent->memory_stats();
+
+        stats.components += componentStats.storage;
+        stats.componentStats.push_back(componentStats);
+    }
+
+    return stats;
+}
+
+
+
+/*-------------------------------------
+ * Component update timing
+-------------------------------------*/
+bool ECSDatabase::update_timing(std::size_t componentId, ComponentTiming& outTiming) noexcept
+{
+  #ifdef LS_GAME_ENABLE_PROFILING
+    return mProfiler.timing(componentId, outTiming);
+  #else
+    (void)componentId;
+    (void)outTiming;
+    return false;
+  #endif
+}
+
+
+
+/*-------------------------------------
+ * Timing of all updated components
+-------------------------------------*/
+std::vector<ComponentTiming> ECSDatabase::update_timings() noexcept
+{
+    std::vector<ComponentTiming> timings;
+    ComponentTiming timing;
+
+    for (std::size_t i = 0; i < mComponents.size(); ++i)
+    {
+        if (mComponents[i] && update_timing(i, timing))
+        {
+            timings.push_back(timing);
+        }
+    }
+
+    return timings;
+}
+
+
+
+/*-------------------------------------
+ * Sort and validate query parameters
+-------------------------------------*/
+bool ECSDatabase::_prepare_query(std::vector<std::size_t>& required, std::vector<std::size_t>& excluded) const noexcept
+{
+    std::sort(required.begin(), required.end());
+    std::sort(excluded.begin(), excluded.end());
+
+    for (std::size_t componentId : required)
+    {
+        if (componentId >= mComponents.size() || !mComponents[componentId])
+        {
+            return false;
+        }
+    }
+
+    for (std::size_t componentId : excluded)
+    {
+        if (componentId >= mComponents.size() || !mComponents[componentId])
+        {
+            return false;
+        }
+    }
+
+    return !required.empty();
+}
+
+
+
+/*-------------------------------------
+ * Cached multi-component query
+-------------------------------------*/
+const EntitySet* ECSDatabase::query(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept
+{
+    if (!_prepare_query(required, excluded))
+    {
+        return nullptr;
+    }
+
+    return mQueries.find(required, excluded, mComponents);
+}
+
+
+
+/*-------------------------------------
+ * Track query changes
+-------------------------------------*/
+bool ECSDatabase::track_query(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept
+{
+    if (!_prepare_query(required, excluded))
+    {
+        return false;
+    }
+
+    return mQueries.track(required, excluded, mComponents);
+}
+
+
+
+/*-------------------------------------
+ * Stop tracking query changes
+-------------------------------------*/
+void ECSDatabase::untrack_query(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept
+{
+    if (_prepare_query(required, excluded))
+    {
+        mQueries.untrack(required, excluded);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Entities which began matching a query
+-------------------------------------*/
+const EntitySet* ECSDatabase::query_entered(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept
+{
+    if (!_prepare_query(required, excluded))
+    {
+        return nullptr;
+    }
+
+    return mQueries.entered(required, excluded);
+}
+
+
+
+/*-------------------------------------
+ * Entities which stopped matching a query
+-------------------------------------*/
+const EntitySet* ECSDatabase::query_left(std::vector<std::size_t> required, std::vector<std::size_t> excluded) noexcept
+{
+    if (!_prepare_query(required, excluded))
+    {
+        return nullptr;
+    }
+
+    return mQueries.left(required, excluded);
+}
+
+
+
+/*-------------------------------------
+ * Publish component snapshots
+-------------------------------------*/
+void ECSDatabase::publish_snapshots() noexcept
+{
+    for (std::size_t i = 0; i < mSnapshots.size(); ++i)
+    {
+        if (mSnapshots[i] && mComponents[i])
+        {
+            mSnapshots[i]->publish(*mComponents[i]);
+        }
+    }
+}
+
+
+
 /*-------------------------------------
  * Get the number of components for an entity
 -------------------------------------*/
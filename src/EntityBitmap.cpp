@@ -0,0 +1,300 @@
+
+#include <algorithm> // std::min
+
+#include "lightsky/game/EntityBitmap.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-------------------------------------
+ * Number of set bits
+-------------------------------------*/
+inline std::size_t EntityBitmap::_count_bits(uint64_t word) noexcept
+{
+  #if defined(__GNUC__) || defined(__clang__)
+    return (std::size_t)__builtin_popcountll(word);
+  #else
+    std::size_t numBits = 0;
+    for (; word; word &= word - 1ull)
+    {
+        ++numBits;
+    }
+    return numBits;
+  #endif
+}
+
+
+
+/*-------------------------------------
+ * Add an index
+-------------------------------------*/
+bool EntityBitmap::insert(std::size_t index) noexcept
+{
+    const std::size_t w = index / BITS_PER_WORD;
+
+    if (w >= mWords.size() && !mWords.resize(w + 1))
+    {
+        return false;
+    }
+
+    uint64_t* pWord = mWords.writable(w);
+    if (!pWord)
+    {
+        return false;
+    }
+
+    *pWord |= 1ull << (index % BITS_PER_WORD);
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove an index
+-------------------------------------*/
+bool EntityBitmap::erase(std::size_t index) noexcept
+{
+    if (!contains(index))
+    {
+        return true;
+    }
+
+    uint64_t* pWord = mWords.writable(index / BITS_PER_WORD);
+    if (!pWord)
+    {
+        return false;
+    }
+
+    *pWord &= ~(1ull << (index % BITS_PER_WORD));
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Rebuild from a set of entities
+-------------------------------------*/
+bool EntityBitmap::assign(const EntitySet& entities) noexcept
+{
+    mWords.clear();
+
+    if (!mWords.resize((entities.sparse().size() + BITS_PER_WORD - 1) / BITS_PER_WORD))
+    {
+        return false;
+    }
+
+    for (std::size_t i = 0; i < entities.size(); ++i)
+    {
+        if (!insert(entity_index(entities[i])))
+        {
+            mWords.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Set intersection
+-------------------------------------*/
+bool EntityBitmap::intersect(const EntityBitmap& b) noexcept
+{
+    if (b.mWords.size() < mWords.size() && !mWords.resize(b.mWords.size()))
+    {
+        return false;
+    }
+
+    for (std::size_t p = 0; p < mWords.num_pages(); ++p)
+    {
+        if (!mWords.page(p))
+        {
+            continue;
+        }
+
+        const uint64_t* pSrc = b.mWords.page(p);
+        if (!pSrc)
+        {
+            mWords.release_page(p);
+            continue;
+        }
+
+        uint64_t* pDst = mWords.writable_page(p);
+        if (!pDst)
+        {
+            return false;
+        }
+
+        uint64_t anyBits = 0;
+        for (std::size_t w = 0; w < WORDS_PER_PAGE; ++w)
+        {
+            pDst[w] &= pSrc[w];
+            anyBits |= pDst[w];
+        }
+
+        if (!anyBits)
+        {
+            mWords.release_page(p);
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Set union
+-------------------------------------*/
+bool EntityBitmap::unite(const EntityBitmap& b) noexcept
+{
+    if (b.mWords.size() > mWords.size() && !mWords.resize(b.mWords.size()))
+    {
+        return false;
+    }
+
+    for (std::size_t p = 0; p < b.mWords.num_pages(); ++p)
+    {
+        const uint64_t* pSrc = b.mWords.page(p);
+        if (!pSrc)
+        {
+            continue;
+        }
+
+        uint64_t* pDst = mWords.writable_page(p);
+        if (!pDst)
+        {
+            return false;
+        }
+
+        for (std::size_t w = 0; w < WORDS_PER_PAGE; ++w)
+        {
+            pDst[w] |= pSrc[w];
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Set difference
+-------------------------------------*/
+bool EntityBitmap::subtract(const EntityBitmap& b) noexcept
+{
+    const std::size_t numPages = std::min(mWords.num_pages(), b.mWords.num_pages());
+
+    for (std::size_t p = 0; p < numPages; ++p)
+    {
+        const uint64_t* pSrc = b.mWords.page(p);
+        if (!pSrc || !mWords.page(p))
+        {
+            continue;
+        }
+
+        uint64_t* pDst = mWords.writable_page(p);
+        if (!pDst)
+        {
+            return false;
+        }
+
+        uint64_t anyBits = 0;
+        for (std::size_t w = 0; w < WORDS_PER_PAGE; ++w)
+        {
+            pDst[w] &= ~pSrc[w];
+            anyBits |= pDst[w];
+        }
+
+        if (!anyBits)
+        {
+            mWords.release_page(p);
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Count all indices
+-------------------------------------*/
+std::size_t EntityBitmap::count() const noexcept
+{
+    std::size_t numBits = 0;
+
+    for (std::size_t p = 0; p < mWords.num_pages(); ++p)
+    {
+        const uint64_t* pWords = mWords.page(p);
+        if (!pWords)
+        {
+            continue;
+        }
+
+        for (std::size_t w = 0; w < WORDS_PER_PAGE; ++w)
+        {
+            numBits += _count_bits(pWords[w]);
+        }
+    }
+
+    return numBits;
+}
+
+
+
+/*-------------------------------------
+ * Check for any indices
+-------------------------------------*/
+bool EntityBitmap::empty() const noexcept
+{
+    for (std::size_t p = 0; p < mWords.num_pages(); ++p)
+    {
+        const uint64_t* pWords = mWords.page(p);
+        if (!pWords)
+        {
+            continue;
+        }
+
+        for (std::size_t w = 0; w < WORDS_PER_PAGE; ++w)
+        {
+            if (pWords[w])
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove all indices
+-------------------------------------*/
+void EntityBitmap::clear() noexcept
+{
+    mWords.clear();
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+MemoryStats EntityBitmap::memory_stats() const noexcept
+{
+    return mWords.memory_stats();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
@@ -0,0 +1,64 @@
+
+#include "lightsky/game/ECSDatabase.hpp"
+#include "lightsky/game/EntityBlock.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+EntityBlock::~EntityBlock() noexcept
+{
+    if (mDb)
+    {
+        mDb->_unregister_entity_block(*this);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+EntityBlock::EntityBlock(ECSDatabase& db, std::size_t blockSize) noexcept :
+    mDb{&db},
+    mBlockSize{blockSize ? blockSize : 1},
+    mNextId{0},
+    mEndId{0},
+    mPending{}
+{
+    db._register_entity_block(*this);
+}
+
+
+
+/*-------------------------------------
+ * Spawn an entity from the reserved range
+-------------------------------------*/
+Entity EntityBlock::create_entity() noexcept
+{
+    if (mNextId == mEndId)
+    {
+        if (!mDb || !mDb->_reserve_entity_ids(mBlockSize, mNextId))
+        {
+            return Entity{(EntityIdType)ECSDatabase::INVALID_ENTITY};
+        }
+
+        mEndId = mNextId + mBlockSize;
+    }
+
+    const Entity e{mNextId++};
+    mPending.push_back(e);
+
+    return e;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
@@ -0,0 +1,184 @@
+
+#include "lightsky/game/EntitySet.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-------------------------------------
+ * Add an entity
+-------------------------------------*/
+bool EntitySet::insert(const Entity& e) noexcept
+{
+    const EntityIdType index = entity_index(e);
+
+    if (e.id == ~(EntityIdType)0 || contains_index(index))
+    {
+        return false;
+    }
+
+    if (index >= mSparse.size() && !mSparse.resize((std::size_t)index + 1))
+    {
+        return false;
+    }
+
+    if (!mDense.push_back(e))
+    {
+        return false;
+    }
+
+    if (!mSparse.set(index, (EntityIdType)mDense.size()))
+    {
+        mDense.pop_back();
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove an entity
+-------------------------------------*/
+bool EntitySet::erase(const Entity& e) noexcept
+{
+    if (!contains(e))
+    {
+        return false;
+    }
+
+    if (!reserve_erase(e))
+    {
+        return false;
+    }
+
+    const std::size_t index = index_of(e);
+    const Entity last = mDense[mDense.size() - 1];
+
+    mDense.set(index, last);
+    mSparse.set(entity_index(last), (EntityIdType)index + 1);
+    mDense.pop_back();
+    mSparse.set(entity_index(e), 0);
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Prepare for a removal
+-------------------------------------*/
+bool EntitySet::reserve_erase(const Entity& e) noexcept
+{
+    if (!contains(e))
+    {
+        return false;
+    }
+
+    const Entity last = mDense[mDense.size() - 1];
+
+    return mDense.writable(index_of(e))
+        && mSparse.writable(entity_index(last))
+        && mSparse.writable(entity_index(e));
+}
+
+
+
+/*-------------------------------------
+ * Swap packed positions
+-------------------------------------*/
+bool EntitySet::swap(std::size_t indexA, std::size_t indexB) noexcept
+{
+    if (indexA == indexB)
+    {
+        return true;
+    }
+
+    const Entity a = mDense[indexA];
+    const Entity b = mDense[indexB];
+
+    if (!mDense.writable(indexA) || !mDense.writable(indexB) || !mSparse.writable(entity_index(a)) || !mSparse.writable(entity_index(b)))
+    {
+        return false;
+    }
+
+    mDense.set(indexA, b);
+    mDense.set(indexB, a);
+    mSparse.set(entity_index(b), (EntityIdType)indexA + 1);
+    mSparse.set(entity_index(a), (EntityIdType)indexB + 1);
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Change an entity's ID
+-------------------------------------*/
+bool EntitySet::rename(const Entity& from, const Entity& to) noexcept
+{
+    const EntityIdType toIndex = entity_index(to);
+
+    if (!contains(from) || to.id == ~(EntityIdType)0 || contains_index(toIndex))
+    {
+        return false;
+    }
+
+    if (toIndex >= mSparse.size() && !mSparse.resize((std::size_t)toIndex + 1))
+    {
+        return false;
+    }
+
+    const std::size_t index = index_of(from);
+
+    // Un-share every page written below so the rename can't fail halfway
+    if (!mSparse.writable(toIndex) || !mSparse.writable(entity_index(from)) || !mDense.writable(index))
+    {
+        return false;
+    }
+
+    mSparse.set(toIndex, (EntityIdType)index + 1);
+    mDense.set(index, to);
+    mSparse.set(entity_index(from), 0);
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Release unused memory
+-------------------------------------*/
+void EntitySet::shrink_to_fit() noexcept
+{
+    std::size_t numIds = mSparse.size();
+
+    while (numIds && mSparse[numIds-1] == 0)
+    {
+        --numIds;
+    }
+
+    mSparse.resize(numIds);
+    mSparse.shrink_to_fit();
+    mDense.shrink_to_fit();
+}
+
+
+
+/*-------------------------------------
+ * Remove all entities
+-------------------------------------*/
+void EntitySet::clear() noexcept
+{
+    mDense.clear();
+    mSparse.clear();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
@@ -101,6 +101,11 @@ void GameSystem::update_game_states()
         LS_LOG_ERR("No game states are available!");
     }
 
+    #ifdef LS_GAME_ENABLE_PROFILING
+        // Gather the previous frame's trace zones from all threads
+        Tracer::global().collect();
+    #endif
+
     for (std::size_t i = 0; i < gameList.size(); ++i)
     {
         GameState* const pState = gameList[i];
@@ -108,8 +113,11 @@ void GameSystem::update_game_states()
         switch (pState->get_state())
         {
             case game_state_status_t::RUNNING:
+            {
+                LS_GAME_TRACE_SCOPE("GameState::on_run", i);
                 pState->on_run();
                 break;
+            }
             case game_state_status_t::PAUSED:
                 pState->on_pause();
                 break;
@@ -0,0 +1,161 @@
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define LS_GAME_MOTION_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define LS_GAME_MOTION_NEON
+#endif
+
+#include "lightsky/game/MotionComponent.hpp"
+
+LS_GAME_REGISTER_COMPONENT(ls::game::MotionComponent)
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Anonymous helper functions
+-----------------------------------------------------------------------------*/
+namespace
+{
+
+
+
+/*-------------------------------------
+ * Integrate one axis of a chunk
+ *
+ * Both arrays are chunk-aligned and padded to the full chunk size, so
+ * callers may round the row count up to a whole vector when no dormant rows
+ * follow the awake ones.
+-------------------------------------*/
+inline void integrate_axis(float* pPos, const float* pVel, float dt, std::size_t numRows) noexcept
+{
+    std::size_t i = 0;
+
+    #if defined(LS_GAME_MOTION_SSE)
+        const __m128 step = _mm_set1_ps(dt);
+        for (; i + 4 <= numRows; i += 4)
+        {
+            const __m128 p = _mm_load_ps(pPos+i);
+            const __m128 v = _mm_load_ps(pVel+i);
+            _mm_store_ps(pPos+i, _mm_add_ps(p, _mm_mul_ps(v, step)));
+        }
+
+    #elif defined(LS_GAME_MOTION_NEON)
+        for (; i + 4 <= numRows; i += 4)
+        {
+            const float32x4_t p = vld1q_f32(pPos+i);
+            const float32x4_t v = vld1q_f32(pVel+i);
+            vst1q_f32(pPos+i, vmlaq_n_f32(p, v, dt));
+        }
+    #endif
+
+    for (; i < numRows; ++i)
+    {
+        pPos[i] += pVel[i] * dt;
+    }
+}
+
+
+
+} // end anonymous namespace
+
+
+
+/*-----------------------------------------------------------------------------
+ * Motion Component Member Functions
+-----------------------------------------------------------------------------*/
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+MotionComponent::MotionComponent() noexcept :
+    ColumnComponent{},
+    mTimeStep{0.f}
+{}
+
+
+
+/*-------------------------------------
+ * Set an entity's position
+-------------------------------------*/
+bool MotionComponent::position(const Entity& e, const math::vec3& p) noexcept
+{
+    return set<POSITION_X>(e, p[0]) && set<POSITION_Y>(e, p[1]) && set<POSITION_Z>(e, p[2]);
+}
+
+
+
+/*-------------------------------------
+ * Set an entity's velocity
+-------------------------------------*/
+bool MotionComponent::velocity(const Entity& e, const math::vec3& v) noexcept
+{
+    return set<VELOCITY_X>(e, v[0]) && set<VELOCITY_Y>(e, v[1]) && set<VELOCITY_Z>(e, v[2]);
+}
+
+
+
+/*-------------------------------------
+ * Integrate all entities
+-------------------------------------*/
+bool MotionComponent::integrate(float seconds) noexcept
+{
+    static_assert(CHUNK_SIZE % 4 == 0, "Chunks must hold a whole number of 4-wide vectors.");
+    static_assert(CHUNK_ALIGNMENT % 16 == 0, "Chunks must be aligned to 16 bytes.");
+
+    for (std::size_t c = 0; c < num_active_chunks(); ++c)
+    {
+        float* const pX = writable_column<POSITION_X>(c);
+        float* const pY = writable_column<POSITION_Y>(c);
+        float* const pZ = writable_column<POSITION_Z>(c);
+
+        if (!pX || !pY || !pZ)
+        {
+            return false;
+        }
+
+        // Dormant rows sharing the chunk must not be touched
+        const std::size_t numActiveRows = active_chunk_size(c);
+        const std::size_t numRows = (numActiveRows < chunk_size(c)) ? numActiveRows : ((numActiveRows + 3u) & ~(std::size_t)3u);
+
+        integrate_axis(pX, column<VELOCITY_X>(c), seconds, numRows);
+        integrate_axis(pY, column<VELOCITY_Y>(c), seconds, numRows);
+        integrate_axis(pZ, column<VELOCITY_Z>(c), seconds, numRows);
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Integrate a single entity
+-------------------------------------*/
+void MotionComponent::update_entity(const Entity& e) noexcept
+{
+    const math::vec3 p = position(e);
+    const math::vec3 v = velocity(e);
+
+    position(e, math::vec3{p[0] + v[0]*mTimeStep, p[1] + v[1]*mTimeStep, p[2] + v[2]*mTimeStep});
+}
+
+
+
+/*-------------------------------------
+ * Update
+-------------------------------------*/
+void MotionComponent::update() noexcept
+{
+    LS_GAME_PROFILE_UPDATE(*this);
+    integrate(mTimeStep);
+}
+
+
+
+} // end game namespace
+} // end ls namespace
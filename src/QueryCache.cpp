@@ -0,0 +1,987 @@
+
+#include <algorithm> // std::binary_search, std::find, std::max, std::min
+#include <new> // std::nothrow
+#include <utility> // std::move
+
+#include "lightsky/utils/Assertions.h"
+
+#include "lightsky/game/QueryCache.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-------------------------------------
+ * Check if an entity belongs in a query
+-------------------------------------*/
+bool QueryCache::_matches(const CachedQuery& q, const Entity& e) const noexcept
+{
+    if (mHidden && mHidden->contains(e))
+    {
+        return false;
+    }
+
+    for (const Component* c : q.requiredComponents)
+    {
+        if (!c->contains(e))
+        {
+            return false;
+        }
+    }
+
+    for (const Component* c : q.excludedComponents)
+    {
+        if (c->contains(e))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Determine how a query references a component
+-------------------------------------*/
+inline bool QueryCache::_is_required(const CachedQuery& q, std::size_t componentId) noexcept
+{
+    return std::binary_search(q.required.begin(), q.required.end(), componentId);
+}
+
+
+
+/*-------------------------------------
+ * Memory used by a query (upper bound)
+-------------------------------------*/
+std::size_t QueryCache::_query_bytes(const CachedQuery& q) noexcept
+{
+    std::size_t numBytes = sizeof(CachedQuery);
+
+    for (const EntitySet* pSet : {&q.entities, &q.entered, &q.left})
+    {
+        numBytes += pSet->dense().capacity() * sizeof(Entity);
+        numBytes += pSet->sparse().capacity() * sizeof(EntityIdType);
+    }
+
+    return numBytes;
+}
+
+
+
+/*-------------------------------------
+ * Update the memory usage of a query
+-------------------------------------*/
+inline void QueryCache::_update_bytes(CachedQuery& q) noexcept
+{
+    const std::size_t numBytes = _query_bytes(q);
+    mMemoryUsage = mMemoryUsage - q.numBytes + numBytes;
+    q.numBytes = numBytes;
+}
+
+
+
+/*-------------------------------------
+ * Remove a query from the usage list
+-------------------------------------*/
+void QueryCache::_unlink(CachedQuery& q) noexcept
+{
+    (q.pPrevUsed ? q.pPrevUsed->pNextUsed : mLeastUsed) = q.pNextUsed;
+    (q.pNextUsed ? q.pNextUsed->pPrevUsed : mMostUsed) = q.pPrevUsed;
+    q.pPrevUsed = nullptr;
+    q.pNextUsed = nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Mark a query as the most recently used
+-------------------------------------*/
+void QueryCache::_touch(CachedQuery& q) noexcept
+{
+    if (mMostUsed == &q)
+    {
+        return;
+    }
+
+    // New queries are not yet linked
+    if (q.pNextUsed)
+    {
+        _unlink(q);
+    }
+
+    q.pPrevUsed = mMostUsed;
+    (mMostUsed ? mMostUsed->pNextUsed : mLeastUsed) = &q;
+    mMostUsed = &q;
+}
+
+
+
+/*-------------------------------------
+ * Add an entity to a query's results
+-------------------------------------*/
+void QueryCache::_add_entity(CachedQuery& q, const Entity& e) noexcept
+{
+    if (q.entities.insert(e) && q.tracked && !q.left.erase(e))
+    {
+        q.entered.insert(e);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove an entity from a query's results
+-------------------------------------*/
+void QueryCache::_remove_entity(CachedQuery& q, const Entity& e) noexcept
+{
+    if (q.entities.erase(e) && q.tracked && !q.entered.erase(e))
+    {
+        q.left.insert(e);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Rebuild a query from component bitmaps
+-------------------------------------*/
+bool QueryCache::_intersect_bitmaps(CachedQuery& q) noexcept
+{
+    const std::size_t numComponents = q.required.size() + q.excluded.size();
+    if (!mBitmapThreshold || numComponents < mBitmapThreshold)
+    {
+        return false;
+    }
+
+    // Bitmaps span every entity index, so they only pay off when there are
+    // more candidate entities than bitmap words to combine.
+    std::size_t numCandidates = q.requiredComponents[0]->size();
+    std::size_t numIndices = 0;
+
+    for (const Component* c : q.requiredComponents)
+    {
+        numCandidates = std::min(numCandidates, c->size());
+        numIndices = std::max(numIndices, c->entities().sparse().size());
+    }
+
+    if (numCandidates < numIndices / EntityBitmap::BITS_PER_WORD)
+    {
+        return false;
+    }
+
+    const std::size_t maxId = std::max(q.required.back(), q.excluded.empty() ? 0 : q.excluded.back());
+    if (mBitmaps.size() <= maxId)
+    {
+        mBitmaps.resize(maxId+1);
+    }
+
+    for (std::size_t i = 0; i < numComponents; ++i)
+    {
+        const bool isRequired = i < q.required.size();
+        const std::size_t componentId = isRequired ? q.required[i] : q.excluded[i - q.required.size()];
+        const Component* c = isRequired ? q.requiredComponents[i] : q.excludedComponents[i - q.required.size()];
+        ComponentBitmap& bitmap = mBitmaps[componentId];
+
+        if (bitmap.dirty)
+        {
+            if (!bitmap.members.assign(c->entities()))
+            {
+                return false;
+            }
+
+            bitmap.dirty = false;
+        }
+    }
+
+    // Shares pages with the first bitmap until they're modified
+    EntityBitmap matches = mBitmaps[q.required[0]].members;
+
+    for (std::size_t i = 1; i < q.required.size(); ++i)
+    {
+        if (!matches.intersect(mBitmaps[q.required[i]].members))
+        {
+            return false;
+        }
+    }
+
+    for (std::size_t componentId : q.excluded)
+    {
+        if (!matches.subtract(mBitmaps[componentId].members))
+        {
+            return false;
+        }
+    }
+
+    // Bitmaps only hold entity indices. Handles, including generation bits,
+    // are recovered from a required component.
+    const EntitySet& owners = q.requiredComponents[0]->entities();
+
+    matches.for_each([&](std::size_t index)->void
+    {
+        const Entity& e = owners[owners.sparse()[index] - 1];
+        if (!mHidden || !mHidden->contains(e))
+        {
+            q.entities.insert(e);
+        }
+    });
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Recompute a query from scratch
+-------------------------------------*/
+void QueryCache::_rebuild(CachedQuery& q) noexcept
+{
+    // Shares pages with the current results, used to find changes.
+    EntitySet prev;
+    if (q.tracked)
+    {
+        prev = q.entities;
+    }
+
+    q.entities.clear();
+
+    if (!_intersect_bitmaps(q))
+    {
+        // Only the smallest component needs to be scanned
+        const Component* pSmallest = q.requiredComponents[0];
+        for (const Component* c : q.requiredComponents)
+        {
+            if (c->size() < pSmallest->size())
+            {
+                pSmallest = c;
+            }
+        }
+
+        const EntitySet& candidates = pSmallest->entities();
+        for (std::size_t i = 0; i < candidates.size(); ++i)
+        {
+            const Entity& e = candidates[i];
+            if (_matches(q, e))
+            {
+                q.entities.insert(e);
+            }
+        }
+    }
+
+    q.dirty = false;
+
+    if (!q.tracked)
+    {
+        _update_bytes(q);
+        return;
+    }
+
+    for (std::size_t i = 0; i < prev.size(); ++i)
+    {
+        const Entity& e = prev[i];
+        if (!q.entities.contains(e) && !q.entered.erase(e))
+        {
+            q.left.insert(e);
+        }
+    }
+
+    for (std::size_t i = 0; i < q.entities.size(); ++i)
+    {
+        const Entity& e = q.entities[i];
+        if (!prev.contains(e) && !q.left.erase(e))
+        {
+            q.entered.insert(e);
+        }
+    }
+
+    _update_bytes(q);
+}
+
+
+
+/*-------------------------------------
+ * Find an existing query
+-------------------------------------*/
+QueryCache::CachedQuery* QueryCache::_lookup(
+    const std::vector<std::size_t>& required,
+    const std::vector<std::size_t>& excluded) const noexcept
+{
+    if (required.empty() || required[0] >= mComponentQueries.size())
+    {
+        return nullptr;
+    }
+
+    for (CachedQuery* q : mComponentQueries[required[0]])
+    {
+        if (q->required == required && q->excluded == excluded)
+        {
+            return q;
+        }
+    }
+
+    return nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Add a new query
+-------------------------------------*/
+QueryCache::CachedQuery* QueryCache::_create(
+    const std::vector<std::size_t>& required,
+    const std::vector<std::size_t>& excluded,
+    const std::vector<utils::Pointer<Component>>& components) noexcept
+{
+    utils::Pointer<CachedQuery> query{new(std::nothrow) CachedQuery{}};
+    if (!query)
+    {
+        return nullptr;
+    }
+
+    query->required = required;
+    query->excluded = excluded;
+    query->dirty = true;
+    query->tracked = false;
+
+    for (std::size_t componentId : required)
+    {
+        LS_DEBUG_ASSERT(componentId < components.size() && components[componentId]);
+        query->requiredComponents.push_back(components[componentId].get());
+    }
+
+    for (std::size_t componentId : excluded)
+    {
+        LS_DEBUG_ASSERT(componentId < components.size() && components[componentId]);
+        query->excludedComponents.push_back(components[componentId].get());
+    }
+
+    const std::size_t maxId = std::max(required.back(), excluded.empty() ? 0 : excluded.back());
+    if (mComponentQueries.size() <= maxId)
+    {
+        mComponentQueries.resize(maxId+1);
+    }
+
+    CachedQuery* pQuery = query.get();
+
+    for (std::size_t componentId : required)
+    {
+        mComponentQueries[componentId].push_back(pQuery);
+    }
+
+    for (std::size_t componentId : excluded)
+    {
+        mComponentQueries[componentId].push_back(pQuery);
+    }
+
+    pQuery->cacheIndex = mQueries.size();
+    mQueries.push_back(std::move(query));
+    _touch(*pQuery);
+    _update_bytes(*pQuery);
+
+    return pQuery;
+}
+
+
+
+/*-------------------------------------
+ * Remove a query
+-------------------------------------*/
+void QueryCache::_evict(CachedQuery& q) noexcept
+{
+    CachedQuery* pQuery = &q;
+    const std::size_t queryIndex = q.cacheIndex;
+
+    _unlink(q);
+    mMemoryUsage -= q.numBytes;
+
+    for (std::size_t componentId : pQuery->required)
+    {
+        std::vector<CachedQuery*>& queries = mComponentQueries[componentId];
+        queries.erase(std::find(queries.begin(), queries.end(), pQuery));
+    }
+
+    for (std::size_t componentId : pQuery->excluded)
+    {
+        std::vector<CachedQuery*>& queries = mComponentQueries[componentId];
+        queries.erase(std::find(queries.begin(), queries.end(), pQuery));
+    }
+
+    mQueries[queryIndex] = std::move(mQueries.back());
+    mQueries[queryIndex]->cacheIndex = queryIndex;
+    mQueries.pop_back();
+}
+
+
+
+/*-------------------------------------
+ * Enforce the memory limit
+-------------------------------------*/
+void QueryCache::_trim(const CachedQuery* pKeep) noexcept
+{
+    CachedQuery* pQuery = mLeastUsed;
+
+    while (pQuery && mMemoryUsage > mMemoryLimit)
+    {
+        CachedQuery* const pNext = pQuery->pNextUsed;
+
+        if (pQuery != pKeep && !pQuery->tracked)
+        {
+            _evict(*pQuery);
+        }
+
+        pQuery = pNext;
+    }
+}
+
+
+
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+QueryCache::~QueryCache() noexcept
+{
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+QueryCache::QueryCache() noexcept :
+    mQueries{},
+    mComponentQueries{},
+    mBitmaps{},
+    mBitmapThreshold{DEFAULT_BITMAP_THRESHOLD},
+    mMemoryLimit{DEFAULT_MEMORY_LIMIT},
+    mLeastUsed{nullptr},
+    mMostUsed{nullptr},
+    mMemoryUsage{0},
+    mHidden{nullptr}
+{}
+
+
+
+/*-------------------------------------
+ * Move Constructor
+-------------------------------------*/
+QueryCache::QueryCache(QueryCache&& qc) noexcept :
+    mQueries{std::move(qc.mQueries)},
+    mComponentQueries{std::move(qc.mComponentQueries)},
+    mBitmaps{std::move(qc.mBitmaps)},
+    mBitmapThreshold{qc.mBitmapThreshold},
+    mMemoryLimit{qc.mMemoryLimit},
+    mLeastUsed{qc.mLeastUsed},
+    mMostUsed{qc.mMostUsed},
+    mMemoryUsage{qc.mMemoryUsage},
+    mHidden{qc.mHidden}
+{
+    qc.mBitmapThreshold = DEFAULT_BITMAP_THRESHOLD;
+    qc.mMemoryLimit = DEFAULT_MEMORY_LIMIT;
+    qc.mLeastUsed = nullptr;
+    qc.mMostUsed = nullptr;
+    qc.mMemoryUsage = 0;
+    qc.mHidden = nullptr;
+}
+
+
+
+/*-------------------------------------
+ * Move Operator
+-------------------------------------*/
+QueryCache& QueryCache::operator=(QueryCache&& qc) noexcept
+{
+    if (this != &qc)
+    {
+        mQueries = std::move(qc.mQueries);
+        mComponentQueries = std::move(qc.mComponentQueries);
+        mBitmaps = std::move(qc.mBitmaps);
+        mBitmapThreshold = qc.mBitmapThreshold;
+        mMemoryLimit = qc.mMemoryLimit;
+        mLeastUsed = qc.mLeastUsed;
+        mMostUsed = qc.mMostUsed;
+        mMemoryUsage = qc.mMemoryUsage;
+        mHidden = qc.mHidden;
+
+        qc.mBitmapThreshold = DEFAULT_BITMAP_THRESHOLD;
+        qc.mMemoryLimit = DEFAULT_MEMORY_LIMIT;
+        qc.mLeastUsed = nullptr;
+        qc.mMostUsed = nullptr;
+        qc.mMemoryUsage = 0;
+        qc.mHidden = nullptr;
+    }
+
+    return *this;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve or create a query
+-------------------------------------*/
+const EntitySet* QueryCache::find(
+    const std::vector<std::size_t>& required,
+    const std::vector<std::size_t>& excluded,
+    const std::vector<utils::Pointer<Component>>& components) noexcept
+{
+    if (required.empty())
+    {
+        return nullptr;
+    }
+
+    CachedQuery* pQuery = _lookup(required, excluded);
+    if (!pQuery)
+    {
+        pQuery = _create(required, excluded, components);
+        if (!pQuery)
+        {
+            return nullptr;
+        }
+    }
+
+    if (pQuery->dirty)
+    {
+        _rebuild(*pQuery);
+    }
+
+    _touch(*pQuery);
+    _trim(pQuery);
+
+    return &pQuery->entities;
+}
+
+
+
+/*-------------------------------------
+ * Begin tracking query changes
+-------------------------------------*/
+bool QueryCache::track(
+    const std::vector<std::size_t>& required,
+    const std::vector<std::size_t>& excluded,
+    const std::vector<utils::Pointer<Component>>& components) noexcept
+{
+    CachedQuery* pQuery = _lookup(required, excluded);
+    if (!pQuery)
+    {
+        pQuery = _create(required, excluded, components);
+        if (!pQuery)
+        {
+            return false;
+        }
+    }
+
+    if (pQuery->dirty)
+    {
+        _rebuild(*pQuery);
+    }
+
+    pQuery->tracked = true;
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Stop tracking query changes
+-------------------------------------*/
+void QueryCache::untrack(const std::vector<std::size_t>& required, const std::vector<std::size_t>& excluded) noexcept
+{
+    CachedQuery* pQuery = _lookup(required, excluded);
+    if (pQuery)
+    {
+        pQuery->tracked = false;
+        pQuery->entered.clear();
+        pQuery->left.clear();
+        _update_bytes(*pQuery);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Entities which began matching a query
+-------------------------------------*/
+const EntitySet* QueryCache::entered(const std::vector<std::size_t>& required, const std::vector<std::size_t>& excluded) noexcept
+{
+    CachedQuery* pQuery = _lookup(required, excluded);
+    if (!pQuery || !pQuery->tracked)
+    {
+        return nullptr;
+    }
+
+    if (pQuery->dirty)
+    {
+        _rebuild(*pQuery);
+    }
+
+    return &pQuery->entered;
+}
+
+
+
+/*-------------------------------------
+ * Entities which stopped matching a query
+-------------------------------------*/
+const EntitySet* QueryCache::left(const std::vector<std::size_t>& required, const std::vector<std::size_t>& excluded) noexcept
+{
+    CachedQuery* pQuery = _lookup(required, excluded);
+    if (!pQuery || !pQuery->tracked)
+    {
+        return nullptr;
+    }
+
+    if (pQuery->dirty)
+    {
+        _rebuild(*pQuery);
+    }
+
+    return &pQuery->left;
+}
+
+
+
+/*-------------------------------------
+ * Begin a new set of query changes
+-------------------------------------*/
+void QueryCache::clear_changes() noexcept
+{
+    for (utils::Pointer<CachedQuery>& q : mQueries)
+    {
+        if (!q->tracked)
+        {
+            continue;
+        }
+
+        // Pending changes must be attributed to the current set
+        if (q->dirty)
+        {
+            _rebuild(*q);
+        }
+
+        q->entered.clear();
+        q->left.clear();
+        _update_bytes(*q);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Patch queries after an insertion
+-------------------------------------*/
+void QueryCache::on_insert(std::size_t componentId, const Entity& e) noexcept
+{
+    if (componentId < mBitmaps.size() && !mBitmaps[componentId].dirty)
+    {
+        ComponentBitmap& bitmap = mBitmaps[componentId];
+        bitmap.dirty = !bitmap.members.insert(entity_index(e));
+    }
+
+    if (componentId >= mComponentQueries.size())
+    {
+        return;
+    }
+
+    for (CachedQuery* q : mComponentQueries[componentId])
+    {
+        if (q->dirty)
+        {
+            continue;
+        }
+
+        if (!_is_required(*q, componentId))
+        {
+            _remove_entity(*q, e);
+        }
+        else if (_matches(*q, e))
+        {
+            _add_entity(*q, e);
+        }
+
+        _update_bytes(*q);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Patch queries after a removal
+-------------------------------------*/
+void QueryCache::on_erase(std::size_t componentId, const Entity& e) noexcept
+{
+    if (componentId < mBitmaps.size() && !mBitmaps[componentId].dirty)
+    {
+        ComponentBitmap& bitmap = mBitmaps[componentId];
+        bitmap.dirty = !bitmap.members.erase(entity_index(e));
+    }
+
+    if (componentId >= mComponentQueries.size())
+    {
+        return;
+    }
+
+    for (CachedQuery* q : mComponentQueries[componentId])
+    {
+        if (q->dirty)
+        {
+            continue;
+        }
+
+        if (_is_required(*q, componentId))
+        {
+            _remove_entity(*q, e);
+        }
+        else if (_matches(*q, e))
+        {
+            _add_entity(*q, e);
+        }
+
+        _update_bytes(*q);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Patch queries after a batch removal
+-------------------------------------*/
+void QueryCache::on_erase_batch(std::size_t componentId, const std::vector<Entity>& entities) noexcept
+{
+    if (componentId < mBitmaps.size() && !mBitmaps[componentId].dirty)
+    {
+        ComponentBitmap& bitmap = mBitmaps[componentId];
+
+        for (std::size_t i = 0; i < entities.size() && !bitmap.dirty; ++i)
+        {
+            bitmap.dirty = !bitmap.members.erase(entity_index(entities[i]));
+        }
+    }
+
+    if (componentId >= mComponentQueries.size())
+    {
+        return;
+    }
+
+    for (CachedQuery* q : mComponentQueries[componentId])
+    {
+        if (q->dirty)
+        {
+            continue;
+        }
+
+        // Rebuilding visits each remaining entity once, which is cheaper
+        // than patching once a batch approaches the size of the results
+        if (entities.size() >= q->entities.size() / 4)
+        {
+            q->dirty = true;
+            continue;
+        }
+
+        const bool isRequired = _is_required(*q, componentId);
+
+        for (const Entity& e : entities)
+        {
+            if (isRequired)
+            {
+                _remove_entity(*q, e);
+            }
+            else if (_matches(*q, e))
+            {
+                _add_entity(*q, e);
+            }
+        }
+
+        _update_bytes(*q);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Invalidate queries of a modified component
+-------------------------------------*/
+void QueryCache::on_reset(std::size_t componentId) noexcept
+{
+    if (componentId < mBitmaps.size())
+    {
+        mBitmaps[componentId].dirty = true;
+    }
+
+    if (componentId >= mComponentQueries.size())
+    {
+        return;
+    }
+
+    for (CachedQuery* q : mComponentQueries[componentId])
+    {
+        q->dirty = true;
+    }
+}
+
+
+
+/*-------------------------------------
+ * Set the entities excluded from all queries
+-------------------------------------*/
+void QueryCache::hidden_entities(const EntitySet* pHidden) noexcept
+{
+    mHidden = pHidden;
+}
+
+
+
+/*-------------------------------------
+ * Remove a hidden entity from all queries
+-------------------------------------*/
+void QueryCache::hide(const Entity& e) noexcept
+{
+    for (utils::Pointer<CachedQuery>& q : mQueries)
+    {
+        if (!q->dirty)
+        {
+            _remove_entity(*q, e);
+            _update_bytes(*q);
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Invalidate all queries
+-------------------------------------*/
+void QueryCache::invalidate() noexcept
+{
+    for (utils::Pointer<CachedQuery>& q : mQueries)
+    {
+        q->dirty = true;
+    }
+
+    for (ComponentBitmap& bitmap : mBitmaps)
+    {
+        bitmap.dirty = true;
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove queries for a destroyed component
+-------------------------------------*/
+void QueryCache::remove_component(std::size_t componentId) noexcept
+{
+    if (componentId < mBitmaps.size())
+    {
+        mBitmaps[componentId].members.clear();
+        mBitmaps[componentId].dirty = true;
+    }
+
+    if (componentId >= mComponentQueries.size())
+    {
+        return;
+    }
+
+    while (!mComponentQueries[componentId].empty())
+    {
+        _evict(*mComponentQueries[componentId].back());
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove all queries
+-------------------------------------*/
+void QueryCache::clear() noexcept
+{
+    mQueries.clear();
+    mComponentQueries.clear();
+    mBitmaps.clear();
+    mLeastUsed = nullptr;
+    mMostUsed = nullptr;
+    mMemoryUsage = 0;
+}
+
+
+
+/*-------------------------------------
+ * Set the minimum width of bitmap queries
+-------------------------------------*/
+void QueryCache::bitmap_threshold(std::size_t numComponents) noexcept
+{
+    mBitmapThreshold = numComponents;
+
+    if (!numComponents)
+    {
+        mBitmaps.clear();
+        mBitmaps.shrink_to_fit();
+    }
+}
+
+
+
+/*-------------------------------------
+ * Set the maximum cache size
+-------------------------------------*/
+void QueryCache::memory_limit(std::size_t numBytes) noexcept
+{
+    mMemoryLimit = numBytes;
+    _trim(nullptr);
+}
+
+
+
+/*-------------------------------------
+ * Current cache size
+-------------------------------------*/
+std::size_t QueryCache::memory_usage() const noexcept
+{
+    return mMemoryUsage;
+}
+
+
+
+/*-------------------------------------
+ * Memory accounting
+-------------------------------------*/
+MemoryStats QueryCache::memory_stats() const noexcept
+{
+    MemoryStats stats{0, 0, 0};
+
+    stats.reservedBytes += mQueries.capacity() * sizeof(utils::Pointer<CachedQuery>);
+    stats.reservedBytes += mComponentQueries.capacity() * sizeof(std::vector<CachedQuery*>);
+
+    for (const std::vector<CachedQuery*>& queries : mComponentQueries)
+    {
+        stats.reservedBytes += queries.capacity() * sizeof(CachedQuery*);
+    }
+
+    stats.reservedBytes += mBitmaps.capacity() * sizeof(ComponentBitmap);
+
+    for (const ComponentBitmap& bitmap : mBitmaps)
+    {
+        stats += bitmap.members.memory_stats();
+    }
+
+    for (const utils::Pointer<CachedQuery>& q : mQueries)
+    {
+        stats.usedBytes += sizeof(CachedQuery);
+        stats.reservedBytes += sizeof(CachedQuery);
+        stats.reservedBytes += (q->required.capacity() + q->excluded.capacity()) * sizeof(std::size_t);
+        stats.reservedBytes += (q->requiredComponents.capacity() + q->excludedComponents.capacity()) * sizeof(const Component*);
+
+        stats += q->entities.memory_stats();
+        stats += q->entered.memory_stats();
+        stats += q->left.memory_stats();
+    }
+
+    return stats;
+}
+
+
+
+} // end game namespace
+} // end ls namespace
@@ -0,0 +1,235 @@
+
+#include "lightsky/utils/Assertions.h"
+
+#include "lightsky/game/Component.hpp"
+#include "lightsky/game/ECSDatabase.hpp"
+#include "lightsky/game/EntitySet.hpp"
+#include "lightsky/game/RollbackBuffer.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-------------------------------------
+ * Check if components were added or removed
+-------------------------------------*/
+bool RollbackBuffer::_layout_changed() const noexcept
+{
+    const std::vector<utils::Pointer<Component>>& components = mDb->mComponents;
+
+    if (components.size() != mComponents.size())
+    {
+        return true;
+    }
+
+    for (std::size_t i = 0; i < components.size(); ++i)
+    {
+        if (components[i].get() != mComponents[i])
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+
+/*-------------------------------------
+ * Begin tracking the current database layout
+-------------------------------------*/
+bool RollbackBuffer::_rebuild() noexcept
+{
+    // Tracked components may no longer exist.
+    for (utils::Pointer<PageHistoryBase>& history : mHistories)
+    {
+        history->detach();
+    }
+
+    mHistories.clear();
+    mComponents.clear();
+    mTicks.clear();
+
+    if (!track(mDb->mEntities) || !track(mDb->mDormantEntities) || !track(mDb->mGenerations))
+    {
+        return false;
+    }
+
+    for (utils::Pointer<Component>& c : mDb->mComponents)
+    {
+        mComponents.push_back(c.get());
+
+        if (c)
+        {
+            c->track_history(*this);
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+RollbackBuffer::~RollbackBuffer() noexcept
+{
+    clear();
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+RollbackBuffer::RollbackBuffer(ECSDatabase& db, std::size_t maxTicks) noexcept :
+    mDb{&db},
+    mMaxTicks{maxTicks},
+    mHistories{},
+    mComponents{},
+    mTicks{}
+{}
+
+
+
+/*-------------------------------------
+ * Track an entity set
+-------------------------------------*/
+bool RollbackBuffer::track(EntitySet& entities) noexcept
+{
+    return track(entities.mDense) && track(entities.mSparse);
+}
+
+
+
+/*-------------------------------------
+ * Save a tick
+-------------------------------------*/
+bool RollbackBuffer::save_tick(uint64_t tick) noexcept
+{
+    LS_DEBUG_ASSERT(mTicks.empty() || tick > mTicks.back().tick);
+
+    if (mTicks.empty() || _layout_changed())
+    {
+        // The first tick is a baseline which all later ticks are diffed
+        // against.
+        if (!_rebuild())
+        {
+            return false;
+        }
+    }
+    else
+    {
+        for (utils::Pointer<PageHistoryBase>& history : mHistories)
+        {
+            if (!history->save())
+            {
+                return false;
+            }
+        }
+    }
+
+    mTicks.push_back(SavedTick{tick, mDb->mMinEntityId, std::vector<std::size_t>{}});
+    mTicks.back().numActive.reserve(mComponents.size());
+
+    for (const Component* pComponent : mComponents)
+    {
+        mTicks.back().numActive.push_back(pComponent ? pComponent->mNumActive : 0);
+    }
+
+    while (mTicks.size() > mMaxTicks)
+    {
+        for (utils::Pointer<PageHistoryBase>& history : mHistories)
+        {
+            history->drop_oldest();
+        }
+
+        mTicks.pop_front();
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Restore a previous tick
+-------------------------------------*/
+bool RollbackBuffer::rollback_to(uint64_t tick) noexcept
+{
+    if (mTicks.empty() || _layout_changed())
+    {
+        return false;
+    }
+
+    std::size_t numUndos = 0;
+    std::deque<SavedTick>::reverse_iterator iter = mTicks.rbegin();
+
+    while (iter != mTicks.rend() && iter->tick > tick)
+    {
+        ++iter;
+        ++numUndos;
+    }
+
+    if (iter == mTicks.rend() || iter->tick != tick)
+    {
+        return false;
+    }
+
+    for (utils::Pointer<PageHistoryBase>& history : mHistories)
+    {
+        history->restore(numUndos);
+    }
+
+    for (std::size_t i = 0; i < mDb->mComponents.size(); ++i)
+    {
+        if (mDb->mComponents[i])
+        {
+            mDb->mComponents[i]->mNumActive = iter->numActive[i];
+            mDb->mComponents[i]->mOrderDirty = true;
+            mDb->mComponents[i]->restore_data();
+        }
+    }
+
+    // Entity IDs may have been handed out by EntityBlocks after the save.
+    mDb->mMinEntityId = iter->minEntityId;
+    mDb->_update_min_entity_id(mDb->mMinEntityId);
+
+    // Deferred destruction only applies to the tick which requested it
+    mDb->mDeadEntities.clear();
+
+    // Component storage was modified without sending any notifications
+    mDb->mQueries.invalidate();
+    mTicks.erase(iter.base(), mTicks.end());
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Release all history
+-------------------------------------*/
+void RollbackBuffer::clear() noexcept
+{
+    if (_layout_changed())
+    {
+        for (utils::Pointer<PageHistoryBase>& history : mHistories)
+        {
+            history->detach();
+        }
+    }
+
+    mHistories.clear();
+    mComponents.clear();
+    mTicks.clear();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
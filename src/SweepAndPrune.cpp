@@ -0,0 +1,233 @@
+
+#include <algorithm> // std::sort, std::stable_sort, std::inplace_merge
+#include <utility> // std::swap
+
+#include "lightsky/game/BoundsComponent.hpp"
+#include "lightsky/game/Dispatcher.h"
+#include "lightsky/game/SweepAndPrune.hpp"
+#include "lightsky/game/Tracer.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-------------------------------------
+ * Test the Y and Z axes for overlap
+-------------------------------------*/
+inline bool SweepAndPrune::_overlaps(const Proxy& p, const Proxy& q) noexcept
+{
+    return p.minBounds[1] <= q.maxBounds[1] && q.minBounds[1] <= p.maxBounds[1]
+        && p.minBounds[2] <= q.maxBounds[2] && q.minBounds[2] <= p.maxBounds[2];
+}
+
+
+
+/*-------------------------------------
+ * Synchronize with a bounds component
+-------------------------------------*/
+bool SweepAndPrune::update(const BoundsComponent& bounds) noexcept
+{
+    LS_GAME_TRACE_SCOPE("SweepAndPrune::update");
+
+    const EntitySet& entities = bounds.entities();
+    std::size_t numKept = 0;
+
+    // Refresh the bounds of existing proxies, dropping removed entities
+    for (std::size_t i = 0; i < mProxies.size(); ++i)
+    {
+        Proxy p = mProxies[i];
+
+        if (!entities.contains(p.entity))
+        {
+            mTrackedStale = mTrackedStale || !mTracked.erase(p.entity);
+            continue;
+        }
+
+        const std::size_t index = entities.index_of(p.entity);
+        const std::size_t chunkId = index / BoundsComponent::CHUNK_SIZE;
+        const std::size_t row = index % BoundsComponent::CHUNK_SIZE;
+
+        p.minBounds[0] = bounds.column<BoundsComponent::MIN_X>(chunkId)[row];
+        p.minBounds[1] = bounds.column<BoundsComponent::MIN_Y>(chunkId)[row];
+        p.minBounds[2] = bounds.column<BoundsComponent::MIN_Z>(chunkId)[row];
+        p.maxBounds[0] = bounds.column<BoundsComponent::MAX_X>(chunkId)[row];
+        p.maxBounds[1] = bounds.column<BoundsComponent::MAX_Y>(chunkId)[row];
+        p.maxBounds[2] = bounds.column<BoundsComponent::MAX_Z>(chunkId)[row];
+
+        mProxies[numKept++] = p;
+    }
+
+    mProxies.resize(numKept);
+
+    // A removed entity which is still tracked would never get a new proxy
+    if (mTrackedStale)
+    {
+        mTracked.clear();
+
+        for (const Proxy& p : mProxies)
+        {
+            if (!mTracked.insert(p.entity))
+            {
+                return false;
+            }
+        }
+
+        mTrackedStale = false;
+    }
+
+    const auto compareProxies = [](const Proxy& p, const Proxy& q) noexcept->bool
+    {
+        return p.minBounds[0] < q.minBounds[0];
+    };
+
+    // Insertion sort, which is close to linear for the previous frame's
+    // order. Both sorts are stable, so the fallback gives the same order.
+    const std::size_t maxSwaps = mProxies.size() * MAX_SORT_SWAPS_PER_PROXY;
+    std::size_t numSwaps = 0;
+
+    for (std::size_t i = 1; i < mProxies.size() && numSwaps <= maxSwaps; ++i)
+    {
+        for (std::size_t j = i; j > 0 && compareProxies(mProxies[j], mProxies[j-1]); --j)
+        {
+            std::swap(mProxies[j], mProxies[j-1]);
+            ++numSwaps;
+        }
+    }
+
+    if (numSwaps > maxSwaps)
+    {
+        std::stable_sort(mProxies.begin(), mProxies.end(), compareProxies);
+    }
+
+    // Append new entities, then merge them into the sorted proxies
+    for (std::size_t c = 0; c < bounds.num_chunks(); ++c)
+    {
+        const Entity* pEntities = bounds.chunk_entities(c);
+        const float* pMinX = bounds.column<BoundsComponent::MIN_X>(c);
+        const float* pMinY = bounds.column<BoundsComponent::MIN_Y>(c);
+        const float* pMinZ = bounds.column<BoundsComponent::MIN_Z>(c);
+        const float* pMaxX = bounds.column<BoundsComponent::MAX_X>(c);
+        const float* pMaxY = bounds.column<BoundsComponent::MAX_Y>(c);
+        const float* pMaxZ = bounds.column<BoundsComponent::MAX_Z>(c);
+
+        for (std::size_t row = 0; row < bounds.chunk_size(c); ++row)
+        {
+            if (mTracked.contains(pEntities[row]))
+            {
+                continue;
+            }
+
+            if (!mTracked.insert(pEntities[row]))
+            {
+                return false;
+            }
+
+            mProxies.push_back(Proxy{
+                {pMinX[row], pMinY[row], pMinZ[row]},
+                {pMaxX[row], pMaxY[row], pMaxZ[row]},
+                pEntities[row]
+            });
+        }
+    }
+
+    if (numKept < mProxies.size())
+    {
+        std::sort(mProxies.begin() + numKept, mProxies.end(), compareProxies);
+        std::inplace_merge(mProxies.begin(), mProxies.begin() + numKept, mProxies.end(), compareProxies);
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Find all overlapping pairs
+-------------------------------------*/
+const std::vector<EntityPair>& SweepAndPrune::sweep() noexcept
+{
+    LS_GAME_TRACE_SCOPE("SweepAndPrune::sweep");
+
+    sweep_job(0, 1, mPairs);
+    return mPairs;
+}
+
+
+
+/*-------------------------------------
+ * Sweep a range of proxies
+-------------------------------------*/
+void SweepAndPrune::sweep_job(std::size_t jobId, std::size_t numJobs, std::vector<EntityPair>& outPairs) const noexcept
+{
+    const std::size_t numProxies = mProxies.size();
+    const std::size_t begin = (numProxies * jobId) / numJobs;
+    const std::size_t end = (numProxies * (jobId+1)) / numJobs;
+
+    outPairs.clear();
+
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        const Proxy& p = mProxies[i];
+
+        for (std::size_t j = i+1; j < numProxies && mProxies[j].minBounds[0] <= p.maxBounds[0]; ++j)
+        {
+            const Proxy& q = mProxies[j];
+
+            if (_overlaps(p, q))
+            {
+                outPairs.push_back((p.entity.id < q.entity.id) ? EntityPair{p.entity, q.entity} : EntityPair{q.entity, p.entity});
+            }
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Combine the output of sweep jobs
+-------------------------------------*/
+const std::vector<EntityPair>& SweepAndPrune::merge_jobs(const std::vector<EntityPair>* pJobPairs, std::size_t numJobs) noexcept
+{
+    mPairs.clear();
+
+    for (std::size_t j = 0; j < numJobs; ++j)
+    {
+        mPairs.insert(mPairs.end(), pJobPairs[j].begin(), pJobPairs[j].end());
+    }
+
+    return mPairs;
+}
+
+
+
+/*-------------------------------------
+ * Queue pairs as events
+-------------------------------------*/
+void SweepAndPrune::dispatch_pairs(Dispatcher& dispatcher, int64_t type) const noexcept
+{
+    for (std::size_t i = 0; i < mPairs.size(); ++i)
+    {
+        dispatcher.push(Event{type, (int64_t)i, (int64_t)mPairs[i].a.id, (int64_t)mPairs[i].b.id});
+    }
+}
+
+
+
+/*-------------------------------------
+ * Remove all proxies
+-------------------------------------*/
+void SweepAndPrune::clear() noexcept
+{
+    mProxies.clear();
+    mTracked.clear();
+    mTrackedStale = false;
+    mPairs.clear();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
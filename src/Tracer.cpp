@@ -0,0 +1,258 @@
+
+#include <fstream>
+#include <ostream>
+
+#include "lightsky/game/ComponentProfiler.hpp"
+#include "lightsky/game/Tracer.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Anonymous helper functions
+-----------------------------------------------------------------------------*/
+namespace
+{
+
+
+
+/*-------------------------------------
+ * Write a JSON string
+-------------------------------------*/
+void write_json_string(std::ostream& out, const char* str) noexcept
+{
+    out << '"';
+
+    for (; *str; ++str)
+    {
+        const char c = *str;
+
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            out << ' ';
+        }
+        else
+        {
+            out << c;
+        }
+    }
+
+    out << '"';
+}
+
+
+
+/*-------------------------------------
+ * Write nanoseconds as fractional microseconds
+-------------------------------------*/
+void write_micros(std::ostream& out, uint64_t nanos) noexcept
+{
+    const uint64_t fraction = nanos % 1000;
+
+    out << (nanos / 1000) << '.';
+
+    if (fraction < 100)
+    {
+        out << '0';
+    }
+
+    if (fraction < 10)
+    {
+        out << '0';
+    }
+
+    out << fraction;
+}
+
+
+
+} // end anonymous namespace
+
+
+
+/*-----------------------------------------------------------------------------
+ * Tracer
+-----------------------------------------------------------------------------*/
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+Tracer::Tracer() noexcept :
+    mEnabled{false},
+    mBuffers{},
+    mEvents{},
+    mMaxEvents{DEFAULT_MAX_EVENTS}
+{}
+
+
+
+/*-------------------------------------
+ * Global tracer
+-------------------------------------*/
+Tracer& Tracer::global() noexcept
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+
+
+/*-------------------------------------
+ * Start or stop recording
+-------------------------------------*/
+void Tracer::enable(bool doEnable) noexcept
+{
+    mEnabled.store(doEnable, std::memory_order_relaxed);
+}
+
+
+
+/*-------------------------------------
+ * Record a zone
+-------------------------------------*/
+void Tracer::record(const char* name, uint64_t startNanos, uint64_t durationNanos, std::size_t arg) noexcept
+{
+    mBuffers.push(TraceEvent{name, startNanos, durationNanos, arg});
+}
+
+
+
+/*-------------------------------------
+ * Gather events from all threads
+-------------------------------------*/
+void Tracer::collect() noexcept
+{
+    mBuffers.consume([this](const TraceEvent& e, std::size_t threadIndex) noexcept->void
+    {
+        mEvents.push_back(RecordedEvent{e, threadIndex});
+    });
+
+    while (mEvents.size() > mMaxEvents)
+    {
+        mEvents.pop_front();
+    }
+}
+
+
+
+/*-------------------------------------
+ * Set the maximum number of gathered events
+-------------------------------------*/
+void Tracer::max_events(std::size_t maxEvents) noexcept
+{
+    mMaxEvents = maxEvents;
+
+    while (mEvents.size() > mMaxEvents)
+    {
+        mEvents.pop_front();
+    }
+}
+
+
+
+/*-------------------------------------
+ * Discard all events
+-------------------------------------*/
+void Tracer::clear() noexcept
+{
+    collect();
+    mEvents.clear();
+    mBuffers.reset_num_dropped();
+}
+
+
+
+/*-------------------------------------
+ * Chrome Trace Event export
+-------------------------------------*/
+bool Tracer::write_chrome_trace(std::ostream& out) noexcept
+{
+    collect();
+
+    std::size_t numThreads = 0;
+    for (const RecordedEvent& r : mEvents)
+    {
+        numThreads = (r.threadIndex >= numThreads) ? (r.threadIndex + 1) : numThreads;
+    }
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+    for (std::size_t t = 0; t < numThreads; ++t)
+    {
+        out
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+            << ",\"args\":{\"name\":\"Thread " << t << "\"}},\n";
+    }
+
+    for (const RecordedEvent& r : mEvents)
+    {
+        out << "{\"name\":";
+        write_json_string(out, r.event.name);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << r.threadIndex << ",\"ts\":";
+        write_micros(out, r.event.startNanos);
+        out << ",\"dur\":";
+        write_micros(out, r.event.durationNanos);
+
+        if (r.event.arg != NO_ARG)
+        {
+            out << ",\"args\":{\"id\":" << r.event.arg << '}';
+        }
+
+        out << "},\n";
+    }
+
+    // Chrome accepts a trailing metadata entry, avoiding an extra comma check
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"LightGame\"}}\n]}\n";
+
+    return (bool)out;
+}
+
+
+
+/*-------------------------------------
+ * Chrome Trace Event export to a file
+-------------------------------------*/
+bool Tracer::write_chrome_trace(const char* path) noexcept
+{
+    std::ofstream out{path};
+    return out && write_chrome_trace(out);
+}
+
+
+
+/*-----------------------------------------------------------------------------
+ * Trace Zone
+-----------------------------------------------------------------------------*/
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+TraceZone::~TraceZone() noexcept
+{
+    if (mName)
+    {
+        Tracer::global().record(mName, mStartNanos, ComponentProfiler::now() - mStartNanos, mArg);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+TraceZone::TraceZone(const char* name, std::size_t arg) noexcept :
+    mName{Tracer::global().is_enabled() ? name : nullptr},
+    mArg{arg},
+    mStartNanos{mName ? ComponentProfiler::now() : 0}
+{}
+
+
+
+} // end game namespace
+} // end ls namespace
@@ -0,0 +1,705 @@
+
+#include <algorithm> // std::remove_if
+#include <cmath> // std::floor
+#include <cstdio> // std::remove
+#include <cstring> // std::memcpy
+#include <fstream>
+#include <system_error>
+#include <utility> // std::move
+
+#include "lightsky/game/ECSDatabase.hpp"
+#include "lightsky/game/Tracer.hpp"
+#include "lightsky/game/WorldPartition.hpp"
+
+namespace ls
+{
+namespace game
+{
+
+
+
+/*-----------------------------------------------------------------------------
+ * Anonymous helper functions
+-----------------------------------------------------------------------------*/
+namespace
+{
+
+
+
+enum : uint32_t
+{
+    CELL_FILE_MAGIC = 0x43574C53, // "LSWC"
+    CELL_FILE_VERSION = 2
+};
+
+
+
+// Per-entity flags which precede each entity's components.
+enum : uint32_t
+{
+    CELL_ENTITY_DORMANT = 0x01
+};
+
+
+
+/*-------------------------------------
+ * Append a value to a byte buffer
+-------------------------------------*/
+template <typename T>
+inline void write_value(std::vector<char>& data, const T& value) noexcept
+{
+    const char* pValue = reinterpret_cast<const char*>(&value);
+    data.insert(data.end(), pValue, pValue + sizeof(T));
+}
+
+
+
+/*-------------------------------------
+ * Overwrite a value within a byte buffer
+-------------------------------------*/
+template <typename T>
+inline void patch_value(std::vector<char>& data, std::size_t offset, const T& value) noexcept
+{
+    std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+
+
+/*-------------------------------------
+ * Read a value from a byte buffer
+-------------------------------------*/
+template <typename T>
+inline bool read_value(const std::vector<char>& data, std::size_t& offset, T& outValue) noexcept
+{
+    if (data.size() - offset < sizeof(T))
+    {
+        return false;
+    }
+
+    std::memcpy(&outValue, data.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+
+
+} // end anonymous namespace
+
+
+
+/*-----------------------------------------------------------------------------
+ * World Partition Member Functions
+-----------------------------------------------------------------------------*/
+/*-------------------------------------
+ * Destructor
+-------------------------------------*/
+WorldPartition::~WorldPartition() noexcept
+{
+    mDb.remove_entity_listener(*this);
+
+    if (!mIOThread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mLock};
+        mStopping = true;
+    }
+
+    mWakeup.notify_one();
+    mIOThread.join();
+}
+
+
+
+/*-------------------------------------
+ * Constructor
+-------------------------------------*/
+WorldPartition::WorldPartition(ECSDatabase& db, const std::string& directory) noexcept :
+    mDb(db),
+    mDirectory{directory},
+    mMergeBudget{DEFAULT_MERGE_BUDGET},
+    mEntityCells{},
+    mCellEntities{},
+    mCellStates{},
+    mMerged{},
+    mMerging{},
+    mNumIOJobs{0},
+    mLock{},
+    mWakeup{},
+    mJobs{},
+    mLoaded{},
+    mWritten{},
+    mFailedWrites{},
+    mStopping{false},
+    mIOThread{}
+{}
+
+
+
+/*-------------------------------------
+ * Launch the I/O thread
+-------------------------------------*/
+bool WorldPartition::start() noexcept
+{
+    if (mIOThread.joinable())
+    {
+        return true;
+    }
+
+    // Thread creation reports failure through an exception
+    try
+    {
+        mIOThread = std::thread{&WorldPartition::_run_io, this};
+    }
+    catch (const std::system_error&)
+    {
+        return false;
+    }
+
+    mDb.add_entity_listener(*this);
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Path to a cell's file
+-------------------------------------*/
+std::string WorldPartition::cell_path(CellId cellId) const noexcept
+{
+    return mDirectory + "/cell_" + std::to_string(cellId) + ".bin";
+}
+
+
+
+/*-------------------------------------
+ * I/O thread
+-------------------------------------*/
+void WorldPartition::_run_io() noexcept
+{
+    std::unique_lock<std::mutex> lock{mLock};
+
+    for (;;)
+    {
+        mWakeup.wait(lock, [this]()->bool
+        {
+            return mStopping || !mJobs.empty();
+        });
+
+        // Pending jobs are finished before stopping so no cell is lost
+        if (mJobs.empty())
+        {
+            return;
+        }
+
+        IOJob job = std::move(mJobs.front());
+        mJobs.pop_front();
+        lock.unlock();
+
+        if (job.type == IOJobType::IO_WRITE)
+        {
+            const std::string path = cell_path(job.cellId);
+            bool ok;
+            {
+                std::ofstream file{path, std::ios::binary | std::ios::trunc};
+                file.write(job.data.data(), (std::streamsize)job.data.size());
+                file.close();
+                ok = (bool)file;
+            }
+
+            // Any read queued behind a failed write must not see a partial
+            // file
+            if (!ok)
+            {
+                std::remove(path.c_str());
+            }
+
+            lock.lock();
+            (ok ? mWritten : mFailedWrites).push_back(job.cellId);
+        }
+        else
+        {
+            PendingCell cell{job.cellId, false, std::vector<char>{}, 0, 0, EntitySet{}};
+            std::ifstream file{cell_path(job.cellId), std::ios::binary | std::ios::ate};
+
+            if (file)
+            {
+                cell.data.resize((std::size_t)file.tellg());
+                file.seekg(0);
+                file.read(cell.data.data(), (std::streamsize)cell.data.size());
+                cell.ok = (bool)file;
+            }
+
+            lock.lock();
+            mLoaded.push_back(std::move(cell));
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Queue a job for the I/O thread
+-------------------------------------*/
+void WorldPartition::_push_job(IOJobType type, CellId cellId, std::vector<char>&& data) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{mLock};
+        mJobs.push_back(IOJob{type, cellId, std::move(data)});
+    }
+
+    ++mNumIOJobs;
+
+    mWakeup.notify_one();
+}
+
+
+
+/*-------------------------------------
+ * Serialize the entities of a cell
+-------------------------------------*/
+bool WorldPartition::_serialize_cell(const EntitySet& entities, std::vector<char>& outData) const noexcept
+{
+    uint64_t numEntities = 0;
+
+    write_value<uint32_t>(outData, CELL_FILE_MAGIC);
+    write_value<uint32_t>(outData, CELL_FILE_VERSION);
+    write_value<uint64_t>(outData, numEntities);
+
+    for (std::size_t i = 0; i < entities.size(); ++i)
+    {
+        const Entity& e = entities[i];
+
+        // Entities awaiting deferred destruction are skipped
+        if (!mDb.mEntities.contains(e) || mDb.mDeadEntities.contains(e))
+        {
+            continue;
+        }
+
+        write_value<uint32_t>(outData, mDb.is_dormant(e) ? (uint32_t)CELL_ENTITY_DORMANT : 0u);
+
+        const std::size_t countOffset = outData.size();
+        uint32_t numComponents = 0;
+        write_value<uint32_t>(outData, numComponents);
+
+        for (std::size_t c = 0; c < mDb.mComponents.size(); ++c)
+        {
+            const Component* pComponent = mDb.mComponents[c].get();
+            if (!pComponent || !pComponent->contains(e))
+            {
+                continue;
+            }
+
+            write_value<uint32_t>(outData, (uint32_t)c);
+
+            const std::size_t sizeOffset = outData.size();
+            write_value<uint32_t>(outData, 0);
+
+            if (!pComponent->serialize_data(pComponent->entities().index_of(e), outData))
+            {
+                return false;
+            }
+
+            patch_value<uint32_t>(outData, sizeOffset, (uint32_t)(outData.size() - sizeOffset - sizeof(uint32_t)));
+            ++numComponents;
+        }
+
+        patch_value<uint32_t>(outData, countOffset, numComponents);
+        ++numEntities;
+    }
+
+    patch_value<uint64_t>(outData, 2 * sizeof(uint32_t), numEntities);
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Create one entity from a loaded cell
+-------------------------------------*/
+bool WorldPartition::_merge_entity(PendingCell& cell) noexcept
+{
+    uint32_t flags;
+    uint32_t numComponents;
+    if (!read_value(cell.data, cell.offset, flags) || !read_value(cell.data, cell.offset, numComponents))
+    {
+        return false;
+    }
+
+    const Entity e = mDb.create_entity();
+    if (e.id == ECSDatabase::INVALID_ENTITY)
+    {
+        return false;
+    }
+
+    if (!cell.created.insert(e))
+    {
+        Entity discarded = e;
+        mDb.destroy_entity(discarded);
+        return false;
+    }
+
+    mMerged.push_back(e);
+    assign(e, cell.cellId);
+
+    // Components inserted into a dormant entity stay behind the awake prefix
+    if ((flags & CELL_ENTITY_DORMANT) && !mDb.sleep_entity(e))
+    {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < numComponents; ++i)
+    {
+        uint32_t componentId;
+        uint32_t numBytes;
+
+        if (!read_value(cell.data, cell.offset, componentId)
+        || !read_value(cell.data, cell.offset, numBytes)
+        || cell.data.size() - cell.offset < numBytes)
+        {
+            return false;
+        }
+
+        const char* pData = cell.data.data() + cell.offset;
+        cell.offset += numBytes;
+
+        // Components destroyed since the cell was unloaded are skipped
+        Component* pComponent = (componentId < mDb.mComponents.size()) ? mDb.mComponents[componentId].get() : nullptr;
+        if (!pComponent)
+        {
+            continue;
+        }
+
+        if (pComponent->insert(e) != ComponentAddStatus::ADD_OK
+        || !pComponent->deserialize_data(pComponent->entities().index_of(e), pData, numBytes))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Undo a partially merged cell
+-------------------------------------*/
+void WorldPartition::_discard_merge(PendingCell& cell) noexcept
+{
+    // Destroying entities removes them from "cell.created" through
+    // "on_destroy()", so the set is moved out first
+    const EntitySet discarded = std::move(cell.created);
+    cell.created.clear();
+
+    mMerged.erase(std::remove_if(mMerged.begin(), mMerged.end(), [&discarded](const Entity& e) noexcept->bool
+    {
+        return discarded.contains(e);
+    }), mMerged.end());
+
+    for (std::size_t i = 0; i < discarded.size(); ++i)
+    {
+        Entity e = discarded[i];
+        if (mDb.mEntities.contains(e))
+        {
+            mDb.destroy_entity(e);
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Forget a destroyed entity
+-------------------------------------*/
+void WorldPartition::on_destroy(const Entity& e) noexcept
+{
+    unassign(e);
+
+    for (PendingCell& cell : mMerging)
+    {
+        cell.created.erase(e);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Follow a renamed entity
+-------------------------------------*/
+void WorldPartition::on_rename(const Entity& from, const Entity& to) noexcept
+{
+    const std::unordered_map<EntityIdType, CellId>::iterator iter = mEntityCells.find(from.id);
+    if (iter != mEntityCells.end())
+    {
+        const CellId cellId = iter->second;
+        mEntityCells.erase(iter);
+
+        if (mCellEntities[cellId].rename(from, to))
+        {
+            mEntityCells[to.id] = cellId;
+        }
+        else
+        {
+            mCellEntities[cellId].erase(from);
+        }
+    }
+
+    for (PendingCell& cell : mMerging)
+    {
+        if (cell.created.contains(from) && !cell.created.rename(from, to))
+        {
+            cell.created.erase(from);
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Grid cell of a position
+-------------------------------------*/
+CellId WorldPartition::cell_at(const math::vec3& position, float cellSize) noexcept
+{
+    const uint32_t x = (uint32_t)(int32_t)std::floor(position[0] / cellSize);
+    const uint32_t z = (uint32_t)(int32_t)std::floor(position[2] / cellSize);
+
+    return ((CellId)x << 32) | (CellId)z;
+}
+
+
+
+/*-------------------------------------
+ * Place an entity within a cell
+-------------------------------------*/
+bool WorldPartition::assign(const Entity& e, CellId cellId) noexcept
+{
+    if (!is_started() || !mDb.mEntities.contains(e))
+    {
+        return false;
+    }
+
+    unassign(e);
+
+    if (!mCellEntities[cellId].insert(e))
+    {
+        return false;
+    }
+
+    mEntityCells[e.id] = cellId;
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Remove an entity from its cell
+-------------------------------------*/
+void WorldPartition::unassign(const Entity& e) noexcept
+{
+    const std::unordered_map<EntityIdType, CellId>::iterator iter = mEntityCells.find(e.id);
+    if (iter != mEntityCells.end())
+    {
+        mCellEntities[iter->second].erase(e);
+        mEntityCells.erase(iter);
+    }
+}
+
+
+
+/*-------------------------------------
+ * Retrieve an entity's cell
+-------------------------------------*/
+bool WorldPartition::cell_of(const Entity& e, CellId& outCellId) const noexcept
+{
+    const std::unordered_map<EntityIdType, CellId>::const_iterator iter = mEntityCells.find(e.id);
+    if (iter == mEntityCells.end())
+    {
+        return false;
+    }
+
+    outCellId = iter->second;
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Retrieve a cell's state
+-------------------------------------*/
+CellState WorldPartition::cell_state(CellId cellId) const noexcept
+{
+    const std::unordered_map<CellId, CellState>::const_iterator iter = mCellStates.find(cellId);
+    return (iter == mCellStates.end()) ? CellState::CELL_LOADED : iter->second;
+}
+
+
+
+/*-------------------------------------
+ * Stream a cell out
+-------------------------------------*/
+bool WorldPartition::unload(CellId cellId) noexcept
+{
+    LS_GAME_TRACE_SCOPE("WorldPartition::unload");
+
+    if (!is_started() || cell_state(cellId) != CellState::CELL_LOADED)
+    {
+        return false;
+    }
+
+    std::vector<char> data;
+
+    if (!_serialize_cell(mCellEntities[cellId], data))
+    {
+        return false;
+    }
+
+    // The cell is detached before destroying its entities, which would
+    // otherwise remove themselves from it through "on_destroy()"
+    const EntitySet entities = std::move(mCellEntities[cellId]);
+    mCellEntities.erase(cellId);
+
+    for (std::size_t i = 0; i < entities.size(); ++i)
+    {
+        Entity e = entities[i];
+        mEntityCells.erase(e.id);
+
+        if (mDb.mEntities.contains(e) && !mDb.mDeadEntities.contains(e))
+        {
+            mDb.destroy_entity(e);
+        }
+    }
+
+    mCellStates[cellId] = CellState::CELL_UNLOADING;
+    _push_job(IOJobType::IO_WRITE, cellId, std::move(data));
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Stream a cell in
+-------------------------------------*/
+bool WorldPartition::load(CellId cellId) noexcept
+{
+    const CellState state = cell_state(cellId);
+
+    // Jobs run in order, so a cell which is still being written is read
+    // after the write completes. Failed cells may be retried.
+    if (!is_started() || state == CellState::CELL_LOADED || state == CellState::CELL_LOADING)
+    {
+        return false;
+    }
+
+    mCellStates[cellId] = CellState::CELL_LOADING;
+    _push_job(IOJobType::IO_READ, cellId, std::vector<char>{});
+
+    return true;
+}
+
+
+
+/*-------------------------------------
+ * Merge loaded cells at a sync point
+-------------------------------------*/
+std::size_t WorldPartition::sync() noexcept
+{
+    LS_GAME_TRACE_SCOPE("WorldPartition::sync");
+
+    std::vector<CellId> written;
+    std::vector<CellId> failedWrites;
+
+    {
+        std::lock_guard<std::mutex> lock{mLock};
+
+        for (PendingCell& cell : mLoaded)
+        {
+            mMerging.push_back(std::move(cell));
+        }
+
+        mNumIOJobs -= mLoaded.size();
+
+        mLoaded.clear();
+        written.swap(mWritten);
+        failedWrites.swap(mFailedWrites);
+    }
+
+    mNumIOJobs -= written.size() + failedWrites.size();
+
+    // A cell may have been re-loaded before its write finished
+    for (CellId cellId : written)
+    {
+        if (cell_state(cellId) == CellState::CELL_UNLOADING)
+        {
+            mCellStates[cellId] = CellState::CELL_UNLOADED;
+        }
+    }
+
+    // A load queued behind a failed write reports its own failure
+    for (CellId cellId : failedWrites)
+    {
+        if (cell_state(cellId) == CellState::CELL_UNLOADING)
+        {
+            mCellStates[cellId] = CellState::CELL_ERR_IO;
+        }
+    }
+
+    mMerged.clear();
+
+    while (!mMerging.empty() && mMerged.size() < mMergeBudget)
+    {
+        PendingCell& cell = mMerging.front();
+        bool ok = cell.ok;
+
+        if (ok && cell.offset == 0)
+        {
+            uint32_t magic = 0;
+            uint32_t version = 0;
+
+            ok = read_value(cell.data, cell.offset, magic)
+                && read_value(cell.data, cell.offset, version)
+                && read_value(cell.data, cell.offset, cell.numRemaining)
+                && magic == CELL_FILE_MAGIC
+                && version == CELL_FILE_VERSION;
+        }
+
+        while (ok && cell.numRemaining && mMerged.size() < mMergeBudget)
+        {
+            ok = _merge_entity(cell);
+            --cell.numRemaining;
+        }
+
+        if (!ok)
+        {
+            _discard_merge(cell);
+            mCellStates[cell.cellId] = CellState::CELL_ERR_IO;
+            mMerging.pop_front();
+        }
+        else if (!cell.numRemaining)
+        {
+            mCellStates.erase(cell.cellId);
+            mMerging.pop_front();
+        }
+    }
+
+    return mMerged.size();
+}
+
+
+
+/*-------------------------------------
+ * Number of cells in flight
+-------------------------------------*/
+std::size_t WorldPartition::num_pending_cells() const noexcept
+{
+    return mNumIOJobs + mMerging.size();
+}
+
+
+
+} // end game namespace
+} // end ls namespace
@@ -0,0 +1,526 @@
+
+#include <algorithm> // std::min
+#include <chrono> // std::chrono::steady_clock
+#include <cstdint> // uint64_t
+#include <cstdlib> // std::strtoull
+#include <cstring> // std::strcmp
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lightsky/game/ColumnComponent.hpp"
+#include "lightsky/game/ECSDatabase.hpp"
+#include "lightsky/game/MotionComponent.hpp"
+
+namespace game = ls::game;
+
+
+
+/*-----------------------------------------------------------------------------
+ * Benchmark Components
+-----------------------------------------------------------------------------*/
+class BenchComponentA final : public game::Component
+{
+  public:
+    uint64_t sum = 0;
+
+    virtual void update_entity(const game::Entity& e) noexcept override
+    {
+        sum += e.id;
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(BenchComponentA)
+
+
+
+class BenchComponentB final : public game::Component
+{
+  public:
+    uint64_t sum = 0;
+
+    virtual void update_entity(const game::Entity& e) noexcept override
+    {
+        sum += e.id;
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(BenchComponentB)
+
+
+
+// Holds a network ID per entity.
+class BenchNetworkComponent final : public game::ColumnComponent<uint32_t>
+{
+  public:
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(BenchNetworkComponent)
+
+
+
+/*-----------------------------------------------------------------------------
+ * Benchmark Results
+-----------------------------------------------------------------------------*/
+struct BenchResult
+{
+    std::string name;
+    std::size_t numEntities;
+    std::size_t numOps;
+    double seconds;
+};
+
+struct BenchOptions
+{
+    std::size_t minEntities = 1000;
+    std::size_t maxEntities = 10000000;
+    std::size_t numRuns = 3;
+    std::string jsonPath;
+    std::string csvPath;
+};
+
+// Prevents the compiler from discarding benchmarked work.
+volatile uint64_t gSink = 0;
+
+
+
+/*-------------------------------------
+ * Time a function, keeping the fastest of several runs
+-------------------------------------*/
+template <typename SetupFunc, typename BenchFunc>
+void run_bench(
+    std::vector<BenchResult>& results,
+    const BenchOptions& opts,
+    const char* name,
+    std::size_t numEntities,
+    std::size_t numOps,
+    SetupFunc setup,
+    BenchFunc bench) noexcept
+{
+    double bestTime = 0.0;
+
+    for (std::size_t run = 0; run < opts.numRuns; ++run)
+    {
+        game::ECSDatabase db;
+        std::vector<game::Entity> entities;
+        setup(db, entities);
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bench(db, entities);
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        const double seconds = std::chrono::duration<double>(end - start).count();
+        bestTime = (run == 0) ? seconds : std::min(bestTime, seconds);
+    }
+
+    results.push_back(BenchResult{name, numEntities, numOps, bestTime});
+
+    std::cout
+        << name << ','
+        << numEntities << ','
+        << bestTime << "s,"
+        << (numOps ? (bestTime * 1.0e9 / (double)numOps) : 0.0) << "ns/op"
+        << std::endl;
+}
+
+
+
+/*-------------------------------------
+ * Database setup helpers
+-------------------------------------*/
+void setup_empty(game::ECSDatabase& db, std::vector<game::Entity>&) noexcept
+{
+    db.construct_component<BenchComponentA>();
+    db.construct_component<BenchComponentB>();
+    db.construct_component<game::MotionComponent>();
+    db.construct_component<BenchNetworkComponent>();
+}
+
+
+
+void setup_entities(game::ECSDatabase& db, std::vector<game::Entity>& entities, std::size_t numEntities) noexcept
+{
+    setup_empty(db, entities);
+    entities.reserve(numEntities);
+
+    for (std::size_t i = 0; i < numEntities; ++i)
+    {
+        entities.push_back(db.create_entity());
+    }
+}
+
+
+
+// Every entity is added to component A while every other entity is added
+// to component B.
+void setup_components(game::ECSDatabase& db, std::vector<game::Entity>& entities, std::size_t numEntities) noexcept
+{
+    setup_entities(db, entities, numEntities);
+
+    for (std::size_t i = 0; i < numEntities; ++i)
+    {
+        db.component<BenchComponentA>()->insert(entities[i]);
+
+        if ((i & 1) == 0)
+        {
+            db.component<BenchComponentB>()->insert(entities[i]);
+        }
+    }
+}
+
+
+
+/*-------------------------------------
+ * Run all benchmarks for a world size
+-------------------------------------*/
+void run_all(std::vector<BenchResult>& results, const BenchOptions& opts, std::size_t n) noexcept
+{
+    const auto withEntities = [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        setup_entities(db, entities, n);
+    };
+
+    const auto withComponents = [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        setup_components(db, entities, n);
+    };
+
+    run_bench(results, opts, "create_entity", n, n, setup_empty, [n](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            gSink = gSink + db.create_entity().id;
+        }
+    });
+
+    run_bench(results, opts, "destroy_entity", n, n, withComponents, [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            db.destroy_entity(entities[i]);
+        }
+    });
+
+    run_bench(results, opts, "destroy_deferred", n, n, withComponents, [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            db.destroy_deferred(entities[i]);
+        }
+
+        db.destroy_deferred_entities();
+    });
+
+    run_bench(results, opts, "component_insert", n, n, withEntities, [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        game::Component* pComponent = db.component<BenchComponentA>();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            pComponent->insert(entities[i]);
+        }
+    });
+
+    run_bench(results, opts, "component_erase", n, n, withComponents, [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        game::Component* pComponent = db.component<BenchComponentA>();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            pComponent->erase(entities[i]);
+        }
+    });
+
+    run_bench(results, opts, "iterate_single", n, n, withComponents, [](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        BenchComponentA* pComponent = db.component<BenchComponentA>();
+        pComponent->update();
+        gSink = gSink + pComponent->sum;
+    });
+
+    run_bench(results, opts, "iterate_multi_uncached", n, n, withComponents, [](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        const game::EntitySet* pEntities = db.query<BenchComponentA, BenchComponentB>();
+        for (std::size_t i = 0; i < pEntities->size(); ++i)
+        {
+            gSink = gSink + (*pEntities)[i].id;
+        }
+    });
+
+    const auto withBitmaps = [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        setup_components(db, entities, n);
+        db.query_bitmap_threshold(2);
+    };
+
+    run_bench(results, opts, "iterate_multi_bitmap", n, n, withBitmaps, [](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        const game::EntitySet* pEntities = db.query<BenchComponentA, BenchComponentB>();
+        for (std::size_t i = 0; i < pEntities->size(); ++i)
+        {
+            gSink = gSink + (*pEntities)[i].id;
+        }
+    });
+
+    const auto withQuery = [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        setup_components(db, entities, n);
+        db.query<BenchComponentA, BenchComponentB>();
+    };
+
+    run_bench(results, opts, "iterate_multi_cached", n, n, withQuery, [](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        const game::EntitySet* pEntities = db.query<BenchComponentA, BenchComponentB>();
+        for (std::size_t i = 0; i < pEntities->size(); ++i)
+        {
+            gSink = gSink + (*pEntities)[i].id;
+        }
+    });
+
+    const auto withMotion = [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        setup_entities(db, entities, n);
+        game::MotionComponent* pMotion = db.component<game::MotionComponent>();
+        pMotion->time_step(1.f / 60.f);
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            pMotion->insert(entities[i]);
+            pMotion->velocity(entities[i], ls::math::vec3{1.f, 2.f, 3.f});
+        }
+    };
+
+    run_bench(results, opts, "integrate_motion", n, n, withMotion, [](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        game::MotionComponent* pMotion = db.component<game::MotionComponent>();
+        pMotion->update();
+        gSink = gSink + (uint64_t)pMotion->get<game::MotionComponent::POSITION_X>(game::Entity{0});
+    });
+
+    // Every other entity is destroyed, leaving half of all IDs as holes.
+    const auto withHoles = [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        setup_components(db, entities, n);
+
+        for (std::size_t i = 0; i < n; i += 2)
+        {
+            db.destroy_entity(entities[i]);
+        }
+    };
+
+    run_bench(results, opts, "compact", n, n/2, withHoles, [](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        while (db.compact() == game::ECSCompactStatus::COMPACT_IN_PROGRESS)
+        {
+        }
+
+        gSink = gSink + db.compact_remap().size();
+    });
+
+    const auto withNetworkIds = [n](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        setup_entities(db, entities, n);
+        BenchNetworkComponent* pNetwork = db.component<BenchNetworkComponent>();
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            pNetwork->insert(entities[i]);
+            pNetwork->set<0>(entities[i], (uint32_t)(i * 7u));
+        }
+    };
+
+    // Scanning is linear per lookup, so only a few lookups are timed
+    run_bench(results, opts, "find_scan", n, 16, withNetworkIds, [n](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        BenchNetworkComponent* pNetwork = db.component<BenchNetworkComponent>();
+        std::vector<game::Entity> found;
+
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            pNetwork->find<0>((uint32_t)((i * n / 16) * 7u), found);
+        }
+
+        gSink = gSink + found.size();
+    });
+
+    const auto withNetworkIndex = [&withNetworkIds](game::ECSDatabase& db, std::vector<game::Entity>& entities) noexcept->void
+    {
+        withNetworkIds(db, entities);
+        std::vector<game::Entity> found;
+
+        // The first lookup builds the index
+        db.component<BenchNetworkComponent>()->add_hash_index<0>();
+        db.component<BenchNetworkComponent>()->find<0>(0u, found);
+    };
+
+    run_bench(results, opts, "find_indexed", n, n, withNetworkIndex, [n](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        BenchNetworkComponent* pNetwork = db.component<BenchNetworkComponent>();
+        std::vector<game::Entity> found;
+        found.reserve(n);
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            pNetwork->find<0>((uint32_t)(i * 7u), found);
+        }
+
+        gSink = gSink + found.size();
+    });
+
+    run_bench(results, opts, "random_contains", n, n, withComponents, [n](game::ECSDatabase& db, std::vector<game::Entity>&) noexcept->void
+    {
+        const game::Component* pComponent = db.component<BenchComponentB>();
+        std::mt19937_64 rng{n};
+        std::uniform_int_distribution<game::EntityIdType> dist{0, (game::EntityIdType)(n-1)};
+        uint64_t numFound = 0;
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            numFound += pComponent->contains(game::Entity{dist(rng)});
+        }
+
+        gSink = gSink + numFound;
+    });
+}
+
+
+
+/*-------------------------------------
+ * Write results as JSON
+-------------------------------------*/
+bool write_json(const std::string& path, const std::vector<BenchResult>& results) noexcept
+{
+    std::ofstream out{path};
+    if (!out)
+    {
+        return false;
+    }
+
+    out << "[\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& r = results[i];
+        out
+            << "  {\"benchmark\": \"" << r.name
+            << "\", \"entities\": " << r.numEntities
+            << ", \"operations\": " << r.numOps
+            << ", \"seconds\": " << r.seconds
+            << ", \"ns_per_op\": " << (r.numOps ? (r.seconds * 1.0e9 / (double)r.numOps) : 0.0)
+            << ((i+1 < results.size()) ? "},\n" : "}\n");
+    }
+
+    out << "]\n";
+
+    return (bool)out;
+}
+
+
+
+/*-------------------------------------
+ * Write results as CSV
+-------------------------------------*/
+bool write_csv(const std::string& path, const std::vector<BenchResult>& results) noexcept
+{
+    std::ofstream out{path};
+    if (!out)
+    {
+        return false;
+    }
+
+    out << "benchmark,entities,operations,seconds,ns_per_op\n";
+
+    for (const BenchResult& r : results)
+    {
+        out
+            << r.name << ','
+            << r.numEntities << ','
+            << r.numOps << ','
+            << r.seconds << ','
+            << (r.numOps ? (r.seconds * 1.0e9 / (double)r.numOps) : 0.0) << '\n';
+    }
+
+    return (bool)out;
+}
+
+
+
+/*-------------------------------------
+ * Command-line parsing
+-------------------------------------*/
+bool parse_args(int argc, char** argv, BenchOptions& opts) noexcept
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = (i+1) < argc;
+
+        if (hasValue && std::strcmp(argv[i], "--min") == 0)
+        {
+            opts.minEntities = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (hasValue && std::strcmp(argv[i], "--max") == 0)
+        {
+            opts.maxEntities = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (hasValue && std::strcmp(argv[i], "--runs") == 0)
+        {
+            opts.numRuns = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (hasValue && std::strcmp(argv[i], "--json") == 0)
+        {
+            opts.jsonPath = argv[++i];
+        }
+        else if (hasValue && std::strcmp(argv[i], "--csv") == 0)
+        {
+            opts.csvPath = argv[++i];
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return opts.minEntities > 0 && opts.minEntities <= opts.maxEntities && opts.numRuns > 0;
+}
+
+
+
+int main(int argc, char** argv)
+{
+    BenchOptions opts;
+
+    if (!parse_args(argc, argv, opts))
+    {
+        std::cerr
+            << "Usage: " << argv[0]
+            << " [--min N] [--max N] [--runs N] [--json FILE] [--csv FILE]\n"
+            << "Entity counts increase by 10x from --min (default 1000) to --max (default 10000000)."
+            << std::endl;
+        return -1;
+    }
+
+    std::vector<BenchResult> results;
+    std::cout << "benchmark,entities,seconds,ns_per_op" << std::endl;
+
+    for (std::size_t n = opts.minEntities; n <= opts.maxEntities; n *= 10)
+    {
+        run_all(results, opts, n);
+    }
+
+    if (!opts.jsonPath.empty() && !write_json(opts.jsonPath, results))
+    {
+        std::cerr << "Unable to write JSON results to " << opts.jsonPath << std::endl;
+        return -2;
+    }
+
+    if (!opts.csvPath.empty() && !write_csv(opts.csvPath, results))
+    {
+        std::cerr << "Unable to write CSV results to " << opts.csvPath << std::endl;
+        return -3;
+    }
+
+    return 0;
+}
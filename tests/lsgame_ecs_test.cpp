@@ -1,10 +1,26 @@
+#include <cmath> // std::abs
+#include <cstdio> // std::remove
+#include <cstdlib> // std::getenv
 #include <iostream>
+#include <sstream>
+#include <thread>
 
 #include "lightsky/setup/Macros.h" // LS_STRINGIFY
 
 #include "lightsky/utils/Assertions.h"
 
+#include "lightsky/game/BoundsComponent.hpp"
+#include "lightsky/game/ColumnComponent.hpp"
+#include "lightsky/game/Dispatcher.h"
 #include "lightsky/game/ECSDatabase.hpp"
+#include "lightsky/game/MotionComponent.hpp"
+#include "lightsky/game/RollbackBuffer.hpp"
+#include "lightsky/game/SharedComponent.hpp"
+#include "lightsky/game/SplitComponent.hpp"
+#include "lightsky/game/StableComponent.hpp"
+#include "lightsky/game/SweepAndPrune.hpp"
+#include "lightsky/game/Tracer.hpp"
+#include "lightsky/game/WorldPartition.hpp"
 
 namespace game = ls::game;
 
@@ -50,6 +66,195 @@ LS_GAME_REGISTER_COMPONENT(PrintErrComponent)
 
 
 
+class VelocityComponent final : public game::ColumnComponent<float, float>
+{
+  public:
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+
+    // Integrates each velocity column by whole chunks.
+    virtual void update() noexcept override
+    {
+        for (std::size_t c = 0; c < num_chunks(); ++c)
+        {
+            float* const pX = writable_column<0>(c);
+            const float* const pY = column<1>(c);
+
+            for (std::size_t i = 0; i < CHUNK_SIZE; ++i)
+            {
+                pX[i] += pY[i];
+            }
+        }
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(VelocityComponent)
+
+
+
+class VisitCountComponent final : public game::Component
+{
+  public:
+    std::size_t numVisits = 0;
+
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+        ++numVisits;
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(VisitCountComponent)
+
+
+
+class VisitOrderComponent final : public game::Component
+{
+  public:
+    std::vector<game::Entity> visits;
+
+    virtual void update_entity(const game::Entity& e) noexcept override
+    {
+        visits.push_back(e);
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(VisitOrderComponent)
+
+
+
+// Simulates running out of memory while removing entities.
+class FailingEraseComponent final : public game::Component
+{
+  public:
+    bool failErase = false;
+
+    virtual bool erase_data(std::size_t) noexcept override
+    {
+        return !failErase;
+    }
+
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(FailingEraseComponent)
+
+
+
+// Keeps the index of each entity in packed order, optionally failing to
+// move them.
+class FailingSwapComponent final : public game::Component
+{
+  public:
+    bool failSwap = false;
+
+    std::vector<game::EntityIdType> rows;
+
+  protected:
+    virtual bool insert_data(std::size_t index) noexcept override
+    {
+        rows.push_back(game::entity_index(mEntities[index]));
+        return true;
+    }
+
+    virtual bool erase_data(std::size_t index) noexcept override
+    {
+        rows[index] = rows.back();
+        rows.pop_back();
+        return true;
+    }
+
+    virtual void clear_data() noexcept override
+    {
+        rows.clear();
+    }
+
+    virtual bool swap_data(std::size_t indexA, std::size_t indexB) noexcept override
+    {
+        if (failSwap)
+        {
+            return false;
+        }
+
+        std::swap(rows[indexA], rows[indexB]);
+        return true;
+    }
+
+  public:
+    bool is_aligned() const noexcept
+    {
+        for (std::size_t i = 0; i < size(); ++i)
+        {
+            if (rows[i] != game::entity_index(entities()[i]))
+            {
+                return false;
+            }
+        }
+
+        return rows.size() == size();
+    }
+
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(FailingSwapComponent)
+
+
+
+// Holds a network ID and team per entity.
+class NetworkComponent final : public game::ColumnComponent<uint32_t, int>
+{
+  public:
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(NetworkComponent)
+
+
+
+// Keeps a hot speed column and a cold, quantized health percentage.
+class CreatureComponent final : public game::SplitComponent<game::QuantizedCodec<uint16_t, 0, 100>, float>
+{
+  public:
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(CreatureComponent)
+
+
+
+class MaterialComponent final : public game::SharedComponent<int>
+{
+  public:
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(MaterialComponent)
+
+
+
+class HealthComponent final : public game::StableComponent<int>
+{
+  public:
+    virtual void update_entity(const game::Entity&) noexcept override
+    {
+    }
+};
+
+LS_GAME_REGISTER_COMPONENT(HealthComponent)
+
+
+
 void update_components(game::ECSDatabase& db) noexcept
 {
     std::cout << "Updating components:" << std::endl;
@@ -182,5 +387,838 @@ int main()
         return -6;
     }
 
+    game::ECSDatabase dbClone = {};
+    if (db.clone(dbClone) != game::ECSCloneStatus::CLONE_OK)
+    {
+        std::cerr << "Unable to clone the ECS Database." << std::endl;
+        return -7;
+    }
+
+    // clones share component pages until either database modifies them
+    dbClone.component<PrintErrComponent>()->erase(e3);
+    LS_ASSERT(true == db.component<PrintErrComponent>()->contains(e3));
+    LS_ASSERT(false == dbClone.component<PrintErrComponent>()->contains(e3));
+    LS_ASSERT(dbClone.component<PrintStdoutComponent>()->size() == 1);
+    std::cout << "Successfully cloned the ECS Database." << std::endl;
+
+    {
+        game::PagedArray<int> values;
+        for (int i = 0; i < 10; ++i)
+        {
+            LS_ASSERT(values.push_back(i));
+        }
+
+        // Popping from a shared page must not duplicate it
+        game::PagedArray<int> valuesCopy = values;
+        valuesCopy.pop_back();
+        LS_ASSERT(valuesCopy.is_page_shared(0) && values[9] == 9);
+        LS_ASSERT(valuesCopy.resize(10) && valuesCopy[9] == 0 && values[9] == 9);
+    }
+
+    game::RollbackBuffer history{dbClone, 8};
+    history.save_tick(1);
+    game::Entity e4 = dbClone.create_entity();
+    dbClone.component<PrintStdoutComponent>()->insert(e4);
+    history.save_tick(2);
+
+    if (!history.rollback_to(1) || dbClone.component<PrintStdoutComponent>()->contains(e4))
+    {
+        std::cerr << "Unable to roll back the ECS Database." << std::endl;
+        return -8;
+    }
+    LS_ASSERT(dbClone.create_entity().id == e4.id);
+
+    // Handle generations are restored along with the entity table
+    LS_ASSERT(history.rollback_to(1));
+    const game::Entity eRetired = dbClone.create_entity();
+    game::Entity eDestroyed = eRetired;
+    dbClone.destroy_entity(eDestroyed);
+    LS_ASSERT(history.rollback_to(1) && dbClone.create_entity().id == eRetired.id);
+    std::cout << "Successfully rolled back the ECS Database." << std::endl;
+
+    {
+        game::EntityBlock workerBlock{db, 16};
+        game::Entity e5 = workerBlock.create_entity();
+        game::Entity e6 = db.create_entity();
+        LS_ASSERT(e5.id != e6.id);
+        LS_ASSERT(workerBlock.num_pending() == 1);
+
+        db.sync_entities();
+        LS_ASSERT(workerBlock.num_pending() == 0);
+        LS_ASSERT(db.component<PrintErrComponent>()->insert(e5) == game::ComponentAddStatus::ADD_OK);
+        db.destroy_entity(e5);
+        std::cout << "Successfully created entities from an entity block." << std::endl;
+    }
+
+    LS_ASSERT(db.enable_snapshots<PrintErrComponent>());
+    db.publish_snapshots();
+    db.component<PrintErrComponent>()->erase(e3);
+    LS_ASSERT(db.snapshot<PrintErrComponent>()->contains(e3));
+    db.publish_snapshots();
+    LS_ASSERT(!db.snapshot<PrintErrComponent>()->contains(e3));
+    LS_ASSERT(db.snapshot<PrintStdoutComponent>() == nullptr);
+    std::cout << "Successfully published component snapshots." << std::endl;
+
+    const game::EntitySet* pBoth = db.query<PrintStdoutComponent, PrintErrComponent>();
+    LS_ASSERT(pBoth != nullptr && pBoth->size() == 1 && pBoth->contains(e0));
+    db.component<PrintStdoutComponent>()->insert(e2);
+    LS_ASSERT(pBoth->size() == 2 && pBoth->contains(e2));
+    db.component<PrintErrComponent>()->erase(e0);
+    LS_ASSERT(pBoth->size() == 1 && !pBoth->contains(e0));
+    LS_ASSERT((db.query<PrintErrComponent, PrintStdoutComponent>() == pBoth));
+    std::cout << "Successfully queried multiple components." << std::endl;
+
+    LS_ASSERT((db.track_query<PrintStdoutComponent, PrintErrComponent>()));
+    db.component<PrintErrComponent>()->insert(e0);
+    db.component<PrintStdoutComponent>()->erase(e2);
+    LS_ASSERT((db.query_entered<PrintStdoutComponent, PrintErrComponent>()->contains(e0)));
+    LS_ASSERT((db.query_left<PrintStdoutComponent, PrintErrComponent>()->contains(e2)));
+    db.clear_query_changes();
+    LS_ASSERT((db.query_entered<PrintStdoutComponent, PrintErrComponent>()->empty()));
+    LS_ASSERT((db.query_left<PrintStdoutComponent, PrintErrComponent>()->empty()));
+    std::cout << "Successfully tracked query changes." << std::endl;
+
+    game::Entity e7 = e0;
+    LS_ASSERT(db.destroy_deferred(e7));
+    LS_ASSERT(!db.destroy_deferred(e7));
+    LS_ASSERT(!pBoth->contains(e0));
+    LS_ASSERT(db.component<PrintStdoutComponent>()->contains(e0));
+    db.destroy_deferred_entities();
+    LS_ASSERT(db.num_deferred_entities() == 0);
+    LS_ASSERT(db.num_components(e0) == 0);
+    LS_ASSERT(game::entity_index(db.create_entity()) == game::entity_index(e0));
+    std::cout << "Successfully destroyed deferred entities." << std::endl;
+
+    const game::ECSMemoryStats memStats = db.memory_stats();
+    LS_ASSERT(memStats.componentStats.size() == 2);
+    LS_ASSERT(memStats.entities.usedBytes >= db.component<PrintErrComponent>()->size() * sizeof(game::Entity));
+    LS_ASSERT(memStats.total().reservedBytes >= memStats.total().usedBytes);
+    std::cout << "Successfully retrieved " << memStats.total().reservedBytes << " bytes of memory statistics." << std::endl;
+
+    update_components(db);
+    game::ComponentTiming timing;
+    #ifdef LS_GAME_ENABLE_PROFILING
+        LS_ASSERT(db.update_timing<PrintErrComponent>(timing));
+        LS_ASSERT(timing.numUpdates > 0 && timing.lastEntities == db.component<PrintErrComponent>()->size());
+        LS_ASSERT(db.update_timings().size() == 2);
+    #else
+        LS_ASSERT(!db.update_timing<PrintErrComponent>(timing));
+    #endif
+    std::cout << "Successfully retrieved component update timings." << std::endl;
+
+    game::Tracer& tracer = game::Tracer::global();
+    tracer.enable(true);
+    update_components(db);
+    tracer.enable(false);
+
+    std::ostringstream traceJson;
+    LS_ASSERT(tracer.write_chrome_trace(traceJson));
+    #ifdef LS_GAME_ENABLE_PROFILING
+        LS_ASSERT(tracer.num_events() == 2);
+        LS_ASSERT(traceJson.str().find("\"Component::update\"") != std::string::npos);
+    #else
+        LS_ASSERT(tracer.num_events() == 0);
+    #endif
+    std::cout << "Successfully exported a Chrome trace." << std::endl;
+
+    LS_ASSERT(db.construct_component<VelocityComponent>() == game::ComponentCreateStatus::REGISTER_OK);
+    VelocityComponent* pVelocities = db.component<VelocityComponent>();
+    game::Entity v0 = db.create_entity();
+    game::Entity v1 = db.create_entity();
+    LS_ASSERT(pVelocities->insert(v0) == game::ComponentAddStatus::ADD_OK);
+    LS_ASSERT(pVelocities->insert(v1) == game::ComponentAddStatus::ADD_OK);
+    LS_ASSERT(pVelocities->set<1>(v0, 1.f) && pVelocities->set<1>(v1, 2.f));
+    pVelocities->update();
+    LS_ASSERT(((std::uintptr_t)pVelocities->column<0>(0) % VelocityComponent::CHUNK_ALIGNMENT) == 0);
+    LS_ASSERT(pVelocities->num_chunks() == 1 && pVelocities->chunk_size(0) == 2);
+    LS_ASSERT(pVelocities->erase(v0) == game::ComponentRemoveStatus::REMOVE_OK);
+    LS_ASSERT(pVelocities->chunk_entities(0)[0].id == v1.id);
+    LS_ASSERT(pVelocities->get<0>(v1) == 2.f && pVelocities->get<1>(v1) == 2.f);
+    std::cout << "Successfully updated column component chunks." << std::endl;
+
+    LS_ASSERT(db.construct_component<game::MotionComponent>() == game::ComponentCreateStatus::REGISTER_OK);
+    game::MotionComponent* pMotion = db.component<game::MotionComponent>();
+    for (game::EntityIdType i = 0; i < 5; ++i)
+    {
+        const game::Entity m = db.create_entity();
+        LS_ASSERT(pMotion->insert(m) == game::ComponentAddStatus::ADD_OK);
+        LS_ASSERT(pMotion->position(m, ls::math::vec3{1.f, 2.f, 3.f}));
+        LS_ASSERT(pMotion->velocity(m, ls::math::vec3{(float)i, -1.f, 0.5f}));
+    }
+    pMotion->time_step(2.f);
+    pMotion->update();
+    const game::Entity lastMover = pMotion->chunk_entities(0)[4];
+    LS_ASSERT(pMotion->position(lastMover)[0] == 9.f && pMotion->position(lastMover)[1] == 0.f && pMotion->position(lastMover)[2] == 4.f);
+    std::cout << "Successfully integrated motion components." << std::endl;
+
+    LS_ASSERT(db.construct_component<game::BoundsComponent>() == game::ComponentCreateStatus::REGISTER_OK);
+    game::BoundsComponent* pBounds = db.component<game::BoundsComponent>();
+    game::Entity boxes[3] = {db.create_entity(), db.create_entity(), db.create_entity()};
+    for (game::EntityIdType i = 0; i < 3; ++i)
+    {
+        const float x = (float)i * 1.5f;
+        LS_ASSERT(pBounds->insert(boxes[i]) == game::ComponentAddStatus::ADD_OK);
+        LS_ASSERT(pBounds->bounds(boxes[i], ls::math::vec3{x, 0.f, 0.f}, ls::math::vec3{x+1.f, 1.f, 1.f}));
+    }
+
+    game::SweepAndPrune broadphase;
+    LS_ASSERT(broadphase.update(*pBounds) && broadphase.sweep().empty());
+    LS_ASSERT(pBounds->bounds(boxes[2], ls::math::vec3{0.5f, 0.5f, 0.5f}, ls::math::vec3{1.f, 1.f, 1.f}));
+    LS_ASSERT(broadphase.update(*pBounds) && broadphase.sweep().size() == 1);
+    LS_ASSERT(broadphase.pairs()[0].a.id == boxes[0].id && broadphase.pairs()[0].b.id == boxes[2].id);
+
+    // Split sweeps run on the caller's threads and merge to the same pairs
+    std::vector<game::EntityPair> jobPairs[2];
+    std::thread sweepWorker{[&]()->void
+    {
+        broadphase.sweep_job(1, 2, jobPairs[1]);
+    }};
+    broadphase.sweep_job(0, 2, jobPairs[0]);
+    sweepWorker.join();
+    LS_ASSERT(broadphase.merge_jobs(jobPairs, 2).size() == 1 && broadphase.pairs()[0].b.id == boxes[2].id);
+
+    game::Dispatcher pairEvents;
+    broadphase.dispatch_pairs(pairEvents, 1);
+    LS_ASSERT(pairEvents.num_queued_events() == 1);
+    std::cout << "Successfully found broadphase pairs." << std::endl;
+
+    // Reversing every box exceeds the swap limit and falls back to a full sort
+    {
+        std::vector<game::Entity> farBoxes;
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            const float x = 10.f + (float)i * 2.f;
+            farBoxes.push_back(db.create_entity());
+            LS_ASSERT(pBounds->insert(farBoxes.back()) == game::ComponentAddStatus::ADD_OK);
+            LS_ASSERT(pBounds->bounds(farBoxes.back(), ls::math::vec3{x, 0.f, 0.f}, ls::math::vec3{x+1.f, 1.f, 1.f}));
+        }
+        LS_ASSERT(broadphase.update(*pBounds) && broadphase.sweep().size() == 1);
+
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            const float x = 10.f + (float)i * 2.f;
+            LS_ASSERT(pBounds->bounds(farBoxes[i], ls::math::vec3{-x-1.f, 0.f, 0.f}, ls::math::vec3{-x, 1.f, 1.f}));
+        }
+        LS_ASSERT(broadphase.update(*pBounds) && broadphase.sweep().size() == 1);
+        LS_ASSERT(broadphase.pairs()[0].a.id == boxes[0].id && broadphase.pairs()[0].b.id == boxes[2].id);
+
+        for (game::Entity& e : farBoxes)
+        {
+            db.destroy_entity(e);
+        }
+        LS_ASSERT(broadphase.update(*pBounds) && broadphase.sweep().size() == 1);
+    }
+    std::cout << "Successfully re-sorted an incoherent broadphase frame." << std::endl;
+
+    game::ECSDatabase sparseDb;
+    sparseDb.construct_component<VelocityComponent>();
+    game::Entity scattered[8];
+    for (game::Entity& e : scattered)
+    {
+        e = sparseDb.create_entity();
+        sparseDb.component<VelocityComponent>()->insert(e);
+        sparseDb.component<VelocityComponent>()->set<0>(e, (float)e.id);
+    }
+    for (std::size_t i = 0; i < 6; ++i)
+    {
+        sparseDb.destroy_entity(scattered[i]);
+    }
+
+    game::ECSCompactStatus compactStatus;
+    do
+    {
+        compactStatus = sparseDb.compact(2);
+    }
+    while (compactStatus == game::ECSCompactStatus::COMPACT_IN_PROGRESS);
+
+    LS_ASSERT(compactStatus == game::ECSCompactStatus::COMPACT_DONE);
+    LS_ASSERT(sparseDb.compact_remap().size() == 2);
+    for (const game::EntityRemap& remap : sparseDb.compact_remap())
+    {
+        LS_ASSERT(game::entity_index(remap.to) < 2 && sparseDb.component<VelocityComponent>()->get<0>(remap.to) == (float)remap.from.id);
+    }
+    LS_ASSERT(game::entity_index(sparseDb.component<VelocityComponent>()->chunk_entities(0)[0]) == 0);
+    std::cout << "Successfully compacted " << sparseDb.compact_remap().size() << " entities." << std::endl;
+
+    {
+        game::ECSDatabase swapDb;
+        swapDb.construct_component<FailingSwapComponent>();
+        FailingSwapComponent* pRows = swapDb.component<FailingSwapComponent>();
+        std::vector<game::Entity> created;
+
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            created.push_back(swapDb.create_entity());
+        }
+
+        for (std::size_t i = created.size(); i--;)
+        {
+            pRows->insert(created[i]);
+        }
+
+        // A failed move leaves every entity next to its own data
+        pRows->failSwap = true;
+        LS_ASSERT(swapDb.compact(16) == game::ECSCompactStatus::COMPACT_ERR_NO_MEMORY);
+        LS_ASSERT(pRows->is_aligned() && game::entity_index(pRows->entities()[0]) == 7);
+
+        pRows->failSwap = false;
+        while (swapDb.compact(16) == game::ECSCompactStatus::COMPACT_IN_PROGRESS)
+        {
+        }
+
+        LS_ASSERT(pRows->is_aligned() && game::entity_index(pRows->entities()[0]) == 0);
+        std::cout << "Successfully kept entities aligned through a failed compaction." << std::endl;
+    }
+
+    {
+        game::ECSDatabase handleDb;
+        handleDb.construct_component<VelocityComponent>();
+        game::Entity stale = handleDb.create_entity();
+        const game::Entity staleCopy = stale;
+        handleDb.destroy_entity(stale);
+
+        const game::Entity recycled = handleDb.create_entity();
+        handleDb.component<VelocityComponent>()->insert(recycled);
+        LS_ASSERT(game::entity_index(recycled) == game::entity_index(staleCopy));
+        LS_ASSERT(handleDb.component<VelocityComponent>()->contains(staleCopy) == (game::ENTITY_GENERATION_BITS == 0));
+        std::cout << "Successfully recycled a " << sizeof(game::Entity) * 8 << "-bit entity handle." << std::endl;
+    }
+
+    {
+        const char* pTempDir = std::getenv("TMPDIR");
+        game::WorldPartition world{sparseDb, pTempDir ? pTempDir : "/tmp"};
+        const game::CellId cell = game::WorldPartition::cell_at(ls::math::vec3{10.f, 0.f, -10.f}, 8.f);
+        LS_ASSERT(world.start());
+        const game::Entity* pCellEntities = sparseDb.component<VelocityComponent>()->chunk_entities(0);
+        LS_ASSERT(world.assign(pCellEntities[0], cell) && world.assign(pCellEntities[1], cell));
+        const game::Entity sleeper = pCellEntities[0];
+        LS_ASSERT(sparseDb.sleep_entity(sleeper));
+        const float dormantVelocity = sparseDb.component<VelocityComponent>()->get<0>(sleeper);
+        LS_ASSERT(world.unload(cell) && sparseDb.num_dormant_entities() == 0 && sparseDb.component<VelocityComponent>()->size() == 0);
+
+        while (world.cell_state(cell) == game::CellState::CELL_UNLOADING)
+        {
+            world.sync();
+            std::this_thread::yield();
+        }
+
+        LS_ASSERT(world.cell_state(cell) == game::CellState::CELL_UNLOADED && world.load(cell));
+        world.merge_budget(0);
+        LS_ASSERT(world.merge_budget() == 1);
+
+        while (world.cell_state(cell) == game::CellState::CELL_LOADING)
+        {
+            LS_ASSERT(world.sync() <= 1);
+            std::this_thread::yield();
+        }
+
+        LS_ASSERT(world.cell_state(cell) == game::CellState::CELL_LOADED);
+        LS_ASSERT(sparseDb.component<VelocityComponent>()->size() == 2);
+        const VelocityComponent* pVelocities = sparseDb.component<VelocityComponent>();
+        LS_ASSERT(pVelocities->get<0>(pVelocities->chunk_entities(0)[0]) + pVelocities->get<0>(pVelocities->chunk_entities(0)[1]) == 13.f);
+
+        // Dormancy is stored with the cell
+        LS_ASSERT(sparseDb.num_dormant_entities() == 1 && pVelocities->num_active() == 1);
+        LS_ASSERT(pVelocities->get<0>(pVelocities->entities()[1]) == dormantVelocity);
+        LS_ASSERT(sparseDb.is_dormant(pVelocities->entities()[1]));
+        std::cout << "Successfully streamed a world cell." << std::endl;
+
+        // Destroyed entities leave their cell, so a reused ID is untouched
+        const game::CellId staleCell = game::WorldPartition::cell_at(ls::math::vec3{100.f, 0.f, 100.f}, 8.f);
+        game::Entity assigned = sparseDb.create_entity();
+        const game::Entity assignedCopy = assigned;
+        LS_ASSERT(world.assign(assigned, staleCell));
+        sparseDb.destroy_entity(assigned);
+
+        const game::Entity reused = sparseDb.create_entity();
+        LS_ASSERT(game::entity_index(reused) == game::entity_index(assignedCopy));
+        LS_ASSERT(sparseDb.component<VelocityComponent>()->insert(reused) == game::ComponentAddStatus::ADD_OK);
+        game::CellId reusedCell;
+        LS_ASSERT(!world.cell_of(reused, reusedCell) && world.unload(staleCell));
+        LS_ASSERT(sparseDb.component<VelocityComponent>()->contains(reused));
+
+        while (world.cell_state(staleCell) == game::CellState::CELL_UNLOADING)
+        {
+            world.sync();
+            std::this_thread::yield();
+        }
+
+        LS_ASSERT(world.cell_state(staleCell) == game::CellState::CELL_UNLOADED);
+        LS_ASSERT(std::remove(world.cell_path(cell).c_str()) == 0 && std::remove(world.cell_path(staleCell).c_str()) == 0);
+        std::cout << "Successfully kept a reused entity out of a stale cell." << std::endl;
+    }
+
+    {
+        game::ECSDatabase slicedDb;
+        slicedDb.construct_component<VisitCountComponent>();
+        VisitCountComponent* pVisits = slicedDb.component<VisitCountComponent>();
+
+        for (unsigned i = 0; i < 10; ++i)
+        {
+            pVisits->insert(slicedDb.create_entity());
+        }
+
+        pVisits->update_slices(4);
+        pVisits->update();
+        LS_ASSERT(pVisits->numVisits == 3 && pVisits->update_cursor() == 3);
+
+        #ifdef LS_GAME_ENABLE_PROFILING
+            game::ComponentTiming slicedTiming;
+            LS_ASSERT(slicedDb.update_timing<VisitCountComponent>(slicedTiming) && slicedTiming.lastEntities == 3);
+        #endif
+
+        for (unsigned i = 0; i < 3; ++i)
+        {
+            pVisits->update();
+        }
+        LS_ASSERT(pVisits->numVisits == 12 && pVisits->update_cursor() == 2);
+
+        pVisits->update_slices(1);
+        pVisits->update_budget(1000000);
+        pVisits->update();
+        LS_ASSERT(pVisits->numVisits == 22 && pVisits->update_cursor() == 2);
+
+        // The budget is only checked between groups of entities
+        for (unsigned i = 0; i < 90; ++i)
+        {
+            pVisits->insert(slicedDb.create_entity());
+        }
+
+        pVisits->update_budget(1);
+        pVisits->update();
+        const std::size_t numBudgeted = pVisits->numVisits - 22;
+        LS_ASSERT(numBudgeted >= game::Component::UPDATE_BUDGET_INTERVAL);
+        LS_ASSERT(numBudgeted % game::Component::UPDATE_BUDGET_INTERVAL == 0 || numBudgeted == 100);
+        std::cout << "Successfully time-sliced a component update." << std::endl;
+    }
+
+    {
+        game::ECSDatabase failDb;
+        failDb.construct_component<FailingEraseComponent>();
+        FailingEraseComponent* pFailing = failDb.component<FailingEraseComponent>();
+        const game::Entity kept = failDb.create_entity();
+        const game::Entity deferred = failDb.create_entity();
+        pFailing->insert(kept);
+        pFailing->insert(deferred);
+
+        // Entities which cannot leave a component keep their IDs
+        pFailing->failErase = true;
+        game::Entity handle = kept;
+        LS_ASSERT(!failDb.destroy_entity(handle) && handle.id == kept.id && pFailing->contains(kept));
+
+        handle = deferred;
+        LS_ASSERT(failDb.destroy_deferred(handle));
+        failDb.destroy_deferred_entities();
+        LS_ASSERT(failDb.num_deferred_entities() == 1 && pFailing->contains(deferred));
+        LS_ASSERT(game::entity_index(failDb.create_entity()) == 2);
+
+        pFailing->failErase = false;
+        failDb.destroy_deferred_entities();
+        handle = kept;
+        LS_ASSERT(failDb.destroy_entity(handle) && pFailing->size() == 0);
+        LS_ASSERT(failDb.num_deferred_entities() == 0 && game::entity_index(failDb.create_entity()) == 0);
+        std::cout << "Successfully kept entities alive after a failed removal." << std::endl;
+    }
+
+    {
+        game::ECSDatabase batchDb;
+        batchDb.construct_component<VisitCountComponent>();
+        batchDb.construct_component<VisitOrderComponent>();
+        VisitCountComponent* pCounts = batchDb.component<VisitCountComponent>();
+        VisitOrderComponent* pOrders = batchDb.component<VisitOrderComponent>();
+        std::vector<game::Entity> entities;
+
+        for (unsigned i = 0; i < 64; ++i)
+        {
+            entities.push_back(batchDb.create_entity());
+            pCounts->insert(entities.back());
+            pOrders->insert(entities.back());
+        }
+
+        LS_ASSERT(batchDb.sleep_entity(entities[5]) && batchDb.sleep_entity(entities[60]));
+        const game::EntitySet* pBoth = batchDb.query<VisitCountComponent, VisitOrderComponent>();
+        LS_ASSERT(pBoth->size() == 64);
+
+        // A small batch patches the cached query, a large one rebuilds it
+        game::Entity handle = entities[60];
+        LS_ASSERT(batchDb.destroy_deferred(handle));
+        handle = entities[3];
+        LS_ASSERT(batchDb.destroy_deferred(handle));
+        batchDb.destroy_deferred_entities();
+        LS_ASSERT(pBoth->size() == 62 && !pBoth->contains(entities[60]) && !pBoth->contains(entities[3]));
+
+        for (unsigned i = 0; i < 64; i += 2)
+        {
+            if (i != 60)
+            {
+                handle = entities[i];
+                LS_ASSERT(batchDb.destroy_deferred(handle));
+            }
+        }
+
+        batchDb.destroy_deferred_entities();
+        pBoth = batchDb.query<VisitCountComponent, VisitOrderComponent>();
+        LS_ASSERT(pBoth->size() == 31 && pCounts->size() == 31 && pOrders->size() == 31);
+
+        for (unsigned i = 1; i < 64; i += 2)
+        {
+            LS_ASSERT(i == 3 || (pBoth->contains(entities[i]) && pCounts->contains(entities[i])));
+        }
+
+        LS_ASSERT(pCounts->num_active() == 30 && !pCounts->is_active(entities[5]));
+        std::cout << "Successfully destroyed a batch of deferred entities." << std::endl;
+    }
+
+    {
+        game::ECSDatabase lruDb;
+        lruDb.construct_component<VisitCountComponent>();
+        lruDb.construct_component<VisitOrderComponent>();
+        lruDb.construct_component<FailingEraseComponent>();
+
+        for (unsigned i = 0; i < 3000; ++i)
+        {
+            const game::Entity e = lruDb.create_entity();
+            lruDb.component<VisitCountComponent>()->insert(e);
+            lruDb.component<VisitOrderComponent>()->insert(e);
+
+            if (i % 2)
+            {
+                lruDb.component<FailingEraseComponent>()->insert(e);
+            }
+        }
+
+        const game::EntitySet* pCountOrder = lruDb.query<VisitCountComponent, VisitOrderComponent>();
+        const std::size_t countOrderBytes = lruDb.query_cache_usage();
+        lruDb.query<VisitCountComponent, FailingEraseComponent>();
+        LS_ASSERT(lruDb.query_cache_usage() > countOrderBytes);
+
+        // Only the least recently used query is evicted
+        LS_ASSERT((lruDb.query<VisitCountComponent, VisitOrderComponent>() == pCountOrder));
+        lruDb.query_cache_limit(lruDb.query_cache_usage() - 1);
+        LS_ASSERT(lruDb.query_cache_usage() == countOrderBytes);
+        LS_ASSERT((lruDb.query<VisitCountComponent, VisitOrderComponent>() == pCountOrder && pCountOrder->size() == 3000));
+        std::cout << "Successfully evicted the least recently used query." << std::endl;
+    }
+
+    {
+        game::ECSDatabase sleepDb;
+        sleepDb.construct_component<VisitCountComponent>();
+        VisitCountComponent* pVisits = sleepDb.component<VisitCountComponent>();
+        std::vector<game::Entity> awake;
+        std::vector<game::Entity> sleepers;
+
+        for (unsigned i = 0; i < 6; ++i)
+        {
+            const game::Entity e = sleepDb.create_entity();
+            pVisits->insert(e);
+            (i % 2 ? sleepers : awake).push_back(e);
+        }
+
+        LS_ASSERT(sleepDb.sleep_entities(sleepers) == 3 && pVisits->num_active() == 3);
+        pVisits->update();
+        LS_ASSERT(pVisits->numVisits == 3 && !pVisits->is_active(sleepers[0]));
+
+        const game::Entity late = sleepDb.create_entity();
+        LS_ASSERT(sleepDb.sleep_entity(late) && pVisits->insert(late) == game::ComponentAddStatus::ADD_OK);
+        LS_ASSERT(!pVisits->is_active(late) && pVisits->num_active() == 3);
+
+        sleepDb.destroy_entity(awake[0]);
+        LS_ASSERT(pVisits->num_active() == 2 && pVisits->size() == 6);
+        LS_ASSERT(sleepDb.wake_entity(sleepers[1]) && pVisits->is_active(sleepers[1]));
+
+        sleepDb.wake_all_entities();
+        LS_ASSERT(pVisits->num_active() == pVisits->size() && sleepDb.num_dormant_entities() == 0);
+        std::cout << "Successfully put entities to sleep." << std::endl;
+    }
+
+    {
+        game::ECSDatabase sharedDb;
+        sharedDb.construct_component<MaterialComponent>();
+        MaterialComponent* pMaterials = sharedDb.component<MaterialComponent>();
+
+        for (int i = 0; i < 30; ++i)
+        {
+            const game::Entity e = sharedDb.create_entity();
+            pMaterials->insert(e);
+            pMaterials->value(e, 1 + i % 3);
+        }
+
+        std::size_t numGroups = 0;
+        std::size_t numGrouped = 0;
+        pMaterials->for_each_group([&](int material, const game::Entity* pEntities, std::size_t count)->void
+        {
+            LS_ASSERT(count == 10 && pMaterials->value(pEntities[count-1]) == material);
+            ++numGroups;
+            numGrouped += count;
+        });
+        LS_ASSERT(numGroups == 3 && numGrouped == 30 && pMaterials->num_values() == 4);
+
+        pMaterials->shrink_to_fit();
+        LS_ASSERT(pMaterials->num_values() == 3 && pMaterials->find_value(0) == MaterialComponent::INVALID_VALUE);
+        LS_ASSERT(pMaterials->value(pMaterials->entities()[4]) == 2);
+        std::cout << "Successfully shared " << pMaterials->num_values() << " values between " << pMaterials->size() << " entities." << std::endl;
+    }
+
+    {
+        game::ECSDatabase stableDb;
+        stableDb.construct_component<HealthComponent>();
+        HealthComponent* pHealth = stableDb.component<HealthComponent>();
+
+        std::vector<game::Entity> entities;
+        for (std::size_t i = 0; i < HealthComponent::PAGE_SIZE * 2; ++i)
+        {
+            entities.push_back(stableDb.create_entity());
+            pHealth->insert(entities.back());
+            pHealth->value(entities.back(), (int)i);
+        }
+
+        // Removing entities moves slot IDs, never values
+        int* pLast = pHealth->writable(entities.back());
+        for (std::size_t i = 0; i < HealthComponent::PAGE_SIZE; ++i)
+        {
+            stableDb.destroy_entity(entities[i]);
+        }
+
+        LS_ASSERT(pHealth->writable(entities.back()) == pLast && *pLast == (int)entities.size()-1);
+        LS_ASSERT(pHealth->page(0) == nullptr && pHealth->page_count(1) == HealthComponent::PAGE_SIZE);
+
+        // Freed slots are reused before new pages are added
+        const game::Entity e = stableDb.create_entity();
+        pHealth->insert(e);
+        LS_ASSERT(pHealth->slot(e) < HealthComponent::PAGE_SIZE && pHealth->value(e) == 0);
+
+        std::size_t numVisited = 0;
+        pHealth->for_each([&](const game::Entity& visited, int& health)->void
+        {
+            LS_ASSERT(pHealth->writable(visited) == &health);
+            ++numVisited;
+        });
+        LS_ASSERT(numVisited == pHealth->size() && pHealth->num_pages() == 2);
+
+        // Copies share pages, so pointers must be retrieved again afterward
+        const HealthComponent healthCopy = *pHealth;
+        int* pMoved = pHealth->writable(entities.back());
+        LS_ASSERT(pMoved != pLast && *pMoved == *pLast);
+        *pMoved = -1;
+        LS_ASSERT(pHealth->value(e, 5) && healthCopy.value(entities.back()) == *pLast);
+        LS_ASSERT(pHealth->value(entities.back()) == -1);
+        std::cout << "Successfully kept " << pHealth->size() << " component values at stable addresses." << std::endl;
+    }
+
+    {
+        game::ECSDatabase bitmapDb;
+        bitmapDb.construct_component<VisitCountComponent>();
+        bitmapDb.construct_component<MaterialComponent>();
+        bitmapDb.construct_component<HealthComponent>();
+        bitmapDb.query_bitmap_threshold(3);
+
+        for (int i = 0; i < 300; ++i)
+        {
+            const game::Entity e = bitmapDb.create_entity();
+            bitmapDb.component<VisitCountComponent>()->insert(e);
+            if (i % 2 == 0) bitmapDb.component<MaterialComponent>()->insert(e);
+            if (i % 3 == 0) bitmapDb.component<HealthComponent>()->insert(e);
+        }
+
+        const std::vector<std::size_t> required{
+            game::ECSDatabase::component_id<VisitCountComponent>(),
+            game::ECSDatabase::component_id<MaterialComponent>()
+        };
+        const std::vector<std::size_t> excluded{game::ECSDatabase::component_id<HealthComponent>()};
+
+        // Entities divisible by 2 but not 3
+        const game::EntitySet* pMatches = bitmapDb.query(required, excluded);
+        LS_ASSERT(pMatches != nullptr && pMatches->size() == 100);
+
+        const game::Entity e = bitmapDb.component<HealthComponent>()->entities()[2];
+        bitmapDb.component<HealthComponent>()->erase(e);
+        LS_ASSERT(pMatches->size() == 101 && pMatches->contains(e));
+
+        // New queries are built from the patched bitmaps
+        game::Entity first = bitmapDb.component<HealthComponent>()->entities()[0];
+        bitmapDb.destroy_entity(first);
+        const game::EntitySet* pAll = bitmapDb.query<VisitCountComponent, MaterialComponent, HealthComponent>();
+        LS_ASSERT(pAll != nullptr && pAll->size() == 48);
+        std::cout << "Successfully intersected " << required.size() + excluded.size() << " component bitmaps." << std::endl;
+    }
+
+    {
+        game::ECSDatabase sortedDb;
+        sortedDb.construct_component<VelocityComponent>();
+        VelocityComponent* pVelocities = sortedDb.component<VelocityComponent>();
+        std::vector<game::Entity> created;
+
+        for (unsigned i = 0; i < 40; ++i)
+        {
+            created.push_back(sortedDb.create_entity());
+        }
+
+        for (std::size_t i = created.size(); i--;)
+        {
+            pVelocities->insert(created[i]);
+            pVelocities->set<1>(created[i], (float)game::entity_index(created[i]));
+        }
+
+        sortedDb.destroy_entity(created[7]);
+        pVelocities->iteration_order(game::ComponentOrder::ORDER_SORTED);
+        LS_ASSERT(pVelocities->sort_entities());
+
+        const game::EntitySet& sorted = pVelocities->entities();
+        for (std::size_t i = 1; i < sorted.size(); ++i)
+        {
+            LS_ASSERT(game::entity_index(sorted[i-1]) < game::entity_index(sorted[i]));
+            LS_ASSERT(pVelocities->get<1>(sorted[i]) == (float)game::entity_index(sorted[i]));
+        }
+
+        // Waking every entity must re-sort the woken entities as well
+        sortedDb.construct_component<VisitOrderComponent>();
+        VisitOrderComponent* pOrder = sortedDb.component<VisitOrderComponent>();
+        pOrder->iteration_order(game::ComponentOrder::ORDER_SORTED);
+
+        for (unsigned i = 0; i < 5; ++i)
+        {
+            pOrder->insert(created[i]);
+        }
+
+        LS_ASSERT(sortedDb.sleep_entity(created[1]));
+        pOrder->update();
+        sortedDb.wake_all_entities();
+        pOrder->visits.clear();
+        pOrder->update();
+        LS_ASSERT(pOrder->visits.size() == 5);
+
+        for (std::size_t i = 1; i < pOrder->visits.size(); ++i)
+        {
+            LS_ASSERT(game::entity_index(pOrder->visits[i-1]) < game::entity_index(pOrder->visits[i]));
+        }
+
+        // Ranges updated out of order merge back into the sorted order
+        pOrder->visits.clear();
+        pOrder->update_range(3, 10);
+        pOrder->update_range(0, 3);
+        LS_ASSERT(pOrder->visits.size() == 5 && pOrder->visits[0].id == created[3].id);
+        game::merge_entity_results(pOrder->visits, [](const game::Entity& e) noexcept->const game::Entity&
+        {
+            return e;
+        });
+
+        for (std::size_t i = 0; i < pOrder->visits.size(); ++i)
+        {
+            LS_ASSERT(pOrder->visits[i].id == created[i].id);
+        }
+        std::cout << "Successfully sorted " << sorted.size() << " entities for deterministic iteration." << std::endl;
+    }
+
+    {
+        game::ECSDatabase indexDb;
+        indexDb.construct_component<NetworkComponent>();
+        NetworkComponent* pNetwork = indexDb.component<NetworkComponent>();
+        std::vector<game::Entity> created;
+        std::vector<game::Entity> found;
+
+        LS_ASSERT(pNetwork->add_hash_index<0>() && pNetwork->add_sorted_index<1>());
+        LS_ASSERT(pNetwork->index_type<1>() == game::ColumnIndexType::INDEX_SORTED);
+
+        for (unsigned i = 0; i < 100; ++i)
+        {
+            created.push_back(indexDb.create_entity());
+            pNetwork->insert(created.back());
+            pNetwork->set<0>(created.back(), 1000u + i);
+            pNetwork->set<1>(created.back(), (int)(i % 10));
+        }
+
+        LS_ASSERT(pNetwork->find<0>(1042u, found) == 1 && found[0].id == created[42].id);
+
+        // Destroying an entity moves the last row into its place
+        game::Entity removed = created[42];
+        indexDb.destroy_entity(removed);
+        found.clear();
+        LS_ASSERT(pNetwork->find<0>(1042u, found) == 0);
+        LS_ASSERT(pNetwork->find<0>(1099u, found) == 1 && found[0].id == created[99].id);
+        LS_ASSERT(pNetwork->find_range<1>(2, 3, found) == 19);
+
+        // Clones keep the kind of index and rebuild it on their first lookup
+        game::ECSDatabase indexClone;
+        LS_ASSERT(indexDb.clone(indexClone) == game::ECSCloneStatus::CLONE_OK);
+        NetworkComponent* pClonedNetwork = indexClone.component<NetworkComponent>();
+        LS_ASSERT(pClonedNetwork->index_type<1>() == game::ColumnIndexType::INDEX_SORTED);
+        LS_ASSERT(pClonedNetwork->memory_stats().usedBytes < pNetwork->memory_stats().usedBytes);
+        LS_ASSERT(pClonedNetwork->find_range<1>(2, 3, found) == 19);
+
+        // Writing a whole chunk rebuilds the index on the next lookup
+        int* const pTeams = pNetwork->writable_column<1>(0);
+        for (std::size_t i = 0; i < pNetwork->chunk_size(0); ++i)
+        {
+            pTeams[i] = 7;
+        }
+
+        found.clear();
+        LS_ASSERT(pNetwork->find<1>(7, found) == 99);
+        pNetwork->remove_index<1>();
+        LS_ASSERT(pNetwork->find<1>(7, found) == 99 && pNetwork->find_range<1>(0, 6, found) == 0);
+        std::cout << "Successfully looked up " << found.size() << " entities through column indices." << std::endl;
+    }
+
+    {
+        game::PagedArray<int, 4> column;
+        game::ColumnIndex<int> columnIndex;
+        std::vector<std::size_t> rows;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            LS_ASSERT(column.push_back(i));
+        }
+
+        LS_ASSERT(columnIndex.reset(&game::SortedColumnIndex<int>::create));
+        LS_ASSERT(columnIndex.get() == nullptr && columnIndex.sync(column, column.size()));
+
+        // Writing a page only re-indexes its rows
+        columnIndex.invalidate_page(column, 1);
+        column.writable_page(1)[2] = 100;
+        LS_ASSERT(columnIndex.get() == nullptr && !columnIndex.is_stale());
+        LS_ASSERT(columnIndex.sync(column, column.size()) && columnIndex.get() != nullptr);
+        columnIndex.get()->find(100, rows);
+        columnIndex.get()->find(6, rows);
+        LS_ASSERT(rows.size() == 1 && rows[0] == 6);
+
+        // Rows moving while pages are pending rebuild the whole index
+        columnIndex.invalidate_page(column, 2);
+        column.writable_page(2)[0] = 100;
+        columnIndex.erase(column[15], 15);
+        column.pop_back();
+        LS_ASSERT(columnIndex.is_stale() && columnIndex.sync(column, column.size()));
+        rows.clear();
+        columnIndex.get()->find_range(100, 100, rows);
+        LS_ASSERT(rows.size() == 2 && columnIndex.get()->find_range(15, 15, rows) && rows.size() == 2);
+        std::cout << "Successfully re-indexed a written page." << std::endl;
+    }
+
+    {
+        game::ECSDatabase splitDb;
+        splitDb.construct_component<CreatureComponent>();
+        CreatureComponent* pCreatures = splitDb.component<CreatureComponent>();
+        std::vector<game::Entity> created;
+
+        for (unsigned i = 0; i < 10; ++i)
+        {
+            created.push_back(splitDb.create_entity());
+            pCreatures->insert(created.back());
+            pCreatures->set<0>(created.back(), (float)i);
+            pCreatures->cold(created.back(), 10.f * (float)i + 0.3f);
+        }
+
+        const float tolerance = 100.f / 65535.f;
+        LS_ASSERT(std::abs(pCreatures->cold(created[3]) - 30.3f) <= tolerance);
+        LS_ASSERT(pCreatures->cold(created[0], -5.f) && pCreatures->cold(created[0]) == 0.f);
+        LS_ASSERT(pCreatures->get<0>(created[9]) == 9.f && pCreatures->column<0>(0)[9] == 9.f);
+
+        float health[CreatureComponent::CHUNK_SIZE];
+        LS_ASSERT(pCreatures->decode_chunk(0, health) == 10 && std::abs(health[9] - 90.3f) <= tolerance);
+
+        typedef game::OffsetCodec<int32_t, int16_t, 100000> TickCodec;
+        LS_ASSERT(TickCodec::decode(TickCodec::encode(100123)) == 100123 && sizeof(TickCodec::encoded_type) == 2);
+        std::cout << "Successfully split " << pCreatures->size() << " entities into hot and cold columns." << std::endl;
+    }
+
     return 0;
 }